@@ -30,6 +30,10 @@ project "WalnutApp"
       systemversion "latest"
       defines { "WL_PLATFORM_WINDOWS" }
 
+   filter "system:linux"
+      defines { "WL_PLATFORM_LINUX" }
+      links { "ImGui", "GLFW", "%{Library.Vulkan}", "dl", "pthread", "X11" }
+
    filter "configurations:Debug"
       defines { "WL_DEBUG" }
       runtime "Debug"
@@ -0,0 +1,37 @@
+#pragma once
+#include "Common.h"
+
+CalcArena::~CalcArena()
+{
+	for (Block& block : blocks)
+	{
+		delete[] block.data;
+	}
+}
+
+void* CalcArena::Allocate(size_t size, size_t align)
+{
+	// Try the current block first, then move on to the next one that's big enough
+	while (current < blocks.size())
+	{
+		size_t aligned = (offset + align - 1) & ~(align - 1);
+		if (aligned + size <= blocks[current].size)
+		{
+			offset = aligned + size;
+			return blocks[current].data + aligned;
+		}
+		current++;
+		offset = 0;
+	}
+
+	// Out of blocks, allocate a new one (bigger than usual if this allocation needs it)
+	Block block;
+	block.size = std::max(blockSize, size + align);
+	block.data = new uint8_t[block.size];
+	blocks.push_back(block);
+	current = blocks.size() - 1;
+
+	// Blocks come from new[] so their start is suitably aligned for anything
+	offset = size;
+	return block.data;
+}
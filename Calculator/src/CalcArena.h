@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <new>
+#include <utility>
+#include <string>
+
+/// <summary>
+/// Monotonic (bump) allocator. Memory is handed out from large blocks and never freed individually,
+/// rewinding to an earlier mark (or resetting) is O(1) and keeps the blocks around to be reused
+/// </summary>
+
+class CalcArena {
+
+public:
+	static const size_t DefaultBlockSize = 16 * 1024;
+
+	// A position in the arena that can be rewound to later
+	struct Mark
+	{
+		size_t block = 0;
+		size_t offset = 0;
+	};
+
+	explicit CalcArena(size_t blockSize = DefaultBlockSize) : blockSize(blockSize) {}
+	~CalcArena();
+
+	CalcArena(const CalcArena&) = delete;
+	CalcArena& operator=(const CalcArena&) = delete;
+
+	// Get size bytes aligned to align (a power of 2)
+	void* Allocate(size_t size, size_t align);
+
+	// Construct a T in the arena. Its destructor is never called, so only use this for trivially destructible types
+	template<typename T, typename... Args>
+	T* New(Args&&... args) { return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...); }
+
+	Mark GetMark() const { return { current, offset }; }
+
+	// Rewinding frees everything allocated since the mark, none of it can be used afterwards
+	void Rewind(Mark mark) { current = mark.block; offset = mark.offset; }
+	void Reset() { Rewind(Mark()); }
+
+	// How many blocks have been allocated from the heap over the arena's lifetime
+	size_t BlockCount() const { return blocks.size(); }
+
+private:
+	struct Block
+	{
+		uint8_t* data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t current = 0;
+	size_t offset = 0;
+	size_t blockSize;
+};
+
+/// <summary>
+/// Standard allocator handing out memory from a CalcArena so std containers can live in one.
+/// Deallocating does nothing, memory only comes back when the arena is rewound, so a container
+/// has to be emptied (not just cleared, see ResetArenaContainer) before that happens
+/// </summary>
+
+template<typename T>
+struct CalcArenaAllocator
+{
+	using value_type = T;
+
+	explicit CalcArenaAllocator(CalcArena& arena) : arena(&arena) {}
+	template<typename U>
+	CalcArenaAllocator(const CalcArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const CalcArenaAllocator<U>& other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const CalcArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	CalcArena* arena;
+};
+
+// Containers whose storage comes from a CalcArena
+template<typename T>
+using ArenaVector = std::vector<T, CalcArenaAllocator<T>>;
+using ArenaString = std::basic_string<char, std::char_traits<char>, CalcArenaAllocator<char>>;
+
+// Swap a container for an empty one so it no longer refers to any arena memory, ready for the arena to be rewound
+template<typename Container>
+void ResetArenaContainer(Container& container)
+{
+	Container(container.get_allocator()).swap(container);
+}
+
+/// <summary>
+/// Stack whose nodes live in a CalcArena and are never changed once pushed. Pushing links a new node onto the top, popping
+/// just steps down to the node below, so every earlier version of the stack is still intact and can be returned to in O(1)
+/// by keeping its Top. Versions share all the nodes they have in common, each push only costs the one node it adds
+/// </summary>
+
+template<typename T>
+class PersistentStack
+{
+public:
+	struct Node
+	{
+		T value;
+		const Node* below;
+		size_t size;
+	};
+
+	explicit PersistentStack(CalcArena& arena) : arena(&arena) {}
+
+	const T& back() const { return top->value; }
+	size_t size() const { return top != nullptr ? top->size : 0; }
+	bool empty() const { return top == nullptr; }
+
+	void push_back(const T& value) { top = arena->New<Node>(Node{ value, top, size() + 1 }); }
+	void pop_back() { top = top->below; }
+	// Change the top value by pushing a copy in its place, any version still holding the old top keeps the old value
+	void replace_back(const T& value) { top = arena->New<Node>(Node{ value, top->below, top->size }); }
+	// Forget every node, do this before the arena is rewound
+	void clear() { top = nullptr; }
+
+	// The top node identifies this version of the stack, restoring it makes the stack exactly what it was then
+	const Node* Top() const { return top; }
+	void Restore(const Node* node) { top = node; }
+
+	// Copy every value into out, bottom first, for going over the whole stack in order
+	template<typename Vector>
+	void CopyTo(Vector& out) const
+	{
+		out.resize(size());
+		size_t i = out.size();
+		for (const Node* node = top; node != nullptr; node = node->below) { out[--i] = node->value; }
+	}
+
+private:
+	CalcArena* arena;
+	const Node* top = nullptr;
+};
@@ -0,0 +1,492 @@
+#pragma once
+#include "Common.h"
+
+/// <summary>
+/// Limb arithmetic for CalcDecimal. Magnitudes are base 1e9 so each limb holds 9 decimal digits,
+/// which keeps scaling by powers of ten and converting to text cheap
+/// </summary>
+
+static const uint32_t LimbBase = 1000000000;
+static const uint32_t LimbDigits = 9;
+
+// Below this many limbs Karatsuba's extra additions cost more than the multiplications they save
+static const uint32_t KaratsubaThreshold = 32;
+
+// LIMB BUFFER --------------------------------------------------------------------------------------------
+
+LimbBuffer::LimbBuffer(const LimbBuffer& other)
+{
+	Resize(other.size);
+	memcpy(data, other.data, size * sizeof(uint32_t));
+}
+
+LimbBuffer::LimbBuffer(LimbBuffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+LimbBuffer& LimbBuffer::operator=(const LimbBuffer& other)
+{
+	if (this == &other) { return *this; }
+	size = 0;
+	Resize(other.size);
+	memcpy(data, other.data, size * sizeof(uint32_t));
+	return *this;
+}
+
+LimbBuffer& LimbBuffer::operator=(LimbBuffer&& other) noexcept
+{
+	if (this == &other) { return *this; }
+
+	// Heap storage can simply be taken, inline storage has to be copied
+	if (other.IsInline())
+	{
+		size = 0;
+		Resize(other.size);
+		memcpy(data, other.data, size * sizeof(uint32_t));
+	}
+	else
+	{
+		if (!IsInline()) { delete[] data; }
+		data = other.data;
+		size = other.size;
+		capacity = other.capacity;
+		other.data = other.inlineLimbs;
+		other.capacity = InlineLimbs;
+	}
+	other.size = 0;
+	return *this;
+}
+
+LimbBuffer::~LimbBuffer()
+{
+	if (!IsInline()) { delete[] data; }
+}
+
+void LimbBuffer::Reserve(uint32_t n)
+{
+	if (n <= capacity) { return; }
+
+	uint32_t newCapacity = std::max(n, capacity * 2);
+	uint32_t* newData = new uint32_t[newCapacity];
+	memcpy(newData, data, size * sizeof(uint32_t));
+	if (!IsInline()) { delete[] data; }
+	data = newData;
+	capacity = newCapacity;
+}
+
+void LimbBuffer::Resize(uint32_t n)
+{
+	Reserve(n);
+	if (n > size) { memset(data + size, 0, (n - size) * sizeof(uint32_t)); }
+	size = n;
+}
+
+// MAGNITUDE HELPERS --------------------------------------------------------------------------------------------
+
+// Compare two trimmed magnitudes, returns -1, 0 or 1
+static int CompareMagnitude(const LimbBuffer& a, const LimbBuffer& b)
+{
+	if (a.Size() != b.Size()) { return a.Size() < b.Size() ? -1 : 1; }
+	for (uint32_t i = a.Size(); i > 0; i--)
+	{
+		if (a[i - 1] != b[i - 1]) { return a[i - 1] < b[i - 1] ? -1 : 1; }
+	}
+	return 0;
+}
+
+static LimbBuffer AddMagnitude(const LimbBuffer& a, const LimbBuffer& b)
+{
+	const LimbBuffer& longer = a.Size() >= b.Size() ? a : b;
+	const LimbBuffer& shorter = a.Size() >= b.Size() ? b : a;
+
+	LimbBuffer out;
+	out.Resize(longer.Size() + 1);
+	uint32_t carry = 0;
+	for (uint32_t i = 0; i < longer.Size(); i++)
+	{
+		uint32_t sum = longer[i] + (i < shorter.Size() ? shorter[i] : 0) + carry;
+		carry = sum >= LimbBase;
+		out[i] = carry ? sum - LimbBase : sum;
+	}
+	out[longer.Size()] = carry;
+	out.Trim();
+	return out;
+}
+
+// a - b, where a >= b
+static LimbBuffer SubtractMagnitude(const LimbBuffer& a, const LimbBuffer& b)
+{
+	LimbBuffer out;
+	out.Resize(a.Size());
+	int64_t borrow = 0;
+	for (uint32_t i = 0; i < a.Size(); i++)
+	{
+		int64_t diff = (int64_t)a[i] - (i < b.Size() ? b[i] : 0) - borrow;
+		borrow = diff < 0;
+		out[i] = (uint32_t)(borrow ? diff + LimbBase : diff);
+	}
+	out.Trim();
+	return out;
+}
+
+// a = a * m + add, in place
+static void MultiplySmall(LimbBuffer& a, uint32_t m, uint32_t add = 0)
+{
+	uint64_t carry = add;
+	for (uint32_t i = 0; i < a.Size(); i++)
+	{
+		uint64_t p = (uint64_t)a[i] * m + carry;
+		a[i] = (uint32_t)(p % LimbBase);
+		carry = p / LimbBase;
+	}
+	while (carry > 0)
+	{
+		uint32_t i = a.Size();
+		a.Resize(i + 1);
+		a[i] = (uint32_t)(carry % LimbBase);
+		carry /= LimbBase;
+	}
+}
+
+// a = a / d in place, returns the remainder
+static uint32_t DivideSmall(LimbBuffer& a, uint32_t d)
+{
+	uint64_t remainder = 0;
+	for (uint32_t i = a.Size(); i > 0; i--)
+	{
+		uint64_t cur = remainder * LimbBase + a[i - 1];
+		a[i - 1] = (uint32_t)(cur / d);
+		remainder = cur % d;
+	}
+	a.Trim();
+	return (uint32_t)remainder;
+}
+
+// Multiply by 10^digits, shifting whole limbs where we can
+static LimbBuffer ShiftUp(const LimbBuffer& a, int32_t digits)
+{
+	if (digits <= 0 || a.Size() == 0) { return a; }
+
+	uint32_t limbShift = digits / LimbDigits;
+	LimbBuffer out;
+	out.Resize(a.Size() + limbShift);
+	memcpy(out.Data() + limbShift, a.Data(), a.Size() * sizeof(uint32_t));
+	MultiplySmall(out, (uint32_t)PowersOfTen[digits % LimbDigits]);
+	return out;
+}
+
+// out[0, na + nb) = a * b, overwriting out
+static void MultiplySchoolbook(const uint32_t* a, uint32_t na, const uint32_t* b, uint32_t nb, uint32_t* out)
+{
+	memset(out, 0, (na + nb) * sizeof(uint32_t));
+	for (uint32_t i = 0; i < na; i++)
+	{
+		uint64_t carry = 0;
+		for (uint32_t j = 0; j < nb; j++)
+		{
+			uint64_t p = (uint64_t)a[i] * b[j] + out[i + j] + carry;
+			out[i + j] = (uint32_t)(p % LimbBase);
+			carry = p / LimbBase;
+		}
+		out[i + nb] = (uint32_t)carry;
+	}
+}
+
+// out[0, 2n) = a * b for two n limb numbers, overwriting out
+static void MultiplyKaratsuba(const uint32_t* a, const uint32_t* b, uint32_t n, uint32_t* out)
+{
+	if (n < KaratsubaThreshold)
+	{
+		MultiplySchoolbook(a, n, b, n, out);
+		return;
+	}
+
+	// Split each number into low (h limbs) and high (hi limbs) halves: a = a1 * base^h + a0
+	uint32_t h = n / 2;
+	uint32_t hi = n - h;
+
+	// z0 = a0 * b0 and z2 = a1 * b1 go straight into the low and high halves of out (hi >= h, so pad the low halves)
+	std::vector<uint32_t> a0(a, a + h), b0(b, b + h);
+	a0.resize(hi, 0); b0.resize(hi, 0);
+	std::vector<uint32_t> z0(2 * hi);
+	MultiplyKaratsuba(a0.data(), b0.data(), hi, z0.data());
+	memcpy(out, z0.data(), 2 * h * sizeof(uint32_t));
+	MultiplyKaratsuba(a + h, b + h, hi, out + 2 * h);
+
+	// z1 = (a0 + a1)(b0 + b1) - z0 - z2
+	std::vector<uint32_t> sa(hi + 1), sb(hi + 1);
+	uint32_t carryA = 0, carryB = 0;
+	for (uint32_t i = 0; i < hi; i++)
+	{
+		uint32_t va = a0[i] + a[h + i] + carryA;
+		carryA = va >= LimbBase;
+		sa[i] = carryA ? va - LimbBase : va;
+		uint32_t vb = b0[i] + b[h + i] + carryB;
+		carryB = vb >= LimbBase;
+		sb[i] = carryB ? vb - LimbBase : vb;
+	}
+	sa[hi] = carryA;
+	sb[hi] = carryB;
+
+	std::vector<uint32_t> z1(2 * (hi + 1));
+	MultiplyKaratsuba(sa.data(), sb.data(), hi + 1, z1.data());
+
+	const uint32_t* z2 = out + 2 * h;
+	int64_t borrow = 0;
+	for (uint32_t i = 0; i < z1.size(); i++)
+	{
+		int64_t diff = (int64_t)z1[i] - (i < z0.size() ? z0[i] : 0) - (i < 2 * hi ? z2[i] : 0) - borrow;
+		borrow = 0;
+		while (diff < 0) { diff += LimbBase; borrow++; }
+		z1[i] = (uint32_t)diff;
+	}
+
+	// Add z1 in at base^h, the full product fits in 2n limbs so anything beyond that is zero
+	uint32_t carry = 0;
+	for (uint32_t i = 0; h + i < 2 * n; i++)
+	{
+		uint32_t sum = out[h + i] + (i < z1.size() ? z1[i] : 0) + carry;
+		carry = sum >= LimbBase;
+		out[h + i] = carry ? sum - LimbBase : sum;
+		if (i >= z1.size() && carry == 0) { break; }
+	}
+}
+
+static LimbBuffer MultiplyMagnitude(const LimbBuffer& a, const LimbBuffer& b)
+{
+	LimbBuffer out;
+	if (a.Size() == 0 || b.Size() == 0) { return out; }
+
+	uint32_t na = a.Size(), nb = b.Size();
+	uint32_t shorter = std::min(na, nb), longer = std::max(na, nb);
+
+	// Karatsuba only pays off when both numbers are large and of a similar size (we pad the shorter one to match)
+	if (shorter >= KaratsubaThreshold && longer <= shorter * 2)
+	{
+		std::vector<uint32_t> pa(a.Data(), a.Data() + na), pb(b.Data(), b.Data() + nb);
+		pa.resize(longer, 0);
+		pb.resize(longer, 0);
+		out.Resize(2 * longer);
+		MultiplyKaratsuba(pa.data(), pb.data(), longer, out.Data());
+	}
+	else
+	{
+		out.Resize(na + nb);
+		MultiplySchoolbook(a.Data(), na, b.Data(), nb, out.Data());
+	}
+	out.Trim();
+	return out;
+}
+
+// Integer division of two trimmed magnitudes, u / v (v non-zero) using Knuth's algorithm D
+static LimbBuffer DivideMagnitude(const LimbBuffer& u, const LimbBuffer& v)
+{
+	if (CompareMagnitude(u, v) < 0) { return LimbBuffer(); }
+
+	if (v.Size() == 1)
+	{
+		LimbBuffer q = u;
+		DivideSmall(q, v[0]);
+		return q;
+	}
+
+	// Normalize so the divisor's top limb is at least half the base, which keeps each quotient estimate within 2 of the real digit
+	uint32_t d = LimbBase / (v[v.Size() - 1] + 1);
+	LimbBuffer un = u, vn = v;
+	MultiplySmall(un, d);
+	MultiplySmall(vn, d);
+	if (un.Size() == u.Size()) { un.Resize(u.Size() + 1); }
+
+	uint32_t n = vn.Size();
+	uint32_t m = un.Size() - n;
+	LimbBuffer q;
+	q.Resize(m);
+
+	for (uint32_t j = m; j-- > 0;)
+	{
+		// Estimate this quotient digit from the top limbs
+		uint64_t top = (uint64_t)un[j + n] * LimbBase + un[j + n - 1];
+		uint64_t qhat = top / vn[n - 1];
+		uint64_t rhat = top % vn[n - 1];
+		while (qhat >= LimbBase || qhat * vn[n - 2] > rhat * LimbBase + un[j + n - 2])
+		{
+			qhat--;
+			rhat += vn[n - 1];
+			if (rhat >= LimbBase) { break; }
+		}
+
+		// Subtract qhat * v from the current window
+		int64_t borrow = 0;
+		uint64_t carry = 0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			uint64_t p = qhat * vn[i] + carry;
+			carry = p / LimbBase;
+			int64_t diff = (int64_t)un[i + j] - (int64_t)(p % LimbBase) - borrow;
+			borrow = diff < 0;
+			un[i + j] = (uint32_t)(borrow ? diff + LimbBase : diff);
+		}
+		int64_t diff = (int64_t)un[j + n] - (int64_t)carry - borrow;
+
+		// The estimate was one too high, add v back
+		if (diff < 0)
+		{
+			un[j + n] = (uint32_t)(diff + LimbBase);
+			qhat--;
+			uint32_t addCarry = 0;
+			for (uint32_t i = 0; i < n; i++)
+			{
+				uint32_t sum = un[i + j] + vn[i] + addCarry;
+				addCarry = sum >= LimbBase;
+				un[i + j] = addCarry ? sum - LimbBase : sum;
+			}
+			un[j + n] = (uint32_t)((un[j + n] + addCarry) % LimbBase);
+		}
+		else
+		{
+			un[j + n] = (uint32_t)diff;
+		}
+		q[j] = (uint32_t)qhat;
+	}
+	q.Trim();
+	return q;
+}
+
+// CALC DECIMAL --------------------------------------------------------------------------------------------
+
+CalcDecimal::CalcDecimal(const Operand& op)
+	: scale(op.scale)
+{
+	// An operand's mantissa is at most 18 digits so it fits in 2 limbs
+	magnitude.Resize(2);
+	magnitude[0] = (uint32_t)(op.mantissa % LimbBase);
+	magnitude[1] = (uint32_t)(op.mantissa / LimbBase);
+	Normalize();
+}
+
+void CalcDecimal::Normalize()
+{
+	magnitude.Trim();
+	if (magnitude.Size() == 0)
+	{
+		scale = 0;
+		negative = false;
+		return;
+	}
+
+	// Drop whole zero limbs first, then single digits
+	uint32_t zeroLimbs = 0;
+	while (zeroLimbs < magnitude.Size() && magnitude[zeroLimbs] == 0 && scale >= (int32_t)LimbDigits * (int32_t)(zeroLimbs + 1)) { zeroLimbs++; }
+	if (zeroLimbs > 0)
+	{
+		memmove(magnitude.Data(), magnitude.Data() + zeroLimbs, (magnitude.Size() - zeroLimbs) * sizeof(uint32_t));
+		magnitude.Resize(magnitude.Size() - zeroLimbs);
+		scale -= zeroLimbs * LimbDigits;
+	}
+	while (scale > 0 && magnitude[0] % 10 == 0)
+	{
+		DivideSmall(magnitude, 10);
+		scale--;
+	}
+}
+
+CalcDecimal CalcDecimal::AddSigned(const CalcDecimal& other, bool negateOther) const
+{
+	CalcDecimal out;
+	if (undefined || other.undefined) { out.undefined = true; return out; }
+
+	// Line the decimal points up
+	int32_t outScale = std::max(scale, other.scale);
+	LimbBuffer a = ShiftUp(magnitude, outScale - scale);
+	LimbBuffer b = ShiftUp(other.magnitude, outScale - other.scale);
+	bool otherNegative = other.negative != negateOther;
+
+	if (negative == otherNegative)
+	{
+		out.magnitude = AddMagnitude(a, b);
+		out.negative = negative;
+	}
+	else if (CompareMagnitude(a, b) >= 0)
+	{
+		out.magnitude = SubtractMagnitude(a, b);
+		out.negative = negative;
+	}
+	else
+	{
+		out.magnitude = SubtractMagnitude(b, a);
+		out.negative = otherNegative;
+	}
+	out.scale = outScale;
+	out.Normalize();
+	return out;
+}
+
+CalcDecimal CalcDecimal::Add(const CalcDecimal& other) const
+{
+	return AddSigned(other, false);
+}
+
+CalcDecimal CalcDecimal::Subtract(const CalcDecimal& other) const
+{
+	return AddSigned(other, true);
+}
+
+CalcDecimal CalcDecimal::Multiply(const CalcDecimal& other) const
+{
+	CalcDecimal out;
+	if (undefined || other.undefined) { out.undefined = true; return out; }
+
+	out.magnitude = MultiplyMagnitude(magnitude, other.magnitude);
+	out.scale = scale + other.scale;
+	out.negative = negative != other.negative;
+	out.Normalize();
+	return out;
+}
+
+CalcDecimal CalcDecimal::Divide(const CalcDecimal& other, int32_t divisionScale) const
+{
+	CalcDecimal out;
+	if (undefined || other.undefined || other.IsZero()) { out.undefined = true; return out; }
+
+	// (a / 10^sa) / (b / 10^sb) to divisionScale places is (a * 10^(divisionScale + sb - sa)) / b, with the scale moved onto b if that's negative
+	int32_t shift = divisionScale + other.scale - scale;
+	LimbBuffer a = ShiftUp(magnitude, shift);
+	LimbBuffer b = ShiftUp(other.magnitude, -shift);
+
+	out.magnitude = DivideMagnitude(a, b);
+	out.scale = divisionScale;
+	out.negative = negative != other.negative;
+	out.Normalize();
+	return out;
+}
+
+float CalcDecimal::ToFloat() const
+{
+	if (undefined) { return NAN; }
+	return (float)strtod(ToString().c_str(), nullptr);
+}
+
+std::string CalcDecimal::ToString() const
+{
+	if (undefined) { return "Error"; }
+	if (IsZero()) { return "0"; }
+
+	// Write out every digit of the magnitude, the top limb without padding
+	char limb[16];
+	std::string digits = std::to_string(magnitude[magnitude.Size() - 1]);
+	for (uint32_t i = magnitude.Size() - 1; i > 0; i--)
+	{
+		snprintf(limb, sizeof(limb), "%09u", magnitude[i - 1]);
+		digits.append(limb);
+	}
+
+	// Place the decimal point, padding with zeros if the number is less than 1
+	if (scale > 0)
+	{
+		if ((int32_t)digits.size() <= scale) { digits.insert(0, scale - digits.size() + 1, '0'); }
+		digits.insert(digits.size() - scale, 1, '.');
+	}
+	if (negative) { digits.insert(0, 1, '-'); }
+	return digits;
+}
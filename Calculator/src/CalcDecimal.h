@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "CalcOperand.h"
+
+/// <summary>
+/// Growable array of base 1e9 limbs (least significant first) with room for a few limbs inline,
+/// so short numbers never allocate
+/// </summary>
+
+class LimbBuffer {
+
+public:
+	// Limbs stored without allocating (4 limbs is 36 decimal digits)
+	static const uint32_t InlineLimbs = 4;
+
+	LimbBuffer() {}
+	LimbBuffer(const LimbBuffer&);
+	LimbBuffer(LimbBuffer&&) noexcept;
+	LimbBuffer& operator=(const LimbBuffer&);
+	LimbBuffer& operator=(LimbBuffer&&) noexcept;
+	~LimbBuffer();
+
+	uint32_t* Data() { return data; }
+	const uint32_t* Data() const { return data; }
+	uint32_t Size() const { return size; }
+	uint32_t& operator[](uint32_t i) { return data[i]; }
+	uint32_t operator[](uint32_t i) const { return data[i]; }
+
+	// Resize to n limbs, any new limbs are zero
+	void Resize(uint32_t n);
+
+	// Drop zero limbs from the most significant end
+	void Trim() { while (size > 0 && data[size - 1] == 0) { size--; } }
+
+	// Whether we've had to move to the heap
+	bool IsInline() const { return data == inlineLimbs; }
+
+private:
+	void Reserve(uint32_t n);
+
+	uint32_t* data = inlineLimbs;
+	uint32_t size = 0;
+	uint32_t capacity = InlineLimbs;
+	uint32_t inlineLimbs[InlineLimbs] = {};
+};
+
+/// <summary>
+/// Arbitrary precision decimal number, stored as a sign, a magnitude in base 1e9 limbs and a scale
+/// (how many of the magnitude's decimal digits come after the point). Addition, subtraction and multiplication are exact;
+/// division is exact up to a given number of decimal places and truncated after that.
+/// Dividing by zero leaves the result undefined, and anything calculated from an undefined value is undefined too
+/// </summary>
+
+class CalcDecimal {
+
+public:
+	// Decimal places kept when a division doesn't terminate
+	static const int32_t DefaultDivisionScale = 32;
+
+	CalcDecimal() {}
+
+	// An exact copy of an operand entered on the calculator
+	explicit CalcDecimal(const Operand&);
+
+	CalcDecimal Add(const CalcDecimal&) const;
+	CalcDecimal Subtract(const CalcDecimal&) const;
+	CalcDecimal Multiply(const CalcDecimal&) const;
+	CalcDecimal Divide(const CalcDecimal&, int32_t divisionScale = DefaultDivisionScale) const;
+
+	bool IsZero() const { return magnitude.Size() == 0; }
+	bool IsUndefined() const { return undefined; }
+
+	// Nearest float to our value
+	float ToFloat() const;
+
+	// Plain decimal string with no trailing zeros after the point, i.e. "-12.5"
+	std::string ToString() const;
+
+private:
+	// Strip trailing zeros after the decimal point and make zero positive, so every value has one representation
+	void Normalize();
+
+	// Add or subtract (depending on negateOther) with scales aligned
+	CalcDecimal AddSigned(const CalcDecimal&, bool negateOther) const;
+
+	LimbBuffer magnitude;
+	int32_t scale = 0;
+	bool negative = false;
+	bool undefined = false;
+};
+
+// Number types a calculation stream can evaluate with
+enum class NumericBackend { Float, Decimal };
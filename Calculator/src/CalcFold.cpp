@@ -0,0 +1,160 @@
+#pragma once
+#include "Common.h"
+
+void CalcFold::Reset()
+{
+	frame = Frame();
+	outerFrames.clear();
+	operand = Operand();
+	inDecimal = false;
+	afterClose = false;
+	hasInput = false;
+	invalid = false;
+}
+
+bool CalcFold::Feed(char c)
+{
+	if (invalid) { return false; }
+
+	// Whether we're between an operand (or closing bracket) and whatever follows it
+	bool hasOperand = operand.digits > 0 || afterClose;
+
+	switch (c)
+	{
+		// Whitespace is allowed anywhere
+		case ' ':
+		case '\t':
+		case '\r':
+			return true;
+
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+		{
+			hasInput = true;
+			if (afterClose) { invalid = true; return false; }
+			int digit = c - '0';
+
+			// Replace a lone leading zero rather than starting a number with 0
+			if (!inDecimal && operand.digits == 1 && operand.mantissa == 0)
+			{
+				operand.mantissa = digit;
+				return true;
+			}
+			// Ignore any digits that would no longer fit in our mantissa
+			if (operand.digits >= MaxOperandDigits) { return true; }
+
+			operand.mantissa = operand.mantissa * 10 + digit;
+			operand.digits++;
+			if (inDecimal) { operand.scale++; }
+			return true;
+		}
+
+		case '.':
+		{
+			hasInput = true;
+			if (inDecimal || afterClose) { invalid = true; return false; }
+
+			// A decimal point with no whole number before it is read as 0.
+			if (operand.digits == 0) { operand.digits = 1; }
+			inDecimal = true;
+			return true;
+		}
+
+		case '(':
+		{
+			hasInput = true;
+			if (hasOperand) { invalid = true; return false; }
+			outerFrames.push_back(frame);
+			frame = Frame();
+			return true;
+		}
+
+		case ')':
+		{
+			hasInput = true;
+			if (!hasOperand || outerFrames.empty()) { invalid = true; return false; }
+			FoldOperand();
+
+			// The bracket's value is an operand of the enclosing frame
+			float value = CloseFrame();
+			frame = outerFrames.back();
+			outerFrames.pop_back();
+			FoldValue(value);
+			afterClose = true;
+			return true;
+		}
+
+		case '+':
+		case '-':
+		case '*':
+		case '/':
+		{
+			hasInput = true;
+
+			// A - where we're expecting an operand negates it, any other operation needs an operand before it
+			if (!hasOperand)
+			{
+				if (c != '-') { invalid = true; return false; }
+				frame.negate = !frame.negate;
+				return true;
+			}
+			FoldOperand();
+			afterClose = false;
+
+			if (c == '+' || c == '-')
+			{
+				frame.sum = CloseFrame();
+				frame.sumOp = c == '+' ? OpCode::Add : OpCode::Subtract;
+				frame.termOp = OpCode::Load;
+			}
+			else
+			{
+				frame.termOp = c == '*' ? OpCode::Multiply : OpCode::Divide;
+			}
+			return true;
+		}
+	}
+
+	hasInput = true;
+	invalid = true;
+	return false;
+}
+
+bool CalcFold::Finish(float& outValue)
+{
+	if (invalid || !hasInput || (operand.digits == 0 && !afterClose)) { return false; }
+	FoldOperand();
+
+	// Close any brackets that were left open
+	float value = CloseFrame();
+	while (!outerFrames.empty())
+	{
+		frame = outerFrames.back();
+		outerFrames.pop_back();
+		FoldValue(value);
+		value = CloseFrame();
+	}
+	outValue = value;
+	return true;
+}
+
+void CalcFold::FoldValue(float value)
+{
+	if (frame.negate) { value = -value; }
+	ApplyOp(frame.termOp, value, frame.term);
+	frame.negate = false;
+}
+
+void CalcFold::FoldOperand()
+{
+	if (operand.digits > 0) { FoldValue(operand.Value()); }
+	operand = Operand();
+	inDecimal = false;
+}
+
+float CalcFold::CloseFrame()
+{
+	float sum = frame.sum;
+	ApplyOp(frame.sumOp, frame.term, sum);
+	return sum;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/// <summary>
+/// Evaluates a written expression (i.e. "12.5+3*(4-1)") one character at a time, folding each operand into a running value
+/// as soon as it is complete. Only one pending sum and term are kept per open bracket, so memory use doesn't grow with the length of the expression.
+/// Follows the same rules as the calculator UI: * and / bind tighter than + and -, a - where an operand is expected is a unary minus
+/// and any brackets still open at the end are closed automatically
+/// </summary>
+
+class CalcFold {
+
+public:
+	// Clear the running value, ready for a new expression
+	void Reset();
+
+	// Fold a single character of an expression into the running value
+	// Returns false if the character isn't valid at this point, after which the expression is treated as invalid until Reset
+	bool Feed(char);
+
+	// Fold in the final operand and get the value of the expression
+	// Returns false if the expression was empty, invalid, or ended on an operation
+	bool Finish(float& outValue);
+
+private:
+	// The state of one bracket level (the whole expression is the outermost level)
+	struct Frame
+	{
+		// The sum of every complete term so far, and the + or - that will add the current term to it (Load for the first term)
+		float sum = 0.0f;
+		OpCode sumOp = OpCode::Load;
+
+		// The product of the current term so far, and the * or / that will apply the next operand to it (Load for the first operand)
+		float term = 0.0f;
+		OpCode termOp = OpCode::Load;
+
+		// Whether the next operand has an odd number of unary minuses in front of it
+		bool negate = false;
+	};
+
+	// Fold a complete operand into the current term
+	void FoldValue(float);
+
+	// Fold the operand being read (if there is one) into the current term and start a new operand
+	void FoldOperand();
+
+	// Fold the current term into the sum, giving the value of the current frame
+	float CloseFrame();
+
+	// The bracket level we're currently reading
+	Frame frame;
+
+	// The bracket levels enclosing the current one, innermost last. Kept between expressions so nesting doesn't allocate once warmed up
+	std::vector<Frame> outerFrames;
+
+	// The operand currently being read
+	Operand operand;
+
+	// Whether we've read a decimal point for the current operand
+	bool inDecimal = false;
+
+	// Whether the last thing read was a closing bracket (which stands in for an operand)
+	bool afterClose = false;
+
+	// Whether we've read anything other than whitespace since the last Reset
+	bool hasInput = false;
+
+	// Set once an invalid character is read
+	bool invalid = false;
+};
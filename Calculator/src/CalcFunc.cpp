@@ -25,4 +25,289 @@ void OpMultiply(float amt, float& value)
 	value = value * amt;
 }
 
+// Apply a single opcode to a running value (Load replaces the value)
+// The stack opcodes (Push and the Pops) need a tape to run on so they're handled by EvaluateTape instead
+void ApplyOp(OpCode op, float operand, float& value)
+{
+	switch (op)
+	{
+		case OpCode::Load:		value = operand; break;
+		case OpCode::Add:		OpAdd(operand, value); break;
+		case OpCode::Subtract:	OpSubtract(operand, value); break;
+		case OpCode::Divide:	OpDivide(operand, value); break;
+		case OpCode::Multiply:	OpMultiply(operand, value); break;
+		case OpCode::Negate:	value = -value; break;
+		default: break;
+	}
+}
+
+// Apply a single opcode to a running decimal value, the CalcDecimal backend's equivalent of the above
+void ApplyOp(OpCode op, const CalcDecimal& operand, CalcDecimal& value)
+{
+	switch (op)
+	{
+		case OpCode::Load:		value = operand; break;
+		case OpCode::Add:		value = value.Add(operand); break;
+		case OpCode::Subtract:	value = value.Subtract(operand); break;
+		case OpCode::Divide:	value = value.Divide(operand); break;
+		case OpCode::Multiply:	value = value.Multiply(operand); break;
+		case OpCode::Negate:	value = CalcDecimal().Subtract(value); break;
+		default: break;
+	}
+}
+
+// Values pushed by a tape are kept on the stack up to this depth, only deeper nesting than that allocates
+static const size_t TapeInlineStackSize = 32;
+
+// Interpreter for CalcTape, kept alongside the operations above so they can be inlined into the loop
+float EvaluateTape(const TapeEntry* tape, size_t count, float value)
+{
+	float inlineStack[TapeInlineStackSize];
+	std::vector<float> heapStack;
+	float* stack = inlineStack;
+	size_t depth = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		switch (tape[i].op)
+		{
+			case OpCode::Push:
+			{
+				// Move to the heap once the inline stack is full, it then holds every pushed value
+				if (depth == TapeInlineStackSize && stack == inlineStack)
+				{
+					heapStack.assign(inlineStack, inlineStack + depth);
+				}
+				if (depth >= TapeInlineStackSize)
+				{
+					heapStack.resize(depth + 1);
+					stack = heapStack.data();
+				}
+				stack[depth++] = value;
+				value = tape[i].operand;
+				break;
+			}
+			// Apply the running value to the popped one, i.e. PopSubtract is popped - value
+			case OpCode::PopAdd:
+			case OpCode::PopSubtract:
+			case OpCode::PopDivide:
+			case OpCode::PopMultiply:
+			{
+				float left = depth > 0 ? stack[--depth] : 0.0f;
+				ApplyOp((OpCode)((int)tape[i].op - (int)OpCode::PopAdd + (int)OpCode::Add), value, left);
+				value = left;
+				break;
+			}
+			default:
+				ApplyOp(tape[i].op, tape[i].operand, value);
+				break;
+		}
+	}
+	return value;
+}
+
+/// <summary>
+/// Column versions of the operations, for applying one operation chain to whole arrays of operands at once.
+/// Each has a scalar, SSE and AVX2 kernel; the best one the CPU supports is picked the first time they are used.
+/// Add, subtract, multiply and divide are exactly rounded in every kernel so they all give identical results
+/// </summary>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CALC_COLUMNS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CALC_TARGET_AVX2
+#else
+#define CALC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Columns are evaluated in tiles of this many rows so a chain of operations works on data that's still in cache
+static const size_t ColumnTileRows = 2048;
+
+// Element-wise operations, with the scalar version and a version per vector width
+struct ColumnAdd
+{
+	static float Scalar(float amt, float value) { return value + amt; }
+#ifdef CALC_COLUMNS_X86
+	static __m128 SSE(__m128 amt, __m128 value) { return _mm_add_ps(value, amt); }
+	CALC_TARGET_AVX2 static __m256 AVX2(__m256 amt, __m256 value) { return _mm256_add_ps(value, amt); }
+#endif
+};
+
+struct ColumnSubtract
+{
+	static float Scalar(float amt, float value) { return value - amt; }
+#ifdef CALC_COLUMNS_X86
+	static __m128 SSE(__m128 amt, __m128 value) { return _mm_sub_ps(value, amt); }
+	CALC_TARGET_AVX2 static __m256 AVX2(__m256 amt, __m256 value) { return _mm256_sub_ps(value, amt); }
+#endif
+};
+
+struct ColumnDivide
+{
+	static float Scalar(float amt, float value) { return value / amt; }
+#ifdef CALC_COLUMNS_X86
+	static __m128 SSE(__m128 amt, __m128 value) { return _mm_div_ps(value, amt); }
+	CALC_TARGET_AVX2 static __m256 AVX2(__m256 amt, __m256 value) { return _mm256_div_ps(value, amt); }
+#endif
+};
+
+struct ColumnMultiply
+{
+	static float Scalar(float amt, float value) { return value * amt; }
+#ifdef CALC_COLUMNS_X86
+	static __m128 SSE(__m128 amt, __m128 value) { return _mm_mul_ps(value, amt); }
+	CALC_TARGET_AVX2 static __m256 AVX2(__m256 amt, __m256 value) { return _mm256_mul_ps(value, amt); }
+#endif
+};
+
+template<typename Op>
+static void ColumnScalar(const float* amts, float* values, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = Op::Scalar(amts[i], values[i]);
+	}
+}
+
+#ifdef CALC_COLUMNS_X86
+template<typename Op>
+static void ColumnSSE(const float* amts, float* values, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(values + i, Op::SSE(_mm_loadu_ps(amts + i), _mm_loadu_ps(values + i)));
+	}
+	// Finish off anything that doesn't fill a whole vector
+	ColumnScalar<Op>(amts + i, values + i, count - i);
+}
+
+template<typename Op>
+CALC_TARGET_AVX2 static void ColumnAVX2(const float* amts, float* values, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(values + i, Op::AVX2(_mm256_loadu_ps(amts + i), _mm256_loadu_ps(values + i)));
+	}
+	// Finish off anything that doesn't fill a whole vector
+	ColumnScalar<Op>(amts + i, values + i, count - i);
+}
+
+static bool CpuSupportsAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) { return false; }
+
+	// AVX2 needs the CPU flag as well as the OS saving the YMM registers
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	return osSavesYmm && (info[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
 
+// The kernel for each column operation, indexed by OpCode (Load is a copy for every kernel)
+typedef void (*ColumnFunc)(const float*, float*, size_t);
+struct ColumnKernelTable
+{
+	ColumnKernel kernel;
+	ColumnFunc ops[5];
+};
+
+static void ColumnLoad(const float* amts, float* values, size_t count)
+{
+	memcpy(values, amts, count * sizeof(float));
+}
+
+static ColumnKernelTable MakeColumnKernelTable(ColumnKernel kernel)
+{
+	switch (kernel)
+	{
+#ifdef CALC_COLUMNS_X86
+		case ColumnKernel::AVX2:
+			return { kernel, { ColumnLoad, ColumnAVX2<ColumnAdd>, ColumnAVX2<ColumnSubtract>, ColumnAVX2<ColumnDivide>, ColumnAVX2<ColumnMultiply> } };
+		case ColumnKernel::SSE:
+			return { kernel, { ColumnLoad, ColumnSSE<ColumnAdd>, ColumnSSE<ColumnSubtract>, ColumnSSE<ColumnDivide>, ColumnSSE<ColumnMultiply> } };
+#endif
+		default:
+			return { ColumnKernel::Scalar, { ColumnLoad, ColumnScalar<ColumnAdd>, ColumnScalar<ColumnSubtract>, ColumnScalar<ColumnDivide>, ColumnScalar<ColumnMultiply> } };
+	}
+}
+
+// The best kernel this CPU supports
+static ColumnKernel BestColumnKernel()
+{
+#ifdef CALC_COLUMNS_X86
+	return CpuSupportsAVX2() ? ColumnKernel::AVX2 : ColumnKernel::SSE;
+#else
+	return ColumnKernel::Scalar;
+#endif
+}
+
+static ColumnKernelTable& ActiveColumnKernels()
+{
+	static ColumnKernelTable table = MakeColumnKernelTable(BestColumnKernel());
+	return table;
+}
+
+ColumnKernel GetColumnKernel()
+{
+	return ActiveColumnKernels().kernel;
+}
+
+// Switch kernels (i.e. to compare them), anything the CPU doesn't support falls back to the best one it does. Returns the kernel now in use
+ColumnKernel SetColumnKernel(ColumnKernel kernel)
+{
+	if ((int)kernel > (int)BestColumnKernel()) { kernel = BestColumnKernel(); }
+	ActiveColumnKernels() = MakeColumnKernelTable(kernel);
+	return kernel;
+}
+
+void OpAddColumn(const float* amts, float* values, size_t count)
+{
+	ActiveColumnKernels().ops[(int)OpCode::Add](amts, values, count);
+}
+
+void OpSubtractColumn(const float* amts, float* values, size_t count)
+{
+	ActiveColumnKernels().ops[(int)OpCode::Subtract](amts, values, count);
+}
+
+void OpDivideColumn(const float* bys, float* values, size_t count)
+{
+	ActiveColumnKernels().ops[(int)OpCode::Divide](bys, values, count);
+}
+
+void OpMultiplyColumn(const float* bys, float* values, size_t count)
+{
+	ActiveColumnKernels().ops[(int)OpCode::Multiply](bys, values, count);
+}
+
+// Apply a chain of operations across columns of operands, the column version of EvaluateTape:
+// out[row] starts at 0 and ops[i] is applied with columns[i][row] in order, i.e. { Load, Multiply, Add } with columns { a, b, c } gives a*b+c
+// Only Load, Add, Subtract, Divide and Multiply can be used here
+void EvaluateColumns(const OpCode* ops, const float* const* columns, size_t opCount, float* out, size_t rows)
+{
+	const ColumnKernelTable& kernels = ActiveColumnKernels();
+
+	for (size_t start = 0; start < rows; start += ColumnTileRows)
+	{
+		size_t count = std::min(ColumnTileRows, rows - start);
+		float* tile = out + start;
+
+		if (opCount == 0 || ops[0] != OpCode::Load) { memset(tile, 0, count * sizeof(float)); }
+		for (size_t i = 0; i < opCount; i++)
+		{
+			kernels.ops[(int)ops[i]](columns[i] + start, tile, count);
+		}
+	}
+}
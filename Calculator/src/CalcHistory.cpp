@@ -0,0 +1,301 @@
+#pragma once
+#include "Common.h"
+
+void CalcHistory::BeginEntry(NumericBackend backend)
+{
+	entry.clear();
+	entryDecimal = backend == NumericBackend::Decimal;
+	pendingOp = OpCode::Load;
+}
+
+void CalcHistory::AddOperand(const Operand& operand, bool point)
+{
+	// Merge the operation before the operand into its first byte
+	uint8_t pointScale = point ? operand.scale + 1 : 0;
+	entry.push_back((uint8_t)(OperandTokenBit | ((uint8_t)pendingOp << 4) | (pointScale < PointScaleEscape ? pointScale : PointScaleEscape)));
+	if (pointScale >= PointScaleEscape) { entry.push_back(pointScale); }
+	WriteVarint(entry, (uint64_t)operand.mantissa);
+	pendingOp = OpCode::Load;
+}
+
+void CalcHistory::AddOperation(OpCode op)
+{
+	FlushOperation();
+	pendingOp = op;
+}
+
+void CalcHistory::AddOpen() { FlushOperation(); entry.push_back(OpenToken); }
+void CalcHistory::AddClose() { FlushOperation(); entry.push_back(CloseToken); }
+void CalcHistory::AddEqual() { FlushOperation(); entry.push_back(EqualToken); }
+
+void CalcHistory::FlushOperation()
+{
+	if (pendingOp == OpCode::Load) { return; }
+	entry.push_back((uint8_t)(OperationToken | ((uint8_t)pendingOp << 3)));
+	pendingOp = OpCode::Load;
+}
+
+void CalcHistory::CommitEntry()
+{
+	FlushOperation();
+	AppendRecord(entry.data(), entry.size(), entryDecimal);
+}
+
+void CalcHistory::AppendRecord(const uint8_t* tokens, size_t size, bool decimal)
+{
+	// The log holds its records in its own mapping, so there's nothing here for the memory cap to drop while it's taking them
+	if (log.IsOpen() && !logFailed)
+	{
+		logRecord.clear();
+		WriteVarint(logRecord, (size << 1) | (decimal ? 1 : 0));
+		logRecord.insert(logRecord.end(), tokens, tokens + size);
+		if (log.Append(logRecord.data(), logRecord.size()))
+		{
+			endIndex++;
+			return;
+		}
+
+		// Keep the entry (and the ones after it) in memory instead, numbered on from the log's
+		logFailed = true;
+	}
+
+	// Start a new chunk if the record won't fit in the current one (a record bigger than a chunk gets one to itself)
+	if (chunks.empty() || (chunks.back().count > 0 && chunks.back().data.size() + size + 10 > ChunkSize))
+	{
+		// Make room under our cap, reusing the memory of the oldest chunk we drop
+		Chunk chunk;
+		while (!chunks.empty() && MemoryUsage() + ChunkSize > memoryCap) { DropOldestChunk(chunk); }
+		chunk.data.clear();
+		chunk.data.reserve(ChunkSize);
+		chunk.index.clear();
+		chunk.first = endIndex;
+		chunk.count = 0;
+		chunks.push_back(std::move(chunk));
+	}
+
+	Chunk& chunk = chunks.back();
+	if (chunk.count % IndexStride == 0) { chunk.index.push_back((uint16_t)chunk.data.size()); }
+	WriteVarint(chunk.data, (size << 1) | (decimal ? 1 : 0));
+	chunk.data.insert(chunk.data.end(), tokens, tokens + size);
+	chunk.count++;
+	endIndex++;
+}
+
+void CalcHistory::FormatEntry(size_t index, std::string& out) const
+{
+	out.clear();
+	const uint8_t* p;
+	size_t size;
+	bool decimal;
+	if (!FindRecord(index, p, size, decimal)) { return; }
+	const uint8_t* end = p + size;
+
+	// Rebuild the text as we go, and parse the tokens again in case we need the result
+	formatOperands.clear();
+	formatParser.Reset();
+	bool endsOnEqual = false;
+	char buffer[48];
+
+	// An equals that's carried on from is bracketed the way the active line shows it, closing any brackets left open and
+	// adding one around everything before it unless that's a single operand or bracket
+	int depth = 0;
+	bool spread = false;
+	while (p < end)
+	{
+		uint8_t token = *p++;
+		endsOnEqual = false;
+		if (token & OperandTokenBit)
+		{
+			// The operation merged into the operand comes first
+			OpCode before = (OpCode)((token >> 4) & 7);
+			if (before != OpCode::Load) { FormatOperation(before, out); spread |= depth == 0; }
+
+			Operand op;
+			uint8_t pointScale = token & 0xf;
+			if (pointScale == PointScaleEscape) { pointScale = *p++; }
+			op.mantissa = (int64_t)ReadVarint(p);
+			op.scale = pointScale > 0 ? pointScale - 1 : 0;
+
+			// Whole digits, then the point and the decimal digits (with any leading zeros) if it was written with a point
+			int64_t whole = op.mantissa / PowersOfTen[op.scale];
+			out.append(buffer, snprintf(buffer, sizeof(buffer), "%lld", (long long)whole));
+			if (pointScale > 0)
+			{
+				out.push_back('.');
+				if (op.scale > 0) { out.append(buffer, snprintf(buffer, sizeof(buffer), "%0*lld", (int)op.scale, (long long)(op.mantissa % PowersOfTen[op.scale]))); }
+			}
+
+			formatParser.PushOperand((uint32_t)formatOperands.size());
+			formatOperands.push_back(op);
+			continue;
+		}
+
+		switch (token & 7)
+		{
+			case OperationToken:
+				FormatOperation((OpCode)(token >> 3), out);
+				spread |= depth == 0;
+				break;
+			case OpenToken:
+				out.push_back('(');
+				formatParser.PushOpen();
+				depth++;
+				break;
+			case CloseToken:
+				out.push_back(')');
+				formatParser.PushClose();
+				depth--;
+				break;
+			case EqualToken:
+				formatParser.Seal();
+				endsOnEqual = true;
+				if (p < end)
+				{
+					out.append(depth, ')');
+					if (spread) { out.insert(out.begin(), '('); out.push_back(')'); }
+					depth = 0;
+					spread = false;
+				}
+				break;
+		}
+	}
+
+	// Work the result out again the same way Equals did
+	if (!endsOnEqual) { return; }
+	const CalcNode* root = formatParser.Finish();
+	if (root == nullptr) { return; }
+	out.append("\n=\n");
+	if (decimal)
+	{
+		out.append(EvaluateDecimal(root, formatOperands.data()).ToString());
+	}
+	else
+	{
+		CompileTape(root, formatOperands.data(), formatTape);
+		formatMemo.Evaluate(formatTape);
+		out.append(buffer, formatMemo.FormatResult(buffer, sizeof(buffer)));
+	}
+}
+
+void CalcHistory::FormatOperation(OpCode op, std::string& out) const
+{
+	out.push_back(op == OpCode::Add ? '+' : op == OpCode::Multiply ? '*' : op == OpCode::Divide ? '/' : '-');
+	formatParser.PushOperation(op);
+}
+
+size_t CalcHistory::MemoryUsage() const
+{
+	size_t bytes = entry.capacity() + logRecord.capacity();
+	for (const Chunk& chunk : chunks)
+	{
+		bytes += sizeof(Chunk) + chunk.data.capacity() + chunk.index.capacity() * sizeof(uint16_t);
+	}
+	return bytes;
+}
+
+void CalcHistory::SetMemoryCap(size_t cap)
+{
+	memoryCap = cap;
+	Chunk dropped;
+	while (chunks.size() > 1 && MemoryUsage() > memoryCap) { DropOldestChunk(dropped); }
+}
+
+void CalcHistory::Clear()
+{
+	// A log that's stopped taking entries holds the ones before the chunks, it can't keep them without the chunks after them
+	if (logFailed) { log.Close(); }
+	chunks.clear();
+}
+
+bool CalcHistory::OpenLog(const std::string& path)
+{
+	if (!log.Open(path)) { return false; }
+	logFailed = false;
+
+	// Move what we have in memory over to the end of the log, numbering on from the entries it already has
+	// (anything the log can't take goes back into chunks of its own)
+	std::deque<Chunk> moving;
+	moving.swap(chunks);
+	size_t movingEnd = endIndex;
+	endIndex = log.Count();
+
+	const uint8_t* p;
+	size_t size;
+	bool decimal;
+	for (size_t i = moving.empty() ? movingEnd : moving.front().first; i < movingEnd; i++)
+	{
+		auto it = std::upper_bound(moving.begin(), moving.end(), i, [](size_t index, const Chunk& chunk) { return index < chunk.first; });
+		if (!FindChunkRecord(*(it - 1), i, p, size, decimal)) { continue; }
+		AppendRecord(p, size, decimal);
+	}
+	return true;
+}
+
+bool CalcHistory::FindRecord(size_t index, const uint8_t*& record, size_t& size, bool& decimal) const
+{
+	if (index < FirstIndex() || index >= EndIndex()) { return false; }
+
+	const uint8_t* p;
+	if (log.IsOpen() && index < log.Count())
+	{
+		size_t logSize;
+		if (!log.Read(index, p, logSize)) { return false; }
+		return ParseRecord(p, record, size, decimal);
+	}
+
+	// Find the last chunk starting at or before the entry
+	auto it = std::upper_bound(chunks.begin(), chunks.end(), index, [](size_t i, const Chunk& chunk) { return i < chunk.first; });
+	return FindChunkRecord(*(it - 1), index, record, size, decimal);
+}
+
+bool CalcHistory::FindChunkRecord(const Chunk& chunk, size_t index, const uint8_t*& record, size_t& size, bool& decimal) const
+{
+	// Jump to the nearest indexed record and skip forward from there
+	size_t local = index - chunk.first;
+	const uint8_t* p = chunk.data.data() + chunk.index[local / IndexStride];
+	for (size_t i = 0; i < local % IndexStride; i++)
+	{
+		size_t skip = (size_t)ReadVarint(p) >> 1;
+		p += skip;
+	}
+	return ParseRecord(p, record, size, decimal);
+}
+
+bool CalcHistory::ParseRecord(const uint8_t* p, const uint8_t*& record, size_t& size, bool& decimal)
+{
+	uint64_t header = ReadVarint(p);
+	size = (size_t)(header >> 1);
+	decimal = (header & 1) != 0;
+	record = p;
+	return true;
+}
+
+void CalcHistory::DropOldestChunk(Chunk& reuse)
+{
+	// The log's entries come before every chunk, they have to go first so the entries we have stay in one run
+	if (log.IsOpen()) { log.Close(); }
+	reuse = std::move(chunks.front());
+	chunks.pop_front();
+}
+
+void CalcHistory::WriteVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	// 7 bits at a time, lowest first, with the top bit set on every byte but the last
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+uint64_t CalcHistory::ReadVarint(const uint8_t*& p)
+{
+	uint64_t value = 0;
+	for (int shift = 0; ; shift += 7)
+	{
+		uint8_t byte = *p++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) { return value; }
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <deque>
+
+/// <summary>
+/// Previous calculation streams, kept as compact binary records rather than text. Each record holds the stream's tokens
+/// (operands, operations, brackets and equals) and text is only generated by FormatEntry for the entries actually displayed,
+/// results included, which are worked out again from the tokens. Records are packed into fixed size chunks used as a ring:
+/// once the memory cap is reached the oldest chunk is dropped and its memory reused for the newest entries.
+/// With a log attached (OpenLog) the records are appended to a CalcHistoryLog on disk instead, which keeps every entry.
+/// If the log stops taking records (i.e. the disk is full) the entries it has stay readable and new ones go back to the chunks
+/// </summary>
+
+class CalcHistory {
+
+public:
+	static const size_t DefaultMemoryCap = 16 * 1024 * 1024;
+
+	explicit CalcHistory(size_t memoryCap = DefaultMemoryCap) : memoryCap(memoryCap) {}
+
+	// BUILDING ENTRIES --------------------------------------------------------------------------------------------
+	// Start a new entry, evaluated with the given backend when its result is formatted
+	void BeginEntry(NumericBackend);
+
+	// Add the tokens of the stream in order. point is whether the operand was written with a decimal point (i.e. "5.")
+	void AddOperand(const Operand&, bool point);
+	void AddOperation(OpCode);
+	void AddOpen();
+	void AddClose();
+	void AddEqual();
+
+	// Add the entry to the end of the history (or the log), dropping the oldest entries if we're over our memory cap
+	void CommitEntry();
+
+	// READING ENTRIES --------------------------------------------------------------------------------------------
+	// Entries are numbered from the first ever committed, entries before FirstIndex have been dropped to stay under the memory cap
+	size_t FirstIndex() const { return log.IsOpen() ? 0 : chunks.empty() ? endIndex : chunks.front().first; }
+	size_t EndIndex() const { return endIndex; }
+	size_t Size() const { return EndIndex() - FirstIndex(); }
+
+	// Write the text of an entry to out, the same text the stream showed (ending in "\n=\n" and the result if it ended on an equals)
+	void FormatEntry(size_t index, std::string& out) const;
+
+	// Results of the float entries formatted recently, see CalcMemo for hit/miss counters and setting its capacity
+	CalcMemo& GetResultMemo() const { return formatMemo; }
+
+	// MEMORY --------------------------------------------------------------------------------------------
+	// Bytes held by the history, including unused space at the end of the newest chunk
+	size_t MemoryUsage() const;
+
+	// Change the memory cap, dropping the oldest entries straight away if we're over it.
+	// Records written to a log are in its mapping rather than memory we hold, so the cap only applies to entries kept in memory
+	void SetMemoryCap(size_t);
+	size_t GetMemoryCap() const { return memoryCap; }
+
+	// Drop every entry held in memory (entry numbers carry on from where they were)
+	void Clear();
+
+	// PERSISTENCE --------------------------------------------------------------------------------------------
+	// Keep the history in the log at path from now on, adding the entries we already have after the ones it holds.
+	// Entries are then numbered from the start of the log and the memory cap no longer applies. Returns false if it can't be opened
+	bool OpenLog(const std::string& path);
+
+	// Whether new entries are being written to a log (false once the log has failed to take one)
+	bool HasLog() const { return log.IsOpen() && !logFailed; }
+
+private:
+	// Records are packed into chunks of this size (unless a single record is bigger)
+	static const size_t ChunkSize = 64 * 1024;
+
+	// Chunks keep the offset of every IndexStride'th record, finding any other record means skipping forward from one of those
+	static const size_t IndexStride = 16;
+
+	// Each record is a varint of its length shifted up 1 (with the low bit set for the decimal backend) followed by its tokens.
+	// An operand is a byte of 1ooopppp then its mantissa as a varint, where ooo is the operation before it (Load for none) and
+	// pppp is 0 without a decimal point or its scale + 1 with one (15 means the scale + 1 is in the next byte instead).
+	// Anything else is a byte of 0ooookkk, where kkk is the kind of token below and oooo the operation for OperationTokens
+	enum TokenKind : uint8_t { OperationToken, OpenToken, CloseToken, EqualToken };
+	static const uint8_t OperandTokenBit = 0x80;
+	static const uint8_t PointScaleEscape = 15;
+
+	// Add an operation that didn't get merged into the operand after it
+	void FlushOperation();
+
+	// Add a record's tokens to the end of the log, or the newest chunk if there's no log or it can't take them
+	void AppendRecord(const uint8_t* tokens, size_t size, bool decimal);
+
+	struct Chunk
+	{
+		std::vector<uint8_t> data;
+		std::vector<uint16_t> index;
+		size_t first = 0;
+		size_t count = 0;
+	};
+
+	// Write an operation's symbol to out and push it to the format parser
+	void FormatOperation(OpCode, std::string& out) const;
+
+	// Find where an entry's tokens start, how many bytes they take and which backend it used
+	// Returns false if it's been dropped (or doesn't exist yet)
+	bool FindRecord(size_t index, const uint8_t*& record, size_t& size, bool& decimal) const;
+	bool FindChunkRecord(const Chunk&, size_t index, const uint8_t*& record, size_t& size, bool& decimal) const;
+
+	// Split a record into its header and tokens
+	static bool ParseRecord(const uint8_t* p, const uint8_t*& record, size_t& size, bool& decimal);
+
+	// Drop the oldest chunk, returning its memory for reuse (and the log's entries first, if it's still attached)
+	void DropOldestChunk(Chunk& reuse);
+
+	static void WriteVarint(std::vector<uint8_t>&, uint64_t);
+	static uint64_t ReadVarint(const uint8_t*& p);
+
+	std::deque<Chunk> chunks;
+	size_t endIndex = 0;
+	size_t memoryCap;
+
+	// Where records go when a log is attached, and a buffer to build them in first.
+	// Once an append fails the log is only read from, holding the entries before the first chunk
+	CalcHistoryLog log;
+	std::vector<uint8_t> logRecord;
+	bool logFailed = false;
+
+	// The entry being built, whether it's using the decimal backend and the last operation added (Load if it's been written out)
+	std::vector<uint8_t> entry;
+	bool entryDecimal = false;
+	OpCode pendingOp = OpCode::Load;
+
+	// Scratch space for FormatEntry, kept so formatting doesn't allocate once warmed up
+	mutable std::vector<Operand> formatOperands;
+	mutable CalcParser formatParser;
+	mutable CalcTape formatTape;
+
+	// The UI formats the entries in view every frame, so their results usually come from here already formatted
+	static const size_t ResultMemoCapacity = 256;
+	mutable CalcMemo formatMemo{ ResultMemoCapacity };
+};
@@ -0,0 +1,328 @@
+#pragma once
+#include "Common.h"
+
+#ifdef WL_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Files start with one of these followed by a 32 bit version
+static const char LogMagic[4] = { 'C', 'H', 'L', 'G' };
+static const char IndexMagic[4] = { 'C', 'H', 'I', 'X' };
+static const uint32_t LogVersion = 1;
+
+// The log grows by at least this much at a time so appends rarely have to remap it
+static const size_t MinLogGrowth = 1024 * 1024;
+
+// MAPPED FILE --------------------------------------------------------------------------------------------
+
+#ifdef WL_PLATFORM_WINDOWS
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) { return false; }
+	file = handle;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize)) { Close(); return false; }
+	size = (size_t)fileSize.QuadPart;
+	return size == 0 || Map();
+}
+
+void MappedFile::Close()
+{
+	Unmap();
+	if (file) { CloseHandle((HANDLE)file); }
+	file = nullptr;
+	size = 0;
+}
+
+bool MappedFile::Reserve(size_t newSize)
+{
+	if (newSize <= size) { return true; }
+
+	// Mapping more than the file holds extends it with zeros
+	Unmap();
+	size = newSize;
+	return Map();
+}
+
+void MappedFile::Truncate(size_t newSize)
+{
+	Unmap();
+	LARGE_INTEGER position;
+	position.QuadPart = (LONGLONG)newSize;
+	SetFilePointerEx((HANDLE)file, position, nullptr, FILE_BEGIN);
+	SetEndOfFile((HANDLE)file);
+	size = newSize;
+	if (size > 0) { Map(); }
+}
+
+void MappedFile::Flush(size_t offset, size_t length)
+{
+	if (data) { FlushViewOfFile(data + offset, length); }
+}
+
+bool MappedFile::Map()
+{
+	mapping = CreateFileMappingA((HANDLE)file, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, nullptr);
+	if (!mapping) { return false; }
+	data = (uint8_t*)MapViewOfFile((HANDLE)mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	return data != nullptr;
+}
+
+void MappedFile::Unmap()
+{
+	if (data) { UnmapViewOfFile(data); }
+	if (mapping) { CloseHandle((HANDLE)mapping); }
+	data = nullptr;
+	mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+	file = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (file < 0) { return false; }
+
+	struct stat info;
+	if (fstat(file, &info) != 0) { Close(); return false; }
+	size = (size_t)info.st_size;
+	return size == 0 || Map();
+}
+
+void MappedFile::Close()
+{
+	Unmap();
+	if (file >= 0) { close(file); }
+	file = -1;
+	size = 0;
+}
+
+bool MappedFile::Reserve(size_t newSize)
+{
+	if (newSize <= size) { return true; }
+	Unmap();
+	if (ftruncate(file, (off_t)newSize) != 0) { Map(); return false; }
+	size = newSize;
+	return Map();
+}
+
+void MappedFile::Truncate(size_t newSize)
+{
+	Unmap();
+	if (ftruncate(file, (off_t)newSize) == 0) { size = newSize; }
+	if (size > 0) { Map(); }
+}
+
+void MappedFile::Flush(size_t offset, size_t length)
+{
+	if (!data) { return; }
+
+	// msync needs a page aligned start
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = offset & ~(page - 1);
+	msync(data + start, length + (offset - start), MS_ASYNC);
+}
+
+bool MappedFile::Map()
+{
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (p == MAP_FAILED) { return false; }
+	data = (uint8_t*)p;
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+	if (data) { munmap(data, size); }
+	data = nullptr;
+}
+
+#endif
+
+// HISTORY LOG --------------------------------------------------------------------------------------------
+
+bool CalcHistoryLog::Open(const std::string& path)
+{
+	Close();
+	if (!log.Open(path) || !index.Open(path + ".idx")) { Close(); return false; }
+
+	// A new log gets a header, an existing one has to be one of ours
+	if (log.Size() == 0)
+	{
+		if (!log.Reserve(HeaderSize)) { Close(); return false; }
+		memcpy(log.Data(), LogMagic, 4);
+		memcpy(log.Data() + 4, &LogVersion, 4);
+	}
+	if (log.Size() < HeaderSize || memcmp(log.Data(), LogMagic, 4) != 0 || Read32(log.Data() + 4) != LogVersion) { Close(); return false; }
+
+	// The index can always be rebuilt from the log, so start it again if it's missing or damaged
+	if (index.Size() < HeaderSize || memcmp(index.Data(), IndexMagic, 4) != 0)
+	{
+		index.Truncate(0);
+		if (!index.Reserve(HeaderSize)) { Close(); return false; }
+		memcpy(index.Data(), IndexMagic, 4);
+		memcpy(index.Data() + 4, &LogVersion, 4);
+	}
+
+	// Reads trust the index, so only keep the entries up to the first damaged one (there's one per IndexStride records, so this is quick).
+	// Then back off to the last entry pointing at a valid record, ignoring any zeros or half written entries after it
+	size_t entries = 0;
+	size_t lastOffset = 0;
+	for (size_t available = (index.Size() - HeaderSize) / IndexEntrySize; entries < available; entries++)
+	{
+		size_t entryOffset = IndexEntryOffset(entries);
+		if (entryOffset <= lastOffset) { break; }
+		lastOffset = entryOffset;
+	}
+	size_t offset = HeaderSize;
+	while (entries > 0)
+	{
+		size_t entryOffset = IndexEntryOffset(entries - 1);
+		if (ValidRecordSize(entryOffset) != 0) { offset = entryOffset; break; }
+		entries--;
+	}
+	count = entries > 0 ? (entries - 1) * IndexStride : 0;
+
+	// Only the records after it need checking, stopping at the first one that's torn or was never written
+	while (size_t recordSize = ValidRecordSize(offset))
+	{
+		if (count % IndexStride == 0 && count / IndexStride >= entries)
+		{
+			if (!WriteIndexEntry(count / IndexStride, offset)) { Close(); return false; }
+			entries++;
+		}
+		offset += FrameSize + recordSize;
+		count++;
+	}
+	logEnd = offset;
+
+	// Drop whatever comes after the last good record so it can't be mistaken for one later
+	log.Truncate(logEnd);
+	index.Truncate(HeaderSize + entries * IndexEntrySize);
+	return log.Data() != nullptr && index.Data() != nullptr;
+}
+
+void CalcHistoryLog::Close()
+{
+	if (IsOpen())
+	{
+		log.Truncate(logEnd);
+		index.Truncate(HeaderSize + (count + IndexStride - 1) / IndexStride * IndexEntrySize);
+	}
+	log.Close();
+	index.Close();
+	logEnd = 0;
+	count = 0;
+}
+
+bool CalcHistoryLog::Append(const uint8_t* record, size_t size)
+{
+	if (!IsOpen() || size == 0 || size > UINT32_MAX) { return false; }
+
+	size_t end = logEnd + FrameSize + size;
+	if (end > log.Size() && !log.Reserve(std::max(end, std::max(log.Size() * 2, MinLogGrowth)))) { return false; }
+
+	// The CRC covers the record, so if it doesn't all make it to disk the frame won't check out
+	uint8_t* frame = log.Data() + logEnd;
+	uint32_t length = (uint32_t)size;
+	uint32_t crc = Crc32(record, size);
+	memcpy(frame + FrameSize, record, size);
+	memcpy(frame, &length, 4);
+	memcpy(frame + 4, &crc, 4);
+
+	if (count % IndexStride == 0 && !WriteIndexEntry(count / IndexStride, logEnd)) { return false; }
+	log.Flush(logEnd, end - logEnd);
+	logEnd = end;
+	count++;
+	return true;
+}
+
+bool CalcHistoryLog::Read(size_t i, const uint8_t*& record, size_t& size) const
+{
+	if (i >= count) { return false; }
+
+	// Jump to the nearest indexed record and skip forward from there
+	const uint8_t* p = log.Data() + Read64(index.Data() + HeaderSize + i / IndexStride * IndexEntrySize);
+	for (size_t skip = 0; skip < i % IndexStride; skip++)
+	{
+		p += FrameSize + Read32(p);
+	}
+	size = Read32(p);
+	record = p + FrameSize;
+	return true;
+}
+
+size_t CalcHistoryLog::ValidRecordSize(size_t offset) const
+{
+	if (offset + FrameSize > log.Size()) { return 0; }
+	const uint8_t* frame = log.Data() + offset;
+	size_t length = Read32(frame);
+	if (length == 0 || length > log.Size() - offset - FrameSize) { return 0; }
+	return Crc32(frame + FrameSize, length) == Read32(frame + 4) ? length : 0;
+}
+
+bool CalcHistoryLog::WriteIndexEntry(size_t entry, size_t offset)
+{
+	size_t position = HeaderSize + entry * IndexEntrySize;
+	if (position + IndexEntrySize > index.Size() && !index.Reserve(std::max(position + IndexEntrySize, index.Size() * 2))) { return false; }
+
+	uint8_t* p = index.Data() + position;
+	uint64_t value = offset;
+	memcpy(p, &value, 8);
+	uint32_t crc = Crc32(p, 8);
+	memcpy(p + 8, &crc, 4);
+	memset(p + 12, 0, 4);
+	index.Flush(position, IndexEntrySize);
+	return true;
+}
+
+size_t CalcHistoryLog::IndexEntryOffset(size_t entry) const
+{
+	size_t position = HeaderSize + entry * IndexEntrySize;
+	if (position + IndexEntrySize > index.Size()) { return 0; }
+	const uint8_t* p = index.Data() + position;
+	uint64_t offset = Read64(p);
+	if (Crc32(p, 8) != Read32(p + 8) || offset < HeaderSize || offset >= log.Size()) { return 0; }
+	return (size_t)offset;
+}
+
+// CRC32 --------------------------------------------------------------------------------------------
+
+// Lookup table for every byte value, built the first time it's needed
+struct Crc32Table
+{
+	uint32_t values[256];
+
+	Crc32Table()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int bit = 0; bit < 8; bit++) { c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1; }
+			values[i] = c;
+		}
+	}
+};
+
+uint32_t Crc32(const uint8_t* data, size_t size)
+{
+	static const Crc32Table table;
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc ^ 0xFFFFFFFFu;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <cstring>
+
+/// <summary>
+/// A file mapped into memory that can grow. The file is extended ahead of what's been written so appends are just
+/// copies into the mapping, Truncate cuts it back to what's actually in use
+/// </summary>
+
+class MappedFile {
+
+public:
+	MappedFile() {}
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Open (or create) a file and map all of it, returns false if it can't be opened
+	bool Open(const std::string& path);
+	void Close();
+
+	// Make sure at least size bytes are mapped, extending the file with zeros if needed (the mapping may move)
+	bool Reserve(size_t size);
+
+	// Cut the file down to size bytes
+	void Truncate(size_t size);
+
+	// Start writing a range of the file back to disk, without waiting for it to get there
+	void Flush(size_t offset, size_t length);
+
+	uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	// Map the whole file at its current size
+	bool Map();
+	void Unmap();
+
+	uint8_t* data = nullptr;
+	size_t size = 0;
+
+#ifdef WL_PLATFORM_WINDOWS
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
+
+/// <summary>
+/// Append-only history log on disk. Records are framed with their length and a CRC32 of their bytes, so a record torn by a crash
+/// is detected and everything from it onwards dropped the next time the log is opened. A sparse index in a second file
+/// (path + ".idx") holds the offset of every IndexStride'th record. Both files are memory-mapped: opening only checks the records
+/// written since the last index entry, and records are only read when they're asked for
+/// </summary>
+
+class CalcHistoryLog {
+
+public:
+	// Open (or create) the log at path, returns false if it can't be opened or isn't a history log
+	bool Open(const std::string& path);
+
+	// Cut the files back to what's in use and close them
+	void Close();
+
+	bool IsOpen() const { return log.Data() != nullptr; }
+
+	// Add a record to the end of the log
+	bool Append(const uint8_t* record, size_t size);
+
+	// Get the bytes of a record (valid until the next Append), returns false if there's no such record
+	bool Read(size_t index, const uint8_t*& record, size_t& size) const;
+
+	size_t Count() const { return count; }
+
+	~CalcHistoryLog() { Close(); }
+
+private:
+	static const size_t IndexStride = 256;
+
+	// Bytes before the first record or index entry
+	static const size_t HeaderSize = 16;
+
+	// Each record is framed by its length and CRC32
+	static const size_t FrameSize = 8;
+
+	// Each index entry is a record offset and the CRC32 of it
+	static const size_t IndexEntrySize = 16;
+
+	// Get the size of the valid record at offset, or 0 if there isn't one (a torn or unwritten record)
+	size_t ValidRecordSize(size_t offset) const;
+
+	// Write the index entry for record entry * IndexStride
+	bool WriteIndexEntry(size_t entry, size_t offset);
+
+	// Get the offset stored in an index entry, or 0 if it isn't valid
+	size_t IndexEntryOffset(size_t entry) const;
+
+	// Read a 32 or 64 bit value from a mapping (records aren't aligned)
+	static uint32_t Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+	static uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+	MappedFile log;
+	MappedFile index;
+
+	// Where the next record goes in the log, and how many records come before it
+	size_t logEnd = 0;
+	size_t count = 0;
+};
+
+// CRC32 (the zlib/PNG polynomial) of size bytes
+uint32_t Crc32(const uint8_t* data, size_t size);
@@ -0,0 +1,336 @@
+#pragma once
+#include "Common.h"
+
+// Where an entry's result starts in its formatted text
+static const char ResultSeparator[] = "\n=\n";
+
+static void WritePostingDelta(std::vector<uint8_t>& out, size_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static size_t ReadPostingDelta(const uint8_t*& p)
+{
+	size_t value = 0;
+	for (int shift = 0; ; shift += 7)
+	{
+		uint8_t byte = *p++;
+		value |= (size_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) { return value; }
+	}
+}
+
+int CalcHistorySearch::CharCode(char c)
+{
+	if (c >= '0' && c <= '9') { return c - '0'; }
+	switch (c)
+	{
+		case '+': return 10;
+		case '-': return 11;
+		case '*': return 12;
+		case '/': return 13;
+		case '.': return 14;
+		case '(': case ')': return 15;
+		default: return NoCode;
+	}
+}
+
+void CalcHistorySearch::Update(const CalcHistory& history, size_t maxEntries)
+{
+	// Entries dropped from the history before we got to them are skipped
+	if (indexedEnd < history.FirstIndex()) { indexedEnd = history.FirstIndex(); }
+
+	size_t end = history.EndIndex() - indexedEnd > maxEntries ? indexedEnd + maxEntries : history.EndIndex();
+	for (; indexedEnd < end; indexedEnd++)
+	{
+		history.FormatEntry(indexedEnd, text);
+		size_t textEnd = text.find(ResultSeparator);
+
+		if (textEnd != std::string::npos)
+		{
+			// Only results that are a number all the way through, strtod reads the Decimal backend's "Error" as 0
+			const char* result = text.c_str() + textEnd + sizeof(ResultSeparator) - 1;
+			char* resultEnd;
+			double value = strtod(result, &resultEnd);
+			if (resultEnd != result && *resultEnd == '\0' && !std::isnan(value)) { AddResult(value, indexedEnd); }
+		}
+		else
+		{
+			textEnd = text.size();
+		}
+
+		if (textEnd < 3) { shortTexts.push_back((uint32_t)indexedEnd); }
+
+		// Each distinct trigram in the text adds the entry to its list once
+		entryTrigrams.clear();
+		for (size_t i = 0; i + 3 <= textEnd; i++)
+		{
+			int a = CharCode(text[i]), b = CharCode(text[i + 1]), c = CharCode(text[i + 2]);
+			if (a == NoCode || b == NoCode || c == NoCode) { continue; }
+			entryTrigrams.push_back((uint16_t)((a << 8) | (b << 4) | c));
+		}
+		std::sort(entryTrigrams.begin(), entryTrigrams.end());
+		entryTrigrams.erase(std::unique(entryTrigrams.begin(), entryTrigrams.end()), entryTrigrams.end());
+		for (uint16_t key : entryTrigrams)
+		{
+			PostingList& list = trigrams[key];
+			WritePostingDelta(list.deltas, indexedEnd - list.last);
+			list.last = indexedEnd;
+			list.count++;
+		}
+	}
+}
+
+void CalcHistorySearch::AddResult(double value, size_t entry)
+{
+	pending.values.push_back(value);
+	pending.entries.push_back((uint32_t)entry);
+	if (pending.values.size() < PendingSize) { return; }
+
+	// Sort the pending results into a run, then merge runs of about the same size so there are only ever O(log n) of them
+	candidates.resize(pending.values.size());
+	for (uint32_t i = 0; i < candidates.size(); i++) { candidates[i] = i; }
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b)
+		{
+			return pending.values[a] < pending.values[b] || (pending.values[a] == pending.values[b] && pending.entries[a] < pending.entries[b]);
+		});
+	ResultRun run;
+	run.values.reserve(candidates.size());
+	run.entries.reserve(candidates.size());
+	for (uint32_t i : candidates)
+	{
+		run.values.push_back(pending.values[i]);
+		run.entries.push_back(pending.entries[i]);
+	}
+	pending.values.clear();
+	pending.entries.clear();
+
+	while (!runs.empty() && runs.back().values.size() <= run.values.size())
+	{
+		MergeRuns(run, runs.back());
+		runs.pop_back();
+	}
+	runs.push_back(std::move(run));
+}
+
+void CalcHistorySearch::MergeRuns(ResultRun& a, const ResultRun& b)
+{
+	ResultRun out;
+	out.values.resize(a.values.size() + b.values.size());
+	out.entries.resize(out.values.size());
+	size_t i = 0, j = 0, k = 0;
+	while (i < a.values.size() || j < b.values.size())
+	{
+		bool takeA = j == b.values.size() || (i < a.values.size() &&
+			(a.values[i] < b.values[j] || (a.values[i] == b.values[j] && a.entries[i] < b.entries[j])));
+		const ResultRun& from = takeA ? a : b;
+		size_t& index = takeA ? i : j;
+		out.values[k] = from.values[index];
+		out.entries[k++] = from.entries[index++];
+	}
+	a = std::move(out);
+}
+
+size_t CalcHistorySearch::FindResults(const CalcHistory& history, double low, double high, std::vector<size_t>& out, size_t limit) const
+{
+	// The runs still hold entries the history has dropped to stay under its memory cap, they're skipped here
+	out.clear();
+	candidates.clear();
+	size_t first = history.FirstIndex();
+	for (const ResultRun& run : runs)
+	{
+		size_t i = std::lower_bound(run.values.begin(), run.values.end(), low) - run.values.begin();
+		for (; i < run.values.size() && run.values[i] <= high; i++)
+		{
+			if (run.entries[i] >= first) { candidates.push_back(run.entries[i]); }
+		}
+	}
+	for (size_t i = 0; i < pending.values.size(); i++)
+	{
+		if (pending.values[i] >= low && pending.values[i] <= high && pending.entries[i] >= first) { candidates.push_back(pending.entries[i]); }
+	}
+
+	// Only the newest limit need sorting
+	size_t count = std::min(limit, candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), std::greater<uint32_t>());
+	out.assign(candidates.begin(), candidates.begin() + count);
+	return candidates.size();
+}
+
+size_t CalcHistorySearch::FindText(const CalcHistory& history, const std::string& query, std::vector<size_t>& out, size_t limit) const
+{
+	out.clear();
+	if (query.empty() || limit == 0) { return 0; }
+
+	// Gather the query's trigrams, rarest first so the intersection starts small
+	const PostingList* lists[64];
+	size_t listCount = 0;
+	bool indexable = true;
+	for (size_t i = 0; i < query.size(); i++) { indexable = indexable && CharCode(query[i]) != NoCode; }
+	if (indexable && query.size() < 3) { return FindShortText(history, query, out, limit); }
+	for (size_t i = 0; indexable && i + 3 <= query.size() && listCount < 64; i++)
+	{
+		lists[listCount++] = &trigrams[(CharCode(query[i]) << 8) | (CharCode(query[i + 1]) << 4) | CharCode(query[i + 2])];
+	}
+	std::sort(lists, lists + listCount, [](const PostingList* a, const PostingList* b) { return a->count < b->count; });
+
+	if (listCount == 0)
+	{
+		// Too short (or not made of calculator characters) to use the index, check entries newest first instead
+		for (size_t entry = indexedEnd; entry-- > history.FirstIndex() && out.size() < limit; )
+		{
+			if (EntryContains(history, entry, query)) { out.push_back(entry); }
+		}
+		return out.size();
+	}
+
+	for (size_t i = 0; i < listCount && (i == 0 || !candidates.empty()); i++)
+	{
+		ReadPostings(*lists[i], candidates, i > 0);
+	}
+
+	// The trigrams can all be there without being in a row (and brackets share a code), so check each candidate's text
+	for (size_t i = candidates.size(); i-- > 0 && out.size() < limit; )
+	{
+		if (candidates[i] < history.FirstIndex()) { break; }
+		if (EntryContains(history, candidates[i], query)) { out.push_back(candidates[i]); }
+	}
+	return out.size();
+}
+
+size_t CalcHistorySearch::Find(const CalcHistory& history, const std::string& query, std::vector<size_t>& out, size_t limit) const
+{
+	if (!query.empty() && query[0] == '=')
+	{
+		char* end;
+		double value = strtod(query.c_str() + 1, &end);
+		if (end == query.c_str() + 1 || *end != '\0') { out.clear(); return 0; }
+		return FindResults(history, value, value, out, limit);
+	}
+	return FindText(history, query, out, limit);
+}
+
+void CalcHistorySearch::ReadPostings(const PostingList& list, std::vector<uint32_t>& out, bool intersect)
+{
+	const uint8_t* p = list.deltas.data();
+	const uint8_t* end = p + list.deltas.size();
+	size_t entry = 0;
+	size_t kept = 0;
+	size_t next = 0;
+	if (!intersect) { out.clear(); }
+	while (p < end && (!intersect || next < out.size()))
+	{
+		entry += ReadPostingDelta(p);
+
+		if (!intersect) { out.push_back((uint32_t)entry); continue; }
+
+		// Both are sorted, so walk them together keeping what's in both
+		while (next < out.size() && out[next] < entry) { next++; }
+		if (next < out.size() && out[next] == entry) { out[kept++] = out[next++]; }
+	}
+	if (intersect) { out.resize(kept); }
+}
+
+size_t CalcHistorySearch::FindShortText(const CalcHistory& history, const std::string& query, std::vector<size_t>& out, size_t limit) const
+{
+	// Every entry in the list of a trigram containing the query contains it too, so between them they list every match
+	// (apart from short entries, and brackets sharing a code)
+	const PostingList* lists[3 * 256];
+	size_t listCount = 0;
+	size_t postings = shortTexts.size();
+	int a = CharCode(query[0]);
+	for (int x = 0; x < 16; x++)
+	{
+		for (int y = 0; y < 16; y++)
+		{
+			if (query.size() == 1)
+			{
+				lists[listCount++] = &trigrams[(a << 8) | (x << 4) | y];
+				lists[listCount++] = &trigrams[(x << 8) | (a << 4) | y];
+				lists[listCount++] = &trigrams[(x << 8) | (y << 4) | a];
+			}
+		}
+		if (query.size() == 2)
+		{
+			int b = CharCode(query[1]);
+			lists[listCount++] = &trigrams[(a << 8) | (b << 4) | x];
+			lists[listCount++] = &trigrams[(x << 8) | (a << 4) | b];
+		}
+	}
+	for (size_t i = 0; i < listCount; i++) { postings += lists[i]->count; }
+
+	// With about as many postings as entries, matches are common enough that checking the newest entries finds them quickly,
+	// otherwise mark every entry in the lists and check those from newest to oldest
+	size_t first = history.FirstIndex();
+	if (postings >= indexedEnd - std::min(first, indexedEnd))
+	{
+		for (size_t entry = indexedEnd; entry-- > first && out.size() < limit; )
+		{
+			if (EntryContains(history, entry, query)) { out.push_back(entry); }
+		}
+		return out.size();
+	}
+
+	marks.assign((indexedEnd + 63) / 64, 0);
+	for (size_t i = 0; i < listCount; i++) { MarkPostings(*lists[i], marks); }
+	for (uint32_t entry : shortTexts) { marks[entry / 64] |= 1ull << (entry % 64); }
+
+	for (size_t word = marks.size(); word-- > first / 64 && out.size() < limit; )
+	{
+		for (uint64_t bits = marks[word]; bits != 0 && out.size() < limit; )
+		{
+			// Highest bit first so they come out newest first
+			int bit = 63;
+			while (!(bits >> bit)) { bit--; }
+			bits &= ~(1ull << bit);
+
+			size_t entry = word * 64 + bit;
+			if (entry >= first && EntryContains(history, entry, query)) { out.push_back(entry); }
+		}
+	}
+	return out.size();
+}
+
+void CalcHistorySearch::MarkPostings(const PostingList& list, std::vector<uint64_t>& marks)
+{
+	const uint8_t* p = list.deltas.data();
+	const uint8_t* end = p + list.deltas.size();
+	size_t entry = 0;
+	while (p < end)
+	{
+		entry += ReadPostingDelta(p);
+		marks[entry / 64] |= 1ull << (entry % 64);
+	}
+}
+
+bool CalcHistorySearch::EntryContains(const CalcHistory& history, size_t entry, const std::string& query) const
+{
+	history.FormatEntry(entry, text);
+	size_t textEnd = text.find(ResultSeparator);
+	size_t found = text.find(query);
+	return found != std::string::npos && (textEnd == std::string::npos || found + query.size() <= textEnd);
+}
+
+size_t CalcHistorySearch::MemoryUsage() const
+{
+	size_t bytes = trigrams.capacity() * sizeof(PostingList) + pending.values.capacity() * sizeof(double) + pending.entries.capacity() * sizeof(uint32_t);
+	for (const PostingList& list : trigrams) { bytes += list.deltas.capacity(); }
+	bytes += shortTexts.capacity() * sizeof(uint32_t);
+	for (const ResultRun& run : runs) { bytes += run.values.capacity() * sizeof(double) + run.entries.capacity() * sizeof(uint32_t); }
+	return bytes;
+}
+
+void CalcHistorySearch::Clear()
+{
+	trigrams.assign(TrigramCount, PostingList());
+	runs.clear();
+	shortTexts.clear();
+	pending.values.clear();
+	pending.entries.clear();
+	indexedEnd = 0;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CalcHistory;
+
+/// <summary>
+/// Search index over a CalcHistory, added to as entries are archived. Results are kept in sorted runs of (value, entry) that are
+/// merged like a binary counter (so adding is amortized O(log n) and a lookup is a binary search per run), and the text before the
+/// result has a trigram index: a delta-encoded list of the entries containing each run of 3 characters. Text queries intersect
+/// the lists of the query's trigrams and only format the candidates left to check them. Queries of 1 or 2 characters use every list
+/// of a trigram containing them instead
+/// </summary>
+
+class CalcHistorySearch {
+
+public:
+	// Index entries added to the history since the last Update, oldest first, at most maxEntries of them (the rest wait for the next call)
+	void Update(const CalcHistory&, size_t maxEntries = SIZE_MAX);
+
+	// Entries before this have been indexed
+	size_t IndexedEnd() const { return indexedEnd; }
+
+	// Entries still in the history whose result is between low and high (inclusive). Writes up to limit of them to out, newest first,
+	// and returns how many there are
+	size_t FindResults(const CalcHistory&, double low, double high, std::vector<size_t>& out, size_t limit) const;
+
+	// Entries whose text (not including the result) contains text. Writes up to limit of them to out, newest first, and
+	// returns how many it found (stopping at limit)
+	size_t FindText(const CalcHistory&, const std::string& text, std::vector<size_t>& out, size_t limit) const;
+
+	// Search with a query as typed by the user: "=1234.5" finds entries with that result, anything else entries containing it
+	size_t Find(const CalcHistory&, const std::string& query, std::vector<size_t>& out, size_t limit) const;
+
+	// Bytes held by the index
+	size_t MemoryUsage() const;
+
+	void Clear();
+
+private:
+	// Characters are folded to 4 bit codes for the trigram keys, the brackets share one (matches are checked against the text anyway)
+	static int CharCode(char);
+	static const size_t TrigramCount = 16 * 16 * 16;
+
+	// Entries with a character outside the 16 codes aren't given a trigram containing it, text queries with one fall back to a scan
+	static const int NoCode = -1;
+
+	// Results are sorted into a new run every PendingSize entries
+	static const size_t PendingSize = 1024;
+
+	struct PostingList
+	{
+		// Gaps between the entries containing the trigram as varints
+		std::vector<uint8_t> deltas;
+		size_t last = 0;
+		size_t count = 0;
+	};
+
+	struct ResultRun
+	{
+		// Sorted by value then entry
+		std::vector<double> values;
+		std::vector<uint32_t> entries;
+	};
+
+	void AddResult(double value, size_t entry);
+
+	// Merge b into a (both sorted)
+	static void MergeRuns(ResultRun& a, const ResultRun& b);
+
+	// Decode a posting list into out, or intersect it with what's already in out if intersect is set
+	static void ReadPostings(const PostingList&, std::vector<uint32_t>& out, bool intersect);
+
+	// Set the bit of every entry in a posting list
+	static void MarkPostings(const PostingList&, std::vector<uint64_t>& marks);
+
+	// Find entries containing a query too short to have a trigram of its own
+	size_t FindShortText(const CalcHistory&, const std::string& query, std::vector<size_t>& out, size_t limit) const;
+
+	// Whether an entry's text contains text, formatting it to find out
+	bool EntryContains(const CalcHistory&, size_t entry, const std::string& text) const;
+
+	std::vector<PostingList> trigrams = std::vector<PostingList>(TrigramCount);
+	std::vector<ResultRun> runs;
+	ResultRun pending;
+	size_t indexedEnd = 0;
+
+	// Entries with less than 3 characters of text, which aren't in any trigram's list
+	std::vector<uint32_t> shortTexts;
+
+	// Scratch space, kept so searching and indexing only allocate while they're warming up
+	mutable std::string text;
+	mutable std::vector<uint32_t> candidates;
+	mutable std::vector<uint64_t> marks;
+	std::vector<uint16_t> entryTrigrams;
+};
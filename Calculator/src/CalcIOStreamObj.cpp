@@ -7,25 +7,33 @@
 	/// Dictates rules and behaviour for input when passed in (only allows certain actions after certain other actions etc..)
 	/// </summary>
 
+	CalcIOStreamObj::CalcIOStreamObj() :
+		prevActions(arena),
+		activeOpString(CalcArenaAllocator<char>(arena)),
+		actionEnds(arena),
+		operations(arena),
+		previewStates(arena),
+		previewString(CalcArenaAllocator<char>(arena)),
+		symbols(arena),
+		operands(arena),
+		versions(CalcArenaAllocator<StreamVersion>(arena))
+	{
+		ResetStreamStorage();
+	}
+
 	void CalcIOStreamObj::ClearOperations()
 	{
 		// If we've only got 1 value of 0 in the IO stream don't bother clearing
-		if (nums[0][0] == 0 && prevActions.size() == 2) { return; }
+		if (operands.size() > 0 && operands.back().mantissa == 0 && prevActions.size() == 2) { return; }
 
-		// Push our active operations line into our previous operations line
-		prevOpString.push_back("--------------\n");
-		prevOpString.push_back(activeOpString);
-		//prevOpString.push_back("\n");
+		// Push our active operations into our previous operations
+		ArchiveStream();
 
 		// Clear all of our operation lists
-		operations.clear();
-		nums.clear();
-		symbols.clear();
-		decimals.clear();
-		prevActions.clear();
-
-		// Set our default action
-		prevActions = { Action::Start };
+		ResetStreamStorage();
+		parser.Reset();
+		parserDirty = false;
+		openBrackets = 0;
 
 		// Reset our calculation value to 0 and reflect it on any linked UI using the AddNum code path
 		curVal = 0.0f;
@@ -40,33 +48,44 @@
 			case Action::Start:
 				AddNum(0.0f);
 				return;
-			// Delete the last number and if we're left with an empty vector remove it
+			// Delete the last digit and if we're left with no digits remove the operand
 			case Action::Number:
-				if (nums[nums.size() - 1].size() > 0)
-				{
-					nums[nums.size() - 1].pop_back();
-					if (nums[nums.size()-1].size() == 0) { nums.pop_back(); }
-				}
+			{
+				Operand op = operands.back();
+				op.mantissa /= 10;
+				op.digits--;
+				if (op.digits == 0) { operands.pop_back(); }
+				else { operands.replace_back(op); }
 				break;
+			}
 			//Delete the last operation and symbol
 			case Action::Operation:
 				operations.pop_back();
 				symbols.pop_back();
 				break;
-			// Delete the last decimal and if we're left with an empty vector remove it 
+			case Action::Open:
+				openBrackets--;
+				break;
+			case Action::Close:
+				openBrackets++;
+				break;
+			// Delete the last decimal digit, if there are none left this action was the decimal point itself so there's nothing to remove
 			case Action::Decimal:
-				if (decimals[nums.size()-1].size() > 0)
+				if (operands.back().scale > 0)
 				{
-					decimals[nums.size()-1].pop_back();
-				}
-				else
-				{
-					decimals.pop_back();
+					Operand op = operands.back();
+					op.mantissa /= 10;
+					op.scale--;
+					op.digits--;
+					operands.replace_back(op);
 				}
 				break;
 		}
-		// Remove the last action once we've handled it
-		prevActions.pop_back();
+		// Remove the last action (and its text) once we've handled it
+		PopAction();
+
+		// The parser can't remove tokens, rebuild it when we next need it
+		parserDirty = true;
 
 		// If we remove the last action for some reason reset the stream to 0
 		if (prevActions.size() <= 1)
@@ -82,71 +101,125 @@
 	{
 		switch (prevActions.back())
 		{
-			// Terminate as an equal is not a valid operation after another operation
+			// Terminate as an equal is not a valid operation after another operation or an opening bracket
 			case Action::Operation:
+			case Action::Open:
 				return;
 		}
 
 		// Break here if we have no operations at all in the IO stream as there's nothing to calculate other than the 1st value
 		if (operations.size() == 0)
 		{
-			curVal = nums[0][0];
+			curVal = operands.back().Value();
 			GenerateStringFromStream();
 			return;
 		}
 
-		// Set our current value to the first num/decimal set
-		curVal = GetCurrentFloatWithDecimals(0);
-
-		// Set curVal based on all nums, decimals, and operations calculated together
-		for (int i = 0; i < operations.size(); i++)
+		switch (numericBackend)
 		{
-			operations[i](GetCurrentFloatWithDecimals(i+1), curVal);
+			case NumericBackend::Float:
+			{
+				// The value has been kept up to date as the stream was typed, so just close any open brackets
+				curVal = PreviewValue();
+				char buffer[64];
+				SetResult(buffer, FormatFloat(curVal, buffer, sizeof(buffer)));
+				break;
+			}
+			// Calculate exactly from the operands themselves, using the tree for the whole stream
+			case NumericBackend::Decimal:
+			{
+				if (parserDirty) { ReparseStream(); }
+				const CalcNode* root = parser.Finish();
+				if (root == nullptr) { return; }
+				operands.CopyTo(walkOperands);
+				CalcDecimal value = EvaluateDecimal(root, walkOperands.data());
+				curVal = value.ToFloat();
+				std::string s = value.ToString();
+				SetResult(s.data(), s.size());
+				break;
+			}
 		}
 
-		// Add our action
-		prevActions.push_back(Action::Equal);
+		// Add our action (it has no text on the active line, the result is appended in GenerateStringFromStream)
+		PushAction(Action::Equal, "");
+
+		// Anything added after this applies to the result, not just the last operand
+		parser.Seal();
+		openBrackets = 0;
 		
 		// Generate a string to reflect this action
 		GenerateStringFromStream();
 	}
 
-	float CalcIOStreamObj::GetCurrentFloatWithDecimals(int numIndex)
+	void CalcIOStreamObj::Undo()
 	{
-		// We need to add format all of the relevant num entries into a single number (rather than add them) i.e. 5,5 becomes 55, rather than 10
-		std::string s;
-		for (int i = 0; i < nums[numIndex].size(); i++)
-		{
-			s.append(std::to_string(nums[numIndex][i]));
-		}
-		float f = stof(s);
+		if (version == 0) { return; }
+		RestoreVersion(version - 1);
+	}
 
-		// Append decimals to associated numbers if we have any
-		if (decimals[numIndex].size() > 0)
-		{
-			for (int d = 0; d < decimals[numIndex].size(); d++)
-			{
-				f = f + (decimals[numIndex][d]) / pow(10, d+1);
-			}
-		}
-		return f;
+	void CalcIOStreamObj::Redo()
+	{
+		RestoreVersion(version + 1);
 	}
 
-	void CalcIOStreamObj::AddOperation(std::function<void(float amt, float& value)> fnc, char inChar)
+	void CalcIOStreamObj::RestoreVersion(size_t index)
 	{
+		if (index >= versions.size() || index == version) { return; }
+		version = index;
+		Restore(versions[version]);
+
+		// Nothing has changed since the version was saved, so this won't save it again
+		GenerateStringFromStream();
+	}
+
+	void CalcIOStreamObj::AddOperation(OpCode op, char inChar)
+	{
+		bool regroup = false;
 		switch (prevActions.back())
 		{
-			// Overwrite the previous operation and symbol
 			case Action::Operation:
+			{
+				// A subtract after a binary operation is a unary minus (i.e. 2*-3), only allow one in a row
+				if (op == OpCode::Subtract)
+				{
+					if (operations.back() == OpCode::Negate) { return; }
+					op = OpCode::Negate;
+					break;
+				}
+				// Otherwise overwrite the previous operation and symbol (and the operation before a unary minus)
+				bool negate = operations.back() == OpCode::Negate;
 				operations.pop_back();
 				symbols.pop_back();
-				prevActions.pop_back();
+				PopAction();
+				if (negate && prevActions.back() == Action::Operation)
+				{
+					operations.pop_back();
+					symbols.pop_back();
+					PopAction();
+				}
+				// The parser can't overwrite tokens, rebuild it when we next need it
+				parserDirty = true;
+
+				// A unary minus straight after an opening bracket has nothing to replace it with
+				if (prevActions.back() == Action::Open) { GenerateStringFromStream(); return; }
+				break;
+			}
+			// Only a unary minus can come straight after an opening bracket
+			case Action::Open:
+				if (op != OpCode::Subtract) { return; }
+				op = OpCode::Negate;
+				break;
+			// Carrying on from an equals applies the operation to its result, the line puts what came before it in brackets
+			case Action::Equal:
+				regroup = true;
 				break;
 		}
 		// Add to our operations, symbols, and previous actions
-		operations.push_back(fnc);
+		operations.push_back(op);
 		symbols.push_back(inChar);
-		prevActions.push_back(Action::Operation);
+		PushAction(Action::Operation, std::string(1, inChar));
+		parser.PushOperation(op);
+		if (regroup) { GenerateActiveOpString(); }
 
 		// Generate a string to reflect this action
 		GenerateStringFromStream();
@@ -159,48 +232,64 @@
 			case Action::Start:
 			case Action::Number: 
 			{
-				// Override last value in the vector nums
-				if (nums.size() == 0)
+				// Start a new operand if we don't have one yet
+				if (operands.size() == 0)
 				{
-					std::vector<int> num;
-					nums.push_back(num);
+					operands.push_back(Operand());
+					parser.PushOperand(0);
 				}
+				Operand op = operands.back();
 
-				// If our only nums entry is 0 replace it with a new number (so we don't start a calculation stream with 01 after pressing 1
-				if (nums[nums.size() - 1].size() > 0 && nums[nums.size()-1][0] == 0)
+				// If our only digit is 0 replace it with a new number (so we don't start a calculation stream with 01 after pressing 1
+				if (op.digits > 0 && op.mantissa == 0)
 				{
-					nums[nums.size() - 1].pop_back();
-					nums[nums.size()-1].push_back(inF);
-
+					op.mantissa = (int)inF;
+					operands.replace_back(op);
+
+					// The zero is always the last character on the line, overwrite it in place (and in a copy of its action's end,
+					// earlier versions still have the zero)
+					ActionEnd end = actionEnds.back();
+					end.last = std::to_string((int)inF)[0];
+					actionEnds.replace_back(end);
+					activeOpString[end.end - 1] = end.last;
 				}
-				// Otherwise add a new entry and action
+				// Otherwise add a new digit and action, ignoring any digits that would no longer fit in our mantissa
 				else
 				{
-					nums[nums.size() - 1].push_back(inF);
-					prevActions.push_back(Action::Number);
+					if (op.digits >= MaxOperandDigits) { return; }
+					op.mantissa = op.mantissa * 10 + (int)inF;
+					op.digits++;
+					operands.replace_back(op);
+					PushAction(Action::Number, std::to_string((int)inF));
 				}
-
-				// Try to add a new decimal for this num to make sure everything is enumerated correctly
-				TryAddDecimalForNums();
 				break;
 			}
-			// Instantiate a new collection of integers in num as a new operation ends the previous series of nums
-			// then add a number + any decimals / actions etc...
+			// A new operation or opening bracket ends the previous operand so start a new one with this digit
 			case Action::Operation:
+			case Action::Open:
 			{
-				std::vector<int> num;
-				nums.push_back(num);
-				prevActions.push_back(Action::Number);
-				nums[nums.size()-1].push_back(inF);
-				TryAddDecimalForNums();
+				Operand op;
+				op.mantissa = (int)inF;
+				op.digits = 1;
+				operands.push_back(op);
+				parser.PushOperand((uint32_t)operands.size() - 1);
+				PushAction(Action::Number, std::to_string((int)inF));
 				break;
 			}
-			// Add a new decimal to the list associated with the current series of nums
+			// A closing bracket needs an operation before the next number
+			case Action::Close:
+				return;
+			// Add a new decimal digit to the current operand
 			// Addds associated actions etc..
 			case Action::Decimal:
 			{
-				decimals[nums.size()-1].push_back((int)inF);
-				prevActions.push_back(Action::Decimal);
+				Operand op = operands.back();
+				if (op.digits >= MaxOperandDigits) { return; }
+				op.mantissa = op.mantissa * 10 + (int)inF;
+				op.scale++;
+				op.digits++;
+				operands.replace_back(op);
+				PushAction(Action::Decimal, std::to_string((int)inF));
 				break;
 			}
 			// Start a new stream if we're adding a number to an equals, ending the previous calculation stream
@@ -216,16 +305,6 @@
 		GenerateStringFromStream();
 	}
 
-	void CalcIOStreamObj::TryAddDecimalForNums()
-	{
-		// Ensure we have a valid decimals vector for every nums vector that we can add to
-		if (decimals.size() < nums.size())
-		{
-			std::vector<int> dec;
-			decimals.push_back(dec);
-		}
-	}
-
 	void CalcIOStreamObj::SetDecimalMode()
 	{
 		switch (prevActions.back())
@@ -233,94 +312,512 @@
 			// return if invalid operation is pressed
 			case Action:: Decimal:
 			case Action::Equal:
+			case Action::Close:
 			{
 				return;
 			}
 			// If we can enter decimal mode and the previous action wasn't a number set the number for this decimal stream to 0
 			case Action::Start:
 			case Action::Operation:
+			case Action::Open:
 			{
 				AddNum(0.0f);
 				break;
 			}
 		}
 		// Add to previous actions
-		prevActions.push_back(Action::Decimal);
+		PushAction(Action::Decimal, ".");
 		
 		// Generate a string to reflect this action
 		GenerateStringFromStream();
 	}
 
-	std::string CalcIOStreamObj::CleanFloat(float inF)
+	void CalcIOStreamObj::OpenBracket()
 	{
-		std::string s = std::to_string(inF);
+		switch (prevActions.back())
+		{
+			// A bracket after a number would need an implied multiply, which we don't do
+			case Action::Number:
+			case Action::Decimal:
+			case Action::Close:
+			{
+				// ...except for the 0 a stream starts with, which the bracket replaces
+				if (!IsFreshStream()) { return; }
+				operands.pop_back();
+				PopAction();
+				parser.Reset();
+				break;
+			}
+			// Start a new stream if we're opening a bracket after an equals, ending the previous calculation stream
+			case Action::Equal:
+			{
+				ClearOperations();
+				OpenBracket();
+				return;
+			}
+		}
+		openBrackets++;
+		PushAction(Action::Open, "(");
+		parser.PushOpen();
+
+		// Generate a string to reflect this action
+		GenerateStringFromStream();
+	}
+
+	void CalcIOStreamObj::CloseBracket()
+	{
+		// Only close a bracket that's open and has something in it
+		if (openBrackets == 0) { return; }
+		switch (prevActions.back())
+		{
+			case Action::Number:
+			case Action::Decimal:
+			case Action::Close:
+				break;
+			default:
+				return;
+		}
+		openBrackets--;
+		PushAction(Action::Close, ")");
+		parser.PushClose();
+
+		// Generate a string to reflect this action
+		GenerateStringFromStream();
+	}
+
+	bool CalcIOStreamObj::IsFreshStream()
+	{
+		return prevActions.size() == 2 && prevActions.back() == Action::Number && operands.size() == 1 && operands.back().mantissa == 0;
+	}
+
+	void CalcIOStreamObj::ReparseStream()
+	{
+		parser.Reset();
+		prevActions.CopyTo(walkActions);
+		operations.CopyTo(walkOperations);
+		int iNum = 0; int iOp = 0;
+		Action last = Action::Start;
+		for (Action a : walkActions)
+		{
+			switch (a)
+			{
+				// Every digit of an operand is its own action, only the first one starts the operand
+				case Action::Number:
+					if (last != Action::Number && last != Action::Decimal) { parser.PushOperand(iNum++); }
+					break;
+				case Action::Operation:
+					parser.PushOperation(walkOperations[iOp++]);
+					break;
+				case Action::Open:
+					parser.PushOpen();
+					break;
+				case Action::Close:
+					parser.PushClose();
+					break;
+				case Action::Equal:
+					parser.Seal();
+					break;
+			}
+			last = a;
+		}
+		parserDirty = false;
+	}
+
+	void CalcIOStreamObj::ResetStreamStorage()
+	{
+		// Nothing can refer to the arena when it's rewound, so forget the stacks' nodes and swap each container for an empty one rather than clearing it
+		prevActions.clear();
+		actionEnds.clear();
+		operations.clear();
+		symbols.clear();
+		operands.clear();
+		previewStates.clear();
+		resultString = "";
+		ResetArenaContainer(activeOpString);
+		ResetArenaContainer(previewString);
+		ResetArenaContainer(versions);
+		version = 0;
+		arena.Reset();
+
+		// Set our default action
+		prevActions.push_back(Action::Start);
+		actionEnds.push_back(ActionEnd());
+		previewStates.push_back(PreviewState());
+	}
+
+	void CalcIOStreamObj::ArchiveStream()
+	{
+		history.BeginEntry(numericBackend);
+		prevActions.CopyTo(walkActions);
+		operations.CopyTo(walkOperations);
+		operands.CopyTo(walkOperands);
+		int iNum = 0; int iOp = 0;
+		bool inOperand = false; bool point = false;
+		for (Action a : walkActions)
+		{
+			// An operand ends at the first action that isn't one of its digits or its decimal point
+			if (inOperand && a != Action::Number && a != Action::Decimal)
+			{
+				history.AddOperand(walkOperands[iNum++], point);
+				inOperand = false;
+			}
+			switch (a)
+			{
+				case Action::Number:
+					if (!inOperand) { inOperand = true; point = false; }
+					break;
+				case Action::Decimal:
+					point = true;
+					break;
+				case Action::Operation:
+					history.AddOperation(walkOperations[iOp++]);
+					break;
+				case Action::Open:
+					history.AddOpen();
+					break;
+				case Action::Close:
+					history.AddClose();
+					break;
+				case Action::Equal:
+					history.AddEqual();
+					break;
+			}
+		}
+		if (inOperand) { history.AddOperand(walkOperands[iNum], point); }
+		history.CommitEntry();
+		search.Update(history, SearchCatchUp);
+	}
+
+	void CalcIOStreamObj::CleanFloat(float inF, ArenaString& s)
+	{
+		char buffer[64];
+		s.assign(buffer, FormatFloat(inF, buffer, sizeof(buffer)));
+	}
+
+	void CalcIOStreamObj::SetResult(const char* text, size_t length)
+	{
+		char* copy = static_cast<char*>(arena.Allocate(length + 1, 1));
+		memcpy(copy, text, length);
+		copy[length] = '\0';
+		resultString = copy;
+	}
+
+	size_t FormatFloat(float inF, char* s, size_t bufferSize)
+	{
+		// Same formatting as std::to_string
+		int n = snprintf(s, bufferSize, "%f", inF);
+		size_t length = n > 0 ? std::min((size_t)n, bufferSize - 1) : 0;
 		// Don't bother if our string only has 1 entry
-		if (s.size() == 0)
+		if (length == 0)
 		{
-			return s;
+			return length;
 		}
-		// Iterate backwards removing zeroes till we find a value that'a not zero
-		for (int i = s.length() - 1; i--; i > 0)
+		// Iterate backwards removing zeroes till we find a value that'a not zero, starting from the last character
+		for (size_t i = length; i-- > 0; )
 		{
-			if (s[i] == '0') { s.erase(i); }
+			if (s[i] == '0') { length = i; }
 			else { break; }
 		}
 		// Remove any decimal places from the float
-		if (s[s.length() - 1] == '.')
+		if (s[length - 1] == '.')
+		{
+			length--;
+		}
+		return length;
+	}
+
+	void CalcIOStreamObj::PushAction(Action a, const std::string& text)
+	{
+		// Drop anything appended after the last action (i.e. an equals result) before adding to the line
+		activeOpString.resize(actionEnds.back().end);
+		activeOpString.append(text);
+
+		previewStates.push_back(NextPreviewState(a));
+		prevActions.push_back(a);
+		ActionEnd end;
+		end.end = activeOpString.size();
+		end.last = activeOpString.empty() ? '\0' : activeOpString.back();
+		actionEnds.push_back(end);
+	}
+
+	void CalcIOStreamObj::PopAction()
+	{
+		prevActions.pop_back();
+		actionEnds.pop_back();
+		previewStates.pop_back();
+		activeOpString.resize(actionEnds.back().end);
+	}
+
+	bool CalcIOStreamObj::StreamVersion::operator==(const StreamVersion& other) const
+	{
+		// The value is compared bitwise so a NaN result still matches itself
+		return actions == other.actions && actionEnds == other.actionEnds && previewStates == other.previewStates && operations == other.operations &&
+			symbols == other.symbols && operands == other.operands && result == other.result && openBrackets == other.openBrackets &&
+			memcmp(&value, &other.value, sizeof(value)) == 0;
+	}
+
+	CalcIOStreamObj::StreamVersion CalcIOStreamObj::CurrentVersion() const
+	{
+		StreamVersion v;
+		v.actions = prevActions.Top();
+		v.actionEnds = actionEnds.Top();
+		v.previewStates = previewStates.Top();
+		v.operations = operations.Top();
+		v.symbols = symbols.Top();
+		v.operands = operands.Top();
+		v.result = resultString;
+		v.value = curVal;
+		v.openBrackets = openBrackets;
+		return v;
+	}
+
+	void CalcIOStreamObj::SaveVersion()
+	{
+		StreamVersion current = CurrentVersion();
+		if (!versions.empty())
+		{
+			if (versions[version] == current) { return; }
+			// A change after an undo starts a new line of versions, the ones we could have redone are gone
+			versions.erase(versions.begin() + version + 1, versions.end());
+		}
+		versions.push_back(current);
+		version = versions.size() - 1;
+	}
+
+	void CalcIOStreamObj::Restore(const StreamVersion& v)
+	{
+		const PersistentStack<ActionEnd>::Node* lineTop = actionEnds.Top();
+		prevActions.Restore(v.actions);
+		actionEnds.Restore(v.actionEnds);
+		previewStates.Restore(v.previewStates);
+		operations.Restore(v.operations);
+		symbols.Restore(v.symbols);
+		operands.Restore(v.operands);
+		resultString = v.result;
+		curVal = v.value;
+		openBrackets = v.openBrackets;
+		SyncLine(lineTop);
+
+		// The parser can only be added to, rebuild it when we next need it
+		parserDirty = true;
+	}
+
+	void CalcIOStreamObj::SyncLine(const PersistentStack<ActionEnd>::Node* previous)
+	{
+		// Everything up to the end of the last action both versions share is already on the line, the actions above it in the
+		// restored version each write their text back (walking the two down to where they meet, larger first). An action's text
+		// is its last character repeated, see ActionEnd
+		activeOpString.resize(actionEnds.back().end);
+		const PersistentStack<ActionEnd>::Node* node = actionEnds.Top();
+		while (node != previous)
+		{
+			if (previous == nullptr || (node != nullptr && node->size >= previous->size))
+			{
+				for (size_t i = node->below != nullptr ? node->below->value.end : 0; i < node->value.end; i++) { activeOpString[i] = node->value.last; }
+				node = node->below;
+			}
+			else { previous = previous->below; }
+		}
+	}
+
+	CalcIOStreamObj::PreviewState CalcIOStreamObj::NextPreviewState(Action a)
+	{
+		PreviewState state = previewStates.back();
+
+		// Whether the action ends the operand being typed (the last action was one of its digits or its decimal point)
+		Action last = prevActions.back();
+		bool endsOperand = (last == Action::Number || last == Action::Decimal) && a != Action::Number && a != Action::Decimal;
+		if (endsOperand)
 		{
-			s.erase(s.length() - 1);
+			const Operand& op = operands.back();
+			FoldPreview(state, op.Value());
 		}
-		return s;
+
+		switch (a)
+		{
+			case Action::Operation:
+			{
+				OpCode op = operations.back();
+				if (op == OpCode::Negate) { state.negate = !state.negate; }
+				// + and - end the current term, * and / carry it on
+				else if (op == OpCode::Add || op == OpCode::Subtract)
+				{
+					state.sum = ClosePreview(state);
+					state.sumOp = op;
+					state.term = 0.0f;
+					state.termOp = OpCode::Load;
+				}
+				else
+				{
+					state.termOp = op;
+				}
+				break;
+			}
+			// Start a new level, keeping this one in the arena for when it's closed
+			case Action::Open:
+			{
+				PreviewState inner;
+				inner.outer = arena.New<PreviewState>(state);
+				state = inner;
+				break;
+			}
+			// The bracket's value is an operand of the level around it
+			case Action::Close:
+			{
+				float value = ClosePreview(state);
+				state = *state.outer;
+				FoldPreview(state, value);
+				break;
+			}
+			// Anything after an equals applies to its result
+			case Action::Equal:
+			{
+				state = PreviewState();
+				FoldPreview(state, curVal);
+				break;
+			}
+		}
+		return state;
+	}
+
+	float CalcIOStreamObj::PreviewValue()
+	{
+		PreviewState state = previewStates.back();
+		if (prevActions.back() == Action::Number || prevActions.back() == Action::Decimal) { FoldPreview(state, operands.back().Value()); }
+
+		// Close any open brackets, only folding in the ones that have something in them
+		float value = ClosePreview(state);
+		bool filled = state.filled;
+		for (const PreviewState* outer = state.outer; outer != nullptr; outer = outer->outer)
+		{
+			PreviewState level = *outer;
+			if (filled) { FoldPreview(level, value); }
+			value = ClosePreview(level);
+			filled = level.filled;
+		}
+		return value;
+	}
+
+	void CalcIOStreamObj::FoldPreview(PreviewState& state, float value)
+	{
+		if (state.negate) { value = -value; }
+		ApplyOp(state.termOp, value, state.term);
+		state.negate = false;
+		state.filled = true;
+	}
+
+	float CalcIOStreamObj::ClosePreview(const PreviewState& state)
+	{
+		float sum = state.sum;
+		ApplyOp(state.sumOp, state.term, sum);
+		return sum;
 	}
 
 	void CalcIOStreamObj::GenerateStringFromStream()
 	{
-		activeOpString.clear();
-		activeOpString = GenerateActiveOpString();
+		// Only rebuild the whole line if our action offsets no longer line up with our actions
+		if (actionEnds.size() != prevActions.size())
+		{
+			GenerateActiveOpString();
+		}
+		// Otherwise trim back to the end of the last action, dropping any previously appended result
+		else
+		{
+			activeOpString.resize(actionEnds.back().end);
+		}
 
 		switch (prevActions.back())
 		{
 			// Append the value of our calculation to the active op string, appropriately formatted
 			case Action::Equal:
 				activeOpString.append("\n=\n");
-				activeOpString.append(CleanFloat(curVal));
+				activeOpString.append(resultString);
 				break;
 		}
 
+		// Preview the value once there's something to calculate (an equals already shows it). Like an operation at the end that
+		// has nothing to apply to yet, a bracket with no operand in it yet (i.e. "(-") would only show the 0 it starts from
+		previewString.clear();
+		bool typingOperand = prevActions.back() == Action::Number || prevActions.back() == Action::Decimal;
+		if (prevActions.back() != Action::Equal && operations.size() > 0 && (previewStates.back().filled || typingOperand))
+		{
+			char buffer[64];
+			previewString.append("= ");
+			previewString.append(buffer, FormatFloat(PreviewValue(), buffer, sizeof(buffer)));
+		}
+
+		// Every change to the stream ends up here once it's done, so this is where each version is saved
+		SaveVersion();
+
 		//Callack for the UI formatted using GetOutRef to something the UI can read (current operation string and previous operation string)
 		onValUpdated(GetOutRef());
 	}
 
-	std::string CalcIOStreamObj::GenerateActiveOpString()
+	void CalcIOStreamObj::GenerateActiveOpString()
 	{
-		std::string s = "";
+		// Written straight over the line, which keeps its memory
+		ArenaString& s = activeOpString;
+		s.clear();
 		//Keep track of where we are in each of our collections as we iterate over the IO stream 
 		int iNum = 0; int iOp = 0; int iDec = 0;
+		prevActions.CopyTo(walkActions);
+		symbols.CopyTo(walkSymbols);
+		operands.CopyTo(walkOperands);
+
+		// An equals that's carried on from applies what comes next to everything before it, so that's bracketed (2+3= then *4
+		// shows (2+3)*4). Brackets left open are closed there, and a single operand or bracket needs no bracket of its own.
+		// The opening brackets all go at the very start, count them first
+		int depth = 0; bool spread = false; int groups = 0;
+		for (int ai = 0; ai < walkActions.size(); ai++)
+		{
+			switch (walkActions[ai])
+			{
+				case Action::Operation: spread |= depth == 0; break;
+				case Action::Open: depth++; break;
+				case Action::Close: depth--; break;
+				case Action::Equal:
+					if (ai + 1 < walkActions.size()) { groups += spread; }
+					depth = 0;
+					spread = false;
+					break;
+			}
+		}
+		s.append(groups, '(');
+		depth = 0;
+		spread = false;
+
+		// Rebuild the end offsets of each action as we go
+		actionEnds.clear();
+		ActionEnd end;
 
 		// Keep track of our last locally reviewed  action and set the default
 		Action locLstAction = Action::Start;
 		Action a = locLstAction;
 
 		//Manually iterate here as we want to skip forward an indeces in some cases
-		for (int ai = 0; ai < prevActions.size(); ai++)
+		for (int ai = 0; ai < walkActions.size(); ai++)
 		{
-			switch (a = prevActions[ai])
+			switch (a = walkActions[ai])
 			{
-				// Iterate over all nums in the current nums vector and add them to the string
+				// Iterate over all digits in the current operand and add them to the string
 				case Action::Number:
 				{
-					if (iNum < nums.size())
+					if (iNum < walkOperands.size())
 					{
-						for (int i = 0; i < nums[iNum].size(); i++)
+						// Each whole number digit of the operand is its own action
+						const Operand& op = walkOperands[iNum];
+						char whole[24];
+						int digits = snprintf(whole, sizeof(whole), "%lld", (long long)(op.mantissa / PowersOfTen[op.scale]));
+						for (int i = 0; i < digits; i++)
 						{
-							s.append(CleanFloat(nums[iNum][i]));
-							// Manually iterate here as we are going through a nested collection
+							s.push_back(whole[i]);
+							// Manually iterate here as we are going through the digits of a single operand
 							// and we need to equate this to a 1 dimensional collection of previous actions
-							if (i < nums[iNum].size()-1) { ai++; }
+							if (i < digits-1) { ai++; end.end = s.size(); end.last = s.back(); actionEnds.push_back(end); }
 						}
 						// Increment our current num index
 						iNum++;
-						// Reset our current decimal index as we will be dealing with a new set of nums
+						// Reset our current decimal index as we will be dealing with a new operand
 						iDec = 0;
 						//Set last local action
 						locLstAction = Action::Number;
@@ -330,8 +827,8 @@
 				case Action::Operation:
 				{
 					// Add the last symbol to the string 
-					std::string c(1, symbols[iOp]);
-					s.append(c);
+					s.push_back(walkSymbols[iOp]);
+					spread |= depth == 0;
 					//increment our operations index
 					iOp++;
 					//Set last local action
@@ -340,10 +837,12 @@
 				}
 				case Action::Decimal:
 				{
-					// If we're still iterating over the same vector of decimals continue appending
+					// If we're still iterating over the same operand's decimals continue appending
 					if (locLstAction == Action::Decimal) 
 					{ 
-						s.append(std::to_string(decimals[iNum-1][iDec]));
+						// Pick out the decimal digit at this position from the operand's mantissa
+						const Operand& op = walkOperands[iNum-1];
+						s.push_back((char)('0' + (op.mantissa / PowersOfTen[op.scale - 1 - iDec]) % 10));
 					}
 					// If not assume it's a new stream of decimals and add a decimal place instead
 					else { s.append("."); locLstAction = Action::Decimal; break;}
@@ -353,21 +852,38 @@
 					locLstAction = Action::Decimal;
 					break;
 				}
-				// We don't need to do anything here other than account for the fact that an equals is part of the previous actions.
-				// We handle formatting for equals if it's our last action in GenerateStringFromStream, once this method has been called
+				case Action::Open:
+					s.append("(");
+					depth++;
+					locLstAction = Action::Open;
+					break;
+				case Action::Close:
+					s.append(")");
+					depth--;
+					locLstAction = Action::Close;
+					break;
+				// An equals that's carried on from closes the brackets in front of it. The result of the last one is appended in
+				// GenerateStringFromStream, once this method has been called
 				case Action::Equal:
+					if (ai + 1 < walkActions.size())
+					{
+						s.append(depth + (spread ? 1 : 0), ')');
+						depth = 0;
+						spread = false;
+					}
 					//Set last local action
 					locLstAction = Action::Equal;
 					break;
 			}
+			end.end = s.size();
+			end.last = s.empty() ? '\0' : s.back();
+			actionEnds.push_back(end);
 		}
-		return s;
 	}
 
-	std::tuple<const char*, std::vector<std::string>> CalcIOStreamObj::GetOutRef()
+	std::tuple<const char*, const char*, const CalcHistory&> CalcIOStreamObj::GetOutRef()
 	{
-		//Convert 2 std::strings into chars and return them as a tuple for the UI 
+		//Return the active line and preview as chars and the previous streams by reference as a tuple for the UI (nothing is copied or formatted)
 		const char* c1 = activeOpString.c_str();
-		std::vector<std::string> c2 = prevOpString;
-		return std::tuple{ c1, c2 };
+		return { c1, previewString.c_str(), history };
 	}
@@ -3,11 +3,20 @@ class CalcIOStreamObj {
 	/// <summary>
 	/// Creates and manages a stream of input calculations as well as values and returns them, 
 	/// formatted appropriately via a callback for use with UI elements
+	/// Everything belonging to the current stream is allocated from an arena that ClearOperations rewinds,
+	/// so once the arena has grown to fit the longest stream seen, input doesn't allocate at all.
+	/// The value of the stream is kept up to date as it's typed (see PreviewState), which gives the live preview and
+	/// means Equals doesn't have to go back over the stream.
+	/// The stream's stacks are persistent (see PersistentStack), so every version of the stream stays intact in the arena
+	/// and undo or redo just puts back the tops of a saved version
 	/// </summary>
 
 public:
-	//Callback whenever the value of the calculation stream changes 
-	std::function<void(std::tuple<const char*, std::vector<std::string>>)> onValUpdated;
+	CalcIOStreamObj();
+
+	//Callback whenever the value of the calculation stream changes, with the active line, a preview of its value
+	//("= 5", empty when there's nothing to preview) and the previous streams
+	std::function<void(std::tuple<const char*, const char*, const CalcHistory&>)> onValUpdated;
 
 	// CALCULATOR STREAM MANAGEMENT METHODS --------------------------------------------------------------------------------------------
 	// Clear entire calculation stream
@@ -19,9 +28,26 @@ public:
 	// Get current calculation stream sum
 	void Equals();
 
+	// UNDO / REDO --------------------------------------------------------------------------------------------
+	// Every change to the current stream is saved as a version. Undo and Redo step between versions and RestoreVersion jumps
+	// straight to any of them, each in O(1) without going back over the stream. Changing the stream after an undo drops the versions
+	// that could have been redone, and the stream's versions go with it once it's cleared (it's in the history by then)
+	void Undo();
+	void Redo();
+	void RestoreVersion(size_t);
+
+	// How many versions the current stream has, and which of them it's showing
+	size_t GetVersionCount() const { return versions.size(); }
+	size_t GetVersion() const { return version; }
+
 	// MATHEMATICAL OPERATION METHODS --------------------------------------------------------------------------------------------
 	// Add an add operation and a corresponding symbol to the current calculation stream 
-	void AddOperation(std::function<void(float, float&)>, char);
+	// A subtract where an operand is expected (after another operation or an opening bracket) is added as a unary minus
+	void AddOperation(OpCode, char);
+
+	// Open or close a bracket in the current calculation stream, brackets still open at an equals are closed automatically
+	void OpenBracket();
+	void CloseBracket();
 
 	// NUMERICAL METHODS --------------------------------------------------------------------------------------------
 	// Add a number to the current calculation stream 
@@ -30,56 +56,194 @@ public:
 	// Tries to set our IO stream into decimal mode (AddNum is used to push new decimal values into the stream)
 	void SetDecimalMode();
 
+	// Choose whether Equals calculates with floats or exact CalcDecimal values (applies from the next Equals)
+	void SetNumericBackend(NumericBackend backend) { numericBackend = backend; }
+	NumericBackend GetNumericBackend() const { return numericBackend; }
+
+	// How many blocks the per-stream arena has taken from the heap, stops growing once it fits the longest stream
+	size_t GetArenaBlockCount() const { return arena.BlockCount(); }
+
+	// Every previous calculation stream, oldest first
+	CalcHistory& GetHistory() { return history; }
+
+	// Index for searching the history, kept up to date as streams are archived (call Update to catch up on a history loaded from a log)
+	CalcHistorySearch& GetSearch() { return search; }
+
 private:
 
 	//Possible calculation stream operations
-	const enum Action { Start, Number, Operation, Decimal, Equal};
+	enum Action { Start, Number, Operation, Decimal, Equal, Open, Close};
+
+	// Storage for the current stream, rewound by ClearOperations (declared first so it outlives the containers using it)
+	CalcArena arena;
 
-	//The previous actions from the calculation stream, formatted line by line as entries in a vector
-	std::vector<Action> prevActions = {Action::Start};
+	//The previous actions from the calculation stream, formatted line by line as entries in a stack
+	PersistentStack<Action> prevActions;
 
 	// The current numerical value of the calculation
-	float curVal;
+	float curVal = 0.0f;
 
-	// String for all previous operations.
-	std::vector<std::string> prevOpString;
+	// The number type Equals calculates with
+	NumericBackend numericBackend = NumericBackend::Float;
+
+	// The result of the last Equals formatted for display, from whichever backend calculated it
+	// Each result is copied into the arena, so a version ending in an equals can keep pointing at its own
+	const char* resultString = "";
+
+	// All previous calculation streams, stored compactly and only formatted when displayed
+	CalcHistory history;
+
+	// Search index over history, archiving a stream indexes up to this many entries so it keeps up without stalling on a big log
+	CalcHistorySearch search;
+	static const size_t SearchCatchUp = 64;
 
 	// String for the active operation line
-	std::string activeOpString;
+	ArenaString activeOpString;
+
+	// End offset in activeOpString of the text written by each entry in prevActions (always the same length as prevActions)
+	// Lets us append or remove a single action's text without rebuilding the whole line.
+	// An action writes one character, or none, or a run of the same bracket when an equals is continued (2+3= then *4 shows
+	// (2+3)*4, the start action writing the opening one and the equals the closing one). Keeping the last character on the
+	// line with its end is enough to write the line back out when restoring a version (see SyncLine)
+	struct ActionEnd
+	{
+		size_t end = 0;
+		char last = '\0';
+	};
+	PersistentStack<ActionEnd> actionEnds;
 
 	// String for the full calculator output Generated each time an operation is called or a number is added
 	//std::string streamOutString;
 
 	// A dynamically sized list of all the previous operations that make up this calulation stream
-	std::vector<std::function<void(float, float&)>> operations;
+	PersistentStack<OpCode> operations;
+
+	// The value of the stream up to an action, folded in as each action is added like CalcFold does with characters.
+	// Opening a bracket saves the enclosing level in the arena and points to it, so each state is a fixed size and
+	// popping an action just drops its state
+	struct PreviewState
+	{
+		// The sum of every complete term in this bracket level and the + or - that will add the current term to it
+		float sum = 0.0f;
+		OpCode sumOp = OpCode::Load;
+
+		// The product of the current term so far and the * or / that will apply the next operand to it
+		float term = 0.0f;
+		OpCode termOp = OpCode::Load;
+
+		// Whether the next operand is negated, and whether anything has been folded into this level yet
+		bool negate = false;
+		bool filled = false;
+
+		// The bracket level around this one
+		const PreviewState* outer = nullptr;
+	};
+
+	// The state after each entry in prevActions (always the same length as prevActions)
+	PersistentStack<PreviewState> previewStates;
+
+	// The preview of the current value shown under the active line
+	ArenaString previewString;
+
+	// Parses the stream as it's added to, so Equals only has to finish off the tree for the last few tokens
+	CalcParser parser;
+
+	// Set when something is removed from the stream, the parser can only be added to so it's rebuilt at the next Equals
+	bool parserDirty = false;
+
+	// How many brackets are open in the stream
+	int openBrackets = 0;
 
 	// A dynamically sized list of all the previous symbols that make up this calulation stream (symbols are the ascii representation of operations)
-	std::vector<char> symbols;
+	PersistentStack<char> symbols;
+
+	// A dynamically sized list of all the previous numbers that make up this calulation stream
+	PersistentStack<Operand> operands;
+
+	// Copies of the stacks, bottom first, for the few things that go over the whole stream in order
+	// (kept between uses so they stop allocating once they fit the longest stream)
+	std::vector<Action> walkActions;
+	std::vector<OpCode> walkOperations;
+	std::vector<char> walkSymbols;
+	std::vector<Operand> walkOperands;
+
+	// Everything a version of the stream is made of. The stacks share every node they have in common with other versions,
+	// so saving a version only costs this and the nodes its change pushed
+	struct StreamVersion
+	{
+		const PersistentStack<Action>::Node* actions = nullptr;
+		const PersistentStack<ActionEnd>::Node* actionEnds = nullptr;
+		const PersistentStack<PreviewState>::Node* previewStates = nullptr;
+		const PersistentStack<OpCode>::Node* operations = nullptr;
+		const PersistentStack<char>::Node* symbols = nullptr;
+		const PersistentStack<Operand>::Node* operands = nullptr;
+		const char* result = "";
+		float value = 0.0f;
+		int openBrackets = 0;
+
+		bool operator==(const StreamVersion&) const;
+	};
+
+	// Every version of the current stream, oldest first, and the one it's showing
+	ArenaVector<StreamVersion> versions;
+	size_t version = 0;
+
+	// Clean up a float and write it to out without lot's of zeros at the end
+	void CleanFloat(float, ArenaString& out);
 
-	// A dynamically sized list of all the previous numbers that make up this calulation stream. All nums have a corresponding entry in the vector; decimals
-	std::vector<std::vector<int>> nums;
+	// Copy a formatted result into the arena and make it the current one
+	void SetResult(const char*, size_t);
 
-	// A dynamically sized list of all the previous numbers after the floating point that make up this calulation stream
-	std::vector<std::vector<int>> decimals;
+	// The current version of the stream, and saving it (if it's changed) once a change to the stream is done
+	StreamVersion CurrentVersion() const;
+	void SaveVersion();
 
-	//Try to add a new decimal vector (if we have less decimal vectors than num vectors, to prevent enumeration errors)
-	void TryAddDecimalForNums();
+	// Put back the stacks and values of a saved version
+	void Restore(const StreamVersion&);
 
-	// Clean up a float and return it as a string without lot's of zeros at the end
-	std::string CleanFloat(float);
+	// Bring activeOpString into line with actionEnds after it's been restored to another version, given the top it was at.
+	// Only the text past the last action the two versions share is written, so a step of undo or redo writes a character or two
+	void SyncLine(const PersistentStack<ActionEnd>::Node*);
 
-	//Construct a string to represent our active operations. 
+	// Push an action onto prevActions and append the text it represents to the end of the active operation line
+	// Operations have to be added to operations before their action so its state can include them
+	void PushAction(Action, const std::string&);
+
+	// Work out the state after an action from the state before it
+	PreviewState NextPreviewState(Action);
+
+	// The value of the stream so far, closing any open brackets and ignoring a trailing operation or empty bracket
+	float PreviewValue();
+
+	// Fold an operand into a state's current term, and get the value of a bracket level
+	static void FoldPreview(PreviewState&, float);
+	static float ClosePreview(const PreviewState&);
+
+	// Empty every per-stream container and rewind the arena they live in, then set up the start of a new stream
+	void ResetStreamStorage();
+
+	// Add the tokens of the current stream to the history as a new entry
+	void ArchiveStream();
+
+	// Pop the last action from prevActions and remove the text it represents from the active operation line
+	void PopAction();
+
+	//Construct activeOpString to represent our active operations from scratch, rebuilding actionEnds as we go.
+	//Used when actionEnds is out of sync with prevActions, and when an equals is continued as that brackets everything before it
 	//All formatting rules for the IO Stream are specified here or in GenerateStringFromStream
-	std::string GenerateActiveOpString();
+	void GenerateActiveOpString();
 
 	// Generate a string to display on the calculator UI based on the active operations, and all previous operations 
 	//All formatting rules for the IO Stream are specified here or in GenerateActiveOpString
 	void GenerateStringFromStream();
 
 	//Returns a reference to the output strings; this calculation stream, and all previous calculation streams, for use by the UI
-	std::tuple<const char*,std::vector<std::string>> GetOutRef();
+	std::tuple<const char*, const char*, const CalcHistory&> GetOutRef();
+
+	// Rebuild the parser from scratch from our previous actions, operations and operands
+	void ReparseStream();
 
-	//Return the sum of the input float with associated decimals
-	float GetCurrentFloatWithDecimals(int);
+	// Whether the stream is just the 0 we start each stream with, which the next input replaces
+	bool IsFreshStream();
 };
 
@@ -0,0 +1,193 @@
+#pragma once
+#include "Common.h"
+
+uint64_t CalcMemo::HashEntry(uint64_t hash, const TapeEntry& entry)
+{
+	uint32_t bits;
+	memcpy(&bits, &entry.operand, sizeof(bits));
+	hash = (hash ^ (uint64_t)entry.op) * 1099511628211ull;
+	return (hash ^ bits) * 1099511628211ull;
+}
+
+// Whether two runs of entries are the same, comparing operands by their bits like the hash does
+static bool SameEntries(const TapeEntry* a, const TapeEntry* b, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		uint32_t aBits, bBits;
+		memcpy(&aBits, &a[i].operand, sizeof(aBits));
+		memcpy(&bBits, &b[i].operand, sizeof(bBits));
+		if (a[i].op != b[i].op || aBits != bBits) { return false; }
+	}
+	return true;
+}
+
+float CalcMemo::Evaluate(const CalcTape& tape)
+{
+	const TapeEntry* entries = tape.Data();
+	size_t size = tape.Size();
+	lastNode = None;
+	if (nodes.empty()) { return lastValue = EvaluateTape(entries, size); }
+
+	// Hash every prefix that leaves the stack empty, the last one is the whole tape
+	boundaries.clear();
+	uint64_t hash = HashSeed;
+	int depth = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = HashEntry(hash, entries[i]);
+		if (entries[i].op == OpCode::Push) { depth++; }
+		else if (entries[i].op >= OpCode::PopAdd) { depth--; }
+		if (depth == 0) { boundaries.push_back({ i + 1, hash }); }
+	}
+	if (boundaries.empty() || boundaries.back().end != size) { return lastValue = EvaluateTape(entries, size); }
+
+	uint32_t node = Find(boundaries.back().hash, entries, size);
+	if (node != None)
+	{
+		hits++;
+		Touch(node);
+		lastNode = node;
+		return lastValue = nodes[node].value;
+	}
+	misses++;
+
+	// Resume from the longest prefix we have, and cache only the whole tape: a stream's next result extends this one, so it
+	// resumes from here, and the prefixes in between are rarely asked for on their own
+	size_t start = 0;
+	float value = 0.0f;
+	size_t b = boundaries.size() - 1;
+	while (b-- > 0)
+	{
+		node = Find(boundaries[b].hash, entries, boundaries[b].end);
+		if (node != None)
+		{
+			prefixHits++;
+			Touch(node);
+			start = boundaries[b].end;
+			value = nodes[node].value;
+			break;
+		}
+	}
+	value = EvaluateTape(entries + start, size - start, value);
+	lastNode = Insert(boundaries.back().hash, entries, size, value);
+	return lastValue = value;
+}
+
+size_t CalcMemo::FormatResult(char* buffer, size_t bufferSize)
+{
+	if (lastNode == None) { return FormatFloat(lastValue, buffer, bufferSize); }
+
+	Node& node = nodes[lastNode];
+	if (node.textLength == 0)
+	{
+		char text[64];
+		size_t length = FormatFloat(node.value, text, sizeof(text));
+		if (length == 0 || length > ResultTextSize) { return FormatFloat(lastValue, buffer, bufferSize); }
+		memcpy(node.text, text, length);
+		node.textLength = (uint8_t)length;
+	}
+	size_t length = std::min((size_t)node.textLength, bufferSize - 1);
+	memcpy(buffer, node.text, length);
+	buffer[length] = '\0';
+	return length;
+}
+
+void CalcMemo::SetCapacity(size_t capacity)
+{
+	nodes.assign(std::min(capacity, (size_t)None - 1), Node());
+	size_t slotCount = 1;
+	while (slotCount < nodes.size() * 2) { slotCount *= 2; }
+	slots.assign(nodes.empty() ? 0 : slotCount, None);
+	count = 0;
+	lastNode = None;
+	newest = oldest = None;
+}
+
+void CalcMemo::Clear()
+{
+	std::fill(slots.begin(), slots.end(), None);
+	count = 0;
+	lastNode = None;
+	newest = oldest = None;
+}
+
+uint32_t CalcMemo::Find(uint64_t hash, const TapeEntry* entries, size_t length) const
+{
+	size_t mask = slots.size() - 1;
+	for (size_t slot = HomeSlot(hash); slots[slot] != None; slot = (slot + 1) & mask)
+	{
+		const Node& node = nodes[slots[slot]];
+		if (node.hash == hash && node.key.size() == length && SameEntries(node.key.data(), entries, length)) { return slots[slot]; }
+	}
+	return None;
+}
+
+uint32_t CalcMemo::Insert(uint64_t hash, const TapeEntry* entries, size_t length, float value)
+{
+	// Take a free node, or the least recently used one once they're all in use
+	uint32_t node;
+	if (count < nodes.size())
+	{
+		node = (uint32_t)count++;
+	}
+	else
+	{
+		node = oldest;
+		size_t mask = slots.size() - 1;
+		size_t slot = HomeSlot(nodes[node].hash);
+		while (slots[slot] != node) { slot = (slot + 1) & mask; }
+		RemoveSlot(slot);
+		Unlink(node);
+	}
+
+	nodes[node].hash = hash;
+	nodes[node].key.assign(entries, entries + length);
+	nodes[node].value = value;
+	nodes[node].textLength = 0;
+	size_t mask = slots.size() - 1;
+	size_t slot = HomeSlot(hash);
+	while (slots[slot] != None) { slot = (slot + 1) & mask; }
+	slots[slot] = node;
+
+	nodes[node].older = newest;
+	nodes[node].newer = None;
+	if (newest != None) { nodes[newest].newer = node; }
+	newest = node;
+	if (oldest == None) { oldest = node; }
+	return node;
+}
+
+void CalcMemo::Touch(uint32_t node)
+{
+	if (node == newest) { return; }
+	Unlink(node);
+	nodes[node].older = newest;
+	nodes[node].newer = None;
+	nodes[newest].newer = node;
+	newest = node;
+}
+
+void CalcMemo::Unlink(uint32_t node)
+{
+	Node& n = nodes[node];
+	if (n.newer != None) { nodes[n.newer].older = n.older; } else { newest = n.older; }
+	if (n.older != None) { nodes[n.older].newer = n.newer; } else { oldest = n.newer; }
+}
+
+void CalcMemo::RemoveSlot(size_t slot)
+{
+	// Backward shift deletion: move entries after the gap back into it unless that would put them before their home slot
+	size_t mask = slots.size() - 1;
+	size_t gap = slot;
+	for (size_t next = (gap + 1) & mask; slots[next] != None; next = (next + 1) & mask)
+	{
+		size_t home = HomeSlot(nodes[slots[next]].hash);
+		if (((next - home) & mask) >= ((next - gap) & mask))
+		{
+			slots[gap] = slots[next];
+			gap = next;
+		}
+	}
+	slots[gap] = None;
+}
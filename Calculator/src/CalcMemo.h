@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// LRU cache of tape results keyed by a hash of the tape's opcodes and operands (a compiled tape is already canonical, the same
+/// expression always compiles to the same tape). Besides the whole tape, the value at every point where the tape's stack is empty
+/// is cached, so a tape that extends one evaluated before (i.e. another "*1.05" on the end of a chain) only evaluates its tail.
+/// Results are also kept formatted for display once they've been asked for, which is most of the cost of showing one.
+/// CalcHistory keeps one for the results of the entries it formats, which the UI asks for again every frame they're in view.
+/// Every entry keeps a copy of the tape it's for and a lookup only hits if the whole tape matches, the hash just finds the entry.
+/// Entries live in a fixed pool with an open addressing table over it, so once the pool is full and each entry's copy has
+/// grown to fit the tapes it holds nothing allocates
+/// </summary>
+
+class CalcMemo {
+
+public:
+	static const size_t DefaultCapacity = 4096;
+
+	explicit CalcMemo(size_t capacity = DefaultCapacity) { SetCapacity(capacity); }
+
+	// Evaluate a tape, using and updating the cache
+	float Evaluate(const CalcTape&);
+
+	// The hash entries are found by, folded in an entry at a time starting from HashSeed (FNV-1a over the opcode then the operand's bits)
+	static constexpr uint64_t HashSeed = 14695981039346656037ull;
+	static uint64_t HashEntry(uint64_t hash, const TapeEntry&);
+
+	// Write the result of the last Evaluate to buffer formatted like FormatFloat, returns the length written
+	size_t FormatResult(char* buffer, size_t bufferSize);
+
+	// Change how many values are kept (0 turns the cache off), this empties the cache
+	void SetCapacity(size_t);
+	size_t GetCapacity() const { return nodes.size(); }
+	size_t Size() const { return count; }
+
+	// Whole tapes found in the cache, tapes that weren't, and how many of those misses resumed from a cached prefix
+	size_t Hits() const { return hits; }
+	size_t Misses() const { return misses; }
+	size_t PrefixHits() const { return prefixHits; }
+	void ResetCounters() { hits = misses = prefixHits = 0; }
+
+	void Clear();
+
+private:
+	static constexpr uint32_t None = UINT32_MAX;
+
+	// Longest formatted result kept in a node (any float formats shorter than this)
+	static const size_t ResultTextSize = 48;
+
+	struct Node
+	{
+		uint64_t hash;
+		// The tape (up to the boundary) the value is for
+		std::vector<TapeEntry> key;
+		float value;
+		// The value formatted for display, textLength is 0 until it's been asked for
+		uint8_t textLength;
+		char text[ResultTextSize];
+		// Neighbours in recency order
+		uint32_t newer;
+		uint32_t older;
+	};
+
+	// The node holding the value of the first length entries, whose hash is hash, or None
+	uint32_t Find(uint64_t hash, const TapeEntry* entries, size_t length) const;
+
+	// Add the value of entries that aren't cached yet, evicting the least recently used if we're full. Returns its node
+	uint32_t Insert(uint64_t hash, const TapeEntry* entries, size_t length, float value);
+
+	// Move a node to the front of the recency list
+	void Touch(uint32_t node);
+	void Unlink(uint32_t node);
+
+	// The slot a hash probes from. The low bits of an FNV hash only depend on the low bits of what went into it, and most
+	// operands people type have none set, so the high half is folded in
+	size_t HomeSlot(uint64_t hash) const { return (size_t)(hash ^ (hash >> 32)) & (slots.size() - 1); }
+
+	// Remove the table slot of a node, shifting later entries of its probe run back into the gap
+	void RemoveSlot(size_t slot);
+
+	std::vector<Node> nodes;
+	// Open addressing table of node indices, twice the capacity rounded up to a power of 2
+	std::vector<uint32_t> slots;
+	size_t count = 0;
+	uint32_t newest = None;
+	uint32_t oldest = None;
+
+	// The node of the last result evaluated (None if it wasn't cached) and its value
+	uint32_t lastNode = None;
+	float lastValue = 0.0f;
+
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t prefixHits = 0;
+
+	// The hash of the tape up to each point its stack is empty, reused between calls
+	struct Boundary
+	{
+		size_t end;
+		uint64_t hash;
+	};
+	std::vector<Boundary> boundaries;
+};
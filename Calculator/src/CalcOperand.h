@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+/// <summary>
+/// A single number in a calculation, updated in place as each digit is entered rather than stored digit by digit
+/// </summary>
+
+// The most digits an operand can hold before the mantissa would overflow, any further digits are ignored
+constexpr uint8_t MaxOperandDigits = 18;
+
+// Powers of ten for each possible operand scale, used to place the decimal point in the mantissa
+constexpr int64_t PowersOfTen[MaxOperandDigits + 1] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+	10000000000, 100000000000, 1000000000000, 10000000000000, 100000000000000,
+	1000000000000000, 10000000000000000, 100000000000000000, 1000000000000000000 };
+
+struct Operand
+{
+	// Every digit entered (whole and decimal) as a single integer i.e. 12.34 is stored as 1234
+	int64_t mantissa = 0;
+	// How many of the digits in the mantissa come after the decimal point
+	uint8_t scale = 0;
+	// How many digits have been entered in total
+	uint8_t digits = 0;
+
+	// The operand as a float, we only need to shift the mantissa down by the number of decimal places
+	float Value() const { return (float)((double)mantissa / PowersOfTen[scale]); }
+};
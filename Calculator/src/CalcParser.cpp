@@ -0,0 +1,196 @@
+#pragma once
+#include "Common.h"
+
+void CalcParser::Reset()
+{
+	arena.Reset();
+	nodes.clear();
+	ops.clear();
+	finished = false;
+	invalid = false;
+	openBrackets = 0;
+}
+
+void CalcParser::PushOperand(uint32_t operand)
+{
+	DiscardFinish();
+
+	CalcNode* node = arena.New<CalcNode>();
+	node->type = CalcNode::Type::Operand;
+	node->operand = operand;
+	nodes.push_back(node);
+}
+
+void CalcParser::PushOperation(OpCode op)
+{
+	DiscardFinish();
+
+	// Negate is a prefix so it has nothing to its left to reduce
+	if (op != OpCode::Negate)
+	{
+		// Reduce anything that binds at least as tightly first, giving left to right order for equal precedence
+		while (!ops.empty() && !ops.back().open && Precedence(ops.back().op) >= Precedence(op))
+		{
+			if (!Reduce(nodes, ops)) { invalid = true; break; }
+		}
+	}
+	ops.push_back({ op, false });
+}
+
+void CalcParser::PushOpen()
+{
+	DiscardFinish();
+	ops.push_back({ OpCode::Load, true });
+	openBrackets++;
+}
+
+bool CalcParser::PushClose()
+{
+	if (openBrackets == 0) { return false; }
+	DiscardFinish();
+
+	while (!ops.empty() && !ops.back().open)
+	{
+		if (!Reduce(nodes, ops)) { invalid = true; break; }
+	}
+	if (!ops.empty()) { ops.pop_back(); }
+	openBrackets--;
+	return true;
+}
+
+const CalcNode* CalcParser::Finish()
+{
+	if (invalid) { return nullptr; }
+	DiscardFinish();
+
+	// Reduce copies of the stacks so later pushes carry on from where they were
+	finishNodes.assign(nodes.begin(), nodes.end());
+	finishOps.assign(ops.begin(), ops.end());
+	finishMark = arena.GetMark();
+	finished = true;
+
+	while (!finishOps.empty())
+	{
+		// Brackets that are still open just close here
+		if (finishOps.back().open) { finishOps.pop_back(); continue; }
+		if (!Reduce(finishNodes, finishOps)) { return nullptr; }
+	}
+	return finishNodes.size() == 1 ? finishNodes[0] : nullptr;
+}
+
+void CalcParser::Seal()
+{
+	const CalcNode* root = Finish();
+
+	// Keep the nodes Finish created, they're now part of the pushed stream
+	finished = false;
+	ops.clear();
+	nodes.clear();
+	openBrackets = 0;
+	if (root != nullptr) { nodes.push_back(root); }
+	else { invalid = true; }
+}
+
+int CalcParser::Precedence(OpCode op)
+{
+	switch (op)
+	{
+		case OpCode::Negate:	return 3;
+		case OpCode::Multiply:
+		case OpCode::Divide:	return 2;
+		default:				return 1;
+	}
+}
+
+bool CalcParser::Reduce(std::vector<const CalcNode*>& stack, std::vector<Pending>& pending)
+{
+	OpCode op = pending.back().op;
+	pending.pop_back();
+
+	CalcNode* node = arena.New<CalcNode>();
+	node->op = op;
+	if (op == OpCode::Negate)
+	{
+		if (stack.empty()) { return false; }
+		node->type = CalcNode::Type::Negate;
+		node->left = stack.back();
+		stack.back() = node;
+		return true;
+	}
+
+	if (stack.size() < 2) { return false; }
+	node->type = CalcNode::Type::Binary;
+	node->right = stack.back();
+	stack.pop_back();
+	node->left = stack.back();
+	stack.back() = node;
+	return true;
+}
+
+void CalcParser::DiscardFinish()
+{
+	if (!finished) { return; }
+	arena.Rewind(finishMark);
+	finished = false;
+}
+
+// Compile node so the running value ends up holding its value
+// The first operand it needs is brought in with first, Load to start a tape or Push to keep the running value for later
+static void CompileNode(const CalcNode* node, const Operand* operands, OpCode first, CalcTape& tape)
+{
+	switch (node->type)
+	{
+		case CalcNode::Type::Operand:
+			tape.Push(first, operands[node->operand].Value());
+			break;
+		case CalcNode::Type::Negate:
+			CompileNode(node->left, operands, first, tape);
+			tape.Push(OpCode::Negate, 0.0f);
+			break;
+		case CalcNode::Type::Binary:
+		{
+			CompileNode(node->left, operands, first, tape);
+
+			// An operand on the right applies straight to the running value (so a flat stream is the same tape it always was)
+			const CalcNode* right = node->right;
+			if (right->type == CalcNode::Type::Operand)
+			{
+				tape.Push(node->op, operands[right->operand].Value());
+			}
+			// Anything else is worked out on its own then applied to the value it pushed aside
+			else
+			{
+				CompileNode(right, operands, OpCode::Push, tape);
+				tape.Push((OpCode)((int)node->op - (int)OpCode::Add + (int)OpCode::PopAdd), 0.0f);
+			}
+			break;
+		}
+	}
+}
+
+void CompileTape(const CalcNode* root, const Operand* operands, CalcTape& tape)
+{
+	tape.Clear();
+	CompileNode(root, operands, OpCode::Load, tape);
+}
+
+CalcDecimal EvaluateDecimal(const CalcNode* node, const Operand* operands)
+{
+	switch (node->type)
+	{
+		case CalcNode::Type::Operand:
+			return CalcDecimal(operands[node->operand]);
+		case CalcNode::Type::Negate:
+		{
+			CalcDecimal value = EvaluateDecimal(node->left, operands);
+			ApplyOp(OpCode::Negate, CalcDecimal(), value);
+			return value;
+		}
+		default:
+		{
+			CalcDecimal value = EvaluateDecimal(node->left, operands);
+			ApplyOp(node->op, EvaluateDecimal(node->right, operands), value);
+			return value;
+		}
+	}
+}
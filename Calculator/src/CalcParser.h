@@ -0,0 +1,102 @@
+#pragma once
+
+/// <summary>
+/// A node of a parsed calculation stream. Operand nodes refer to the stream's operands by index rather than holding a value,
+/// so digits can still be added to the last operand after it has been parsed
+/// </summary>
+
+struct CalcNode
+{
+	enum class Type : uint8_t { Operand, Binary, Negate };
+
+	Type type = Type::Operand;
+
+	// Add, Subtract, Divide or Multiply for Binary nodes
+	OpCode op = OpCode::Load;
+
+	// Index into the stream's operands for Operand nodes
+	uint32_t operand = 0;
+
+	// Both sides of a Binary node, Negate nodes only use left
+	const CalcNode* left = nullptr;
+	const CalcNode* right = nullptr;
+};
+
+/// <summary>
+/// Shunting-yard parser turning a calculation stream into an expression tree as each token is pushed,
+/// so appending to a stream only does the work for the new token. * and / bind tighter than + and -,
+/// Negate is a prefix operation binding tighter than both, and brackets can be nested to any depth.
+/// Nodes are allocated from a CalcArena rather than individually, the whole tree is dropped by Reset
+/// </summary>
+
+class CalcParser {
+
+public:
+	// Drop everything parsed so far, ready for a new stream
+	void Reset();
+
+	// Push the operand with the given index in the stream's operands
+	void PushOperand(uint32_t operand);
+
+	// Push an operation, either binary (Add, Subtract, Divide, Multiply) or the prefix Negate
+	void PushOperation(OpCode op);
+
+	// Push an opening or closing bracket. Returns false for a closing bracket with no matching opening bracket
+	void PushOpen();
+	bool PushClose();
+
+	// Get the tree for everything pushed so far, closing any brackets that are still open
+	// Doesn't change what's been pushed, so more tokens can be pushed afterwards and Finish called again
+	// The tree is valid until the next Push or Reset, returns nullptr if the stream is incomplete (i.e. ends on an operation)
+	const CalcNode* Finish();
+
+	// Treat everything pushed so far as a single operand, so tokens pushed afterwards apply to its result (used after an equals)
+	void Seal();
+
+	// How many brackets are open
+	size_t OpenBrackets() const { return openBrackets; }
+
+private:
+	// An operation or opening bracket waiting on the operation stack
+	struct Pending
+	{
+		OpCode op;
+		bool open;
+	};
+
+	// How tightly an operation binds, higher binds tighter
+	static int Precedence(OpCode);
+
+	// Pop the top operation off pending and replace its operands on stack with a node for it
+	// Returns false if there weren't enough operands
+	bool Reduce(std::vector<const CalcNode*>& stack, std::vector<Pending>& pending);
+
+	// Drop whatever the last Finish added, it's only kept around until the next Push
+	void DiscardFinish();
+
+	// Every node comes from here
+	CalcArena arena;
+
+	// Complete subtrees waiting to be used as operands, and operations waiting on their right hand operand
+	std::vector<const CalcNode*> nodes;
+	std::vector<Pending> ops;
+
+	// Scratch copies of nodes and ops for Finish, kept so Finish doesn't allocate once warmed up
+	std::vector<const CalcNode*> finishNodes;
+	std::vector<Pending> finishOps;
+
+	// Where the arena was before the last Finish, if it has been called since the last Push
+	CalcArena::Mark finishMark;
+	bool finished = false;
+
+	// Set when the pushed tokens can't form an expression, i.e. an operation with nothing before it
+	bool invalid = false;
+
+	size_t openBrackets = 0;
+};
+
+// Compile a tree into a tape of operations with operand values taken from operands
+void CompileTape(const CalcNode* root, const Operand* operands, CalcTape& tape);
+
+// Calculate a tree exactly with operand values taken from operands
+CalcDecimal EvaluateDecimal(const CalcNode* root, const Operand* operands);
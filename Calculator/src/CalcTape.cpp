@@ -0,0 +1,58 @@
+#pragma once
+#include "Common.h"
+
+/// <summary>
+/// Serialization for CalcTape. The byte layout is:
+/// "CTAP" magic, uint32 entry count, then per entry a uint8 opcode followed by its 4 byte float operand
+/// </summary>
+
+static const char TapeMagic[4] = { 'C', 'T', 'A', 'P' };
+static const size_t TapeHeaderSize = sizeof(TapeMagic) + sizeof(uint32_t);
+static const size_t TapeEntrySize = sizeof(uint8_t) + sizeof(float);
+
+float CalcTape::Evaluate() const
+{
+	return EvaluateTape(entries.data(), entries.size());
+}
+
+std::vector<uint8_t> CalcTape::Serialize() const
+{
+	std::vector<uint8_t> out(TapeHeaderSize + entries.size() * TapeEntrySize);
+	uint8_t* p = out.data();
+
+	uint32_t count = (uint32_t)entries.size();
+	memcpy(p, TapeMagic, sizeof(TapeMagic));		p += sizeof(TapeMagic);
+	memcpy(p, &count, sizeof(count));				p += sizeof(count);
+
+	// Write each field separately so no struct padding ends up in the buffer
+	for (const TapeEntry& e : entries)
+	{
+		*p = (uint8_t)e.op;							p += sizeof(uint8_t);
+		memcpy(p, &e.operand, sizeof(float));		p += sizeof(float);
+	}
+	return out;
+}
+
+bool CalcTape::Deserialize(const uint8_t* data, size_t size, CalcTape& outTape)
+{
+	if (size < TapeHeaderSize || memcmp(data, TapeMagic, sizeof(TapeMagic)) != 0) { return false; }
+
+	uint32_t count;
+	memcpy(&count, data + sizeof(TapeMagic), sizeof(count));
+	if (size != TapeHeaderSize + (size_t)count * TapeEntrySize) { return false; }
+
+	outTape.Clear();
+	outTape.entries.reserve(count);
+	const uint8_t* p = data + TapeHeaderSize;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		// Reject anything that isn't one of our opcodes rather than interpreting garbage
+		if (*p > (uint8_t)OpCode::PopMultiply) { return false; }
+
+		TapeEntry e;
+		e.op = (OpCode)*p;							p += sizeof(uint8_t);
+		memcpy(&e.operand, p, sizeof(float));		p += sizeof(float);
+		outTape.entries.push_back(e);
+	}
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/// <summary>
+/// A flat evaluation tape for a calculation stream. Each entry is an opcode and the operand it applies to,
+/// stored contiguously so a whole stream can be evaluated in a single tight loop, cached, or written out and replayed later
+/// </summary>
+
+// Operations that can appear on a tape. Load sets the running value rather than modifying it and Negate ignores its operand.
+// Push saves the running value on a stack and then loads its operand, the Pop operations apply the running value to the
+// value popped back off the stack (i.e. PopSubtract gives popped - value), which lets a tape hold expressions with precedence and brackets
+enum class OpCode : uint8_t { Load, Add, Subtract, Divide, Multiply, Negate, Push, PopAdd, PopSubtract, PopDivide, PopMultiply };
+
+// A single step of a tape
+struct TapeEntry
+{
+	OpCode op;
+	float operand;
+};
+
+class CalcTape {
+
+public:
+	// Remove every entry, keeping our storage around so rebuilding the tape doesn't allocate
+	void Clear() { entries.clear(); }
+
+	// Append a step to the end of the tape
+	void Push(OpCode op, float operand) { entries.push_back({ op, operand }); }
+
+	size_t Size() const { return entries.size(); }
+	const TapeEntry* Data() const { return entries.data(); }
+
+	// Run every step of the tape in order and return the result
+	float Evaluate() const;
+
+	// Write the tape out as a compact byte buffer (see CalcTape.cpp for the layout)
+	std::vector<uint8_t> Serialize() const;
+
+	// Read a tape back from a buffer written by Serialize, returns false if the buffer isn't a valid tape
+	static bool Deserialize(const uint8_t* data, size_t size, CalcTape& outTape);
+
+private:
+	std::vector<TapeEntry> entries;
+};
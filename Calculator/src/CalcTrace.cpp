@@ -0,0 +1,220 @@
+#pragma once
+#include "Common.h"
+
+static const char TraceMagic[4] = { 'C', 'T', 'R', 'C' };
+
+static void WriteVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	// 7 bits at a time, lowest first, with the top bit set on every byte but the last
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+// Read a varint without going past end, returns false if it runs off the end
+static bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7)
+	{
+		uint8_t byte = *p++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) { return true; }
+	}
+	return false;
+}
+
+void ApplyOperation(CalcIOStreamObj& stream, Operation o)
+{
+	switch (o)
+	{
+		case Operation::Add:
+			stream.AddOperation(OpCode::Add, '+');
+			break;
+
+		case Operation::Subtract:
+			stream.AddOperation(OpCode::Subtract, '-');
+			break;
+
+		case Operation::Divide:
+			stream.AddOperation(OpCode::Divide, '/');
+			break;
+
+		case Operation::Multiply:
+			stream.AddOperation(OpCode::Multiply, '*');
+			break;
+
+		case Operation::Equals:
+			stream.Equals();
+			break;
+
+		case Operation::Decimal:
+			stream.SetDecimalMode();
+			break;
+
+		case Operation::Clear:
+			stream.ClearOperations();
+			break;
+
+		case Operation::DelLast:
+			stream.DelLast();
+			break;
+
+		case Operation::OpenBracket:
+			stream.OpenBracket();
+			break;
+
+		case Operation::CloseBracket:
+			stream.CloseBracket();
+			break;
+
+		case Operation::Undo:
+			stream.Undo();
+			break;
+
+		case Operation::Redo:
+			stream.Redo();
+			break;
+	}
+}
+
+CalcTraceWriter::~CalcTraceWriter()
+{
+	CloseFile();
+}
+
+bool CalcTraceWriter::Open(const std::string& path)
+{
+	CloseFile();
+	file = fopen(path.c_str(), "wb");
+	if (file == nullptr) { return false; }
+
+	buffer.clear();
+	buffer.reserve(BlockSize + 256);
+	// The magic then the version, little endian
+	for (int i = 0; i < 4; i++) { buffer.push_back((uint8_t)TraceMagic[i]); }
+	for (int i = 0; i < 4; i++) { buffer.push_back((uint8_t)(Version >> (i * 8))); }
+	last = std::chrono::steady_clock::now();
+	return true;
+}
+
+void CalcTraceWriter::RecordNum(int digit, const char* line)
+{
+	if (file == nullptr) { return; }
+	Record(TraceEvent::Num, (uint8_t)digit);
+	WriteLineCrc(line);
+}
+
+void CalcTraceWriter::RecordOperation(Operation o, const char* line)
+{
+	if (file == nullptr) { return; }
+	Record(TraceEvent::Operation, (uint8_t)o);
+	WriteLineCrc(line);
+}
+
+void CalcTraceWriter::Close(const char* line, const char* preview)
+{
+	if (file == nullptr) { return; }
+	Record(TraceEvent::End, 0);
+	WriteString(line);
+	WriteString(preview);
+	CloseFile();
+}
+
+void CalcTraceWriter::CloseFile()
+{
+	if (file == nullptr) { return; }
+	WriteBlock();
+	fclose(file);
+	file = nullptr;
+}
+
+void CalcTraceWriter::Record(TraceEvent kind, uint8_t value)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	WriteVarint(buffer, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count());
+	last = now;
+	buffer.push_back((uint8_t)kind);
+	buffer.push_back(value);
+}
+
+void CalcTraceWriter::WriteLineCrc(const char* line)
+{
+	uint32_t crc = Crc32((const uint8_t*)line, strlen(line));
+	for (int i = 0; i < 4; i++) { buffer.push_back((uint8_t)(crc >> (i * 8))); }
+	if (buffer.size() >= BlockSize) { WriteBlock(); }
+}
+
+void CalcTraceWriter::WriteString(const char* s)
+{
+	size_t length = strlen(s);
+	WriteVarint(buffer, length);
+	buffer.insert(buffer.end(), (const uint8_t*)s, (const uint8_t*)s + length);
+}
+
+void CalcTraceWriter::WriteBlock()
+{
+	fwrite(buffer.data(), 1, buffer.size(), file);
+	fflush(file);
+	buffer.clear();
+}
+
+bool CalcTraceReader::Open(const std::string& path)
+{
+	entries.clear();
+	hasEnd = false;
+	truncated = false;
+	finalLine.clear();
+	finalPreview.clear();
+
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr) { return false; }
+	std::vector<uint8_t> data;
+	uint8_t block[64 * 1024];
+	size_t n;
+	while ((n = fread(block, 1, sizeof(block), file)) > 0) { data.insert(data.end(), block, block + n); }
+	fclose(file);
+
+	if (data.size() < 8 || memcmp(data.data(), TraceMagic, 4) != 0) { return false; }
+	uint32_t version = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24);
+	if (version != CalcTraceWriter::Version) { return false; }
+
+	const uint8_t* p = data.data() + 8;
+	const uint8_t* end = data.data() + data.size();
+	uint64_t time = 0;
+	while (p < end)
+	{
+		// Only keep an event once all of it has been read
+		const uint8_t* start = p;
+		CalcTraceEntry entry;
+		uint64_t delta;
+		if (!ReadVarint(p, end, delta) || end - p < 2) { p = start; break; }
+		entry.time = time + delta;
+		entry.kind = (TraceEvent)*p++;
+		entry.value = *p++;
+
+		if (entry.kind == TraceEvent::End)
+		{
+			uint64_t lineLength, previewLength;
+			if (!ReadVarint(p, end, lineLength) || (uint64_t)(end - p) < lineLength) { p = start; break; }
+			finalLine.assign((const char*)p, (size_t)lineLength);
+			p += lineLength;
+			if (!ReadVarint(p, end, previewLength) || (uint64_t)(end - p) < previewLength) { finalLine.clear(); p = start; break; }
+			finalPreview.assign((const char*)p, (size_t)previewLength);
+			p += previewLength;
+			hasEnd = true;
+			break;
+		}
+
+		if (end - p < 4) { p = start; break; }
+		entry.lineCrc = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+		p += 4;
+		time = entry.time;
+		entries.push_back(entry);
+	}
+	truncated = p < end;
+	return true;
+}
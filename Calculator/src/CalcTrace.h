@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <chrono>
+
+class CalcIOStreamObj;
+
+// List of Operations our calculator can perform (digits are added with AddNum), as sent by the UI and recorded in a trace
+enum class Operation : uint8_t { Add, Subtract, Divide, Multiply, Equals, Decimal, Clear, DelLast, OpenBracket, CloseBracket, Undo, Redo };
+
+// Perform an operation on a calculation stream, the same way for the UI and for a trace being replayed
+void ApplyOperation(CalcIOStreamObj& stream, Operation o);
+
+// Kinds of event in a trace
+enum class TraceEvent : uint8_t { Num, Operation, End };
+
+/// <summary>
+/// Records every input the UI sends to its calculation stream in a binary trace file, with when it happened and a checksum of the
+/// line it left on the calculator, so a long session can be replayed headlessly afterwards (see CalcTraceReader).
+/// The file is "CTRC" and a version, then one event after another:
+///   varint nanoseconds since the previous event (since the trace was opened for the first event)
+///   u8 kind (TraceEvent), u8 value (the digit or the Operation)
+///   u32 CRC32 of the active line after the event
+/// An End event has no checksum, it's followed by the final active line and preview (each a varint length then its bytes).
+/// Replaying starts from a new stream that's had AddNum(0), like the UI does before the trace is opened.
+/// Events are buffered and written a block at a time, so a crash loses at most the last block
+/// </summary>
+
+class CalcTraceWriter {
+
+public:
+	static const uint32_t Version = 1;
+
+	CalcTraceWriter() {}
+	~CalcTraceWriter();
+
+	CalcTraceWriter(const CalcTraceWriter&) = delete;
+	CalcTraceWriter& operator=(const CalcTraceWriter&) = delete;
+
+	// Create (or overwrite) a trace file, returns false if it can't be written
+	bool Open(const std::string& path);
+	bool IsOpen() const { return file != nullptr; }
+
+	// Record an input after it's been applied, with the active line it left behind
+	void RecordNum(int digit, const char* line);
+	void RecordOperation(Operation o, const char* line);
+
+	// Write the End event with the final line and preview and close the file.
+	// A trace that's never closed (i.e. the app crashed) still replays, there's just no final output to check
+	void Close(const char* line, const char* preview);
+
+private:
+	// Start an event, then finish it with the checksum of the line it left (writing the buffer out once it's a block long)
+	void Record(TraceEvent kind, uint8_t value);
+	void WriteLineCrc(const char* line);
+	void WriteString(const char* s);
+	void WriteBlock();
+
+	// Write out what's buffered and close the file without an End event
+	void CloseFile();
+
+	static const size_t BlockSize = 64 * 1024;
+
+	FILE* file = nullptr;
+	std::vector<uint8_t> buffer;
+	std::chrono::steady_clock::time_point last;
+};
+
+// One input from a trace, with when it happened (nanoseconds since the trace was opened) and the checksum of the line it left
+struct CalcTraceEntry
+{
+	uint64_t time = 0;
+	TraceEvent kind = TraceEvent::Num;
+	uint8_t value = 0;
+	uint32_t lineCrc = 0;
+};
+
+/// <summary>
+/// Reads back a trace written by CalcTraceWriter, all of it at once. An event cut short at the end of the file (the writer
+/// didn't get to close it) is dropped, everything before it is still there
+/// </summary>
+
+class CalcTraceReader {
+
+public:
+	// Read a whole trace, returns false if it can't be read or isn't a trace
+	bool Open(const std::string& path);
+
+	const std::vector<CalcTraceEntry>& Entries() const { return entries; }
+
+	// Whether the trace was closed, and the line and preview it ended on if it was
+	bool HasEnd() const { return hasEnd; }
+	const std::string& FinalLine() const { return finalLine; }
+	const std::string& FinalPreview() const { return finalPreview; }
+
+	// Whether there was anything after the last whole event that couldn't be read
+	bool Truncated() const { return truncated; }
+
+private:
+	std::vector<CalcTraceEntry> entries;
+	bool hasEnd = false;
+	bool truncated = false;
+	std::string finalLine;
+	std::string finalPreview;
+};
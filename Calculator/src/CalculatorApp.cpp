@@ -2,16 +2,18 @@
 #include "Walnut/Application.h"
 #include "Walnut/EntryPoint.h"
 #include "Walnut/Image.h"
+#include "Walnut/Profiler.h"
+#include "Walnut/PerfOverlay.h"
+#include "Walnut/UploadBenchmark.h"
+#include <imgui_internal.h>
 #include "Common.h"
+#include <filesystem>
 
 /// <summary>
 /// IMGUI initialization, callback linking of UI and calculation data (IO stream object)
 /// as well as keyboard inputs
 /// </summary>
 
-// List of  Operations our calculator can perform
-enum Operation { Add, Subtract, Divide, Multiply, Equals, Decimal, Clear, DelLast };
-
 class CalculatorUI : public Walnut::Layer
 {
 private:
@@ -20,8 +22,20 @@ private:
 
 	// Current calculation stream (white)
 	const char* val = "NAN";
-	//Previous calculation streams (grey) This is an std:: string as we need to add it as single line entries for scrolling purposes
-	std::vector<std::string> pastVal;
+	// Live preview of the current stream's value, drawn under it (grey)
+	const char* preview = "";
+	//Previous calculation streams (grey), only the entries scrolled into view are formatted each frame
+	const CalcHistory* pastVal = nullptr;
+	// Text of the history entry being drawn, reused between entries
+	std::string pastLine;
+
+	// History search box, the newest entries matching it and how far the index had got when they were found
+	static const size_t SearchResultLimit = 1000;
+	static const size_t SearchEntriesPerFrame = 5000;
+	char searchQuery[64] = "";
+	std::vector<size_t> searchResults;
+	size_t searchCount = 0;
+	size_t searchedEnd = 0;
 	// Flags for our IMGUI window behaviour
 	const ImGuiWindowFlags wFlags = ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoScrollbar;
 
@@ -31,13 +45,28 @@ public:
 	std::function<void(float)> onNumPressed;
 	std::function<void(Operation)> onOperationPressed;
 
+	// Search index over the history (linked in CreateApplication), caught up a few thousand entries a frame after loading a big log
+	CalcHistorySearch* historySearch = nullptr;
+
+	// Callback when the UI is closed
+	std::function<void()> onClosed;
+
+	// The active line and preview as they were last set
+	const char* GetValueString() const { return val; }
+	const char* GetPreviewString() const { return preview; }
+
+	virtual void OnDetach() override
+	{
+		if (onClosed) { onClosed(); }
+	}
+
 	// Set the value of our calculations on the UI
 	// Updated val from a reference passed in externally
-	void SetCalculatorValueString(std::tuple<const char*, std::vector<std::string>> t)
+	void SetCalculatorValueString(std::tuple<const char*, const char*, const CalcHistory&> t)
 	{	
 		val = std::get<0>(t);
-		pastVal.clear();
-		pastVal = std::get<1>(t);
+		preview = std::get<1>(t);
+		pastVal = &std::get<2>(t);
 	}
 
 	// Called every tick
@@ -53,7 +82,7 @@ public:
 
 		int n = 0;
 		// Only display past values if we have them
-		if (pastVal.size() == 0) {
+		if (pastVal == nullptr || pastVal->Size() == 0) {
 			n = 1; ImGui::InvisibleButton("##padding", size);
 		}
 
@@ -72,8 +101,24 @@ public:
 					const ImGuiID child_id = ImGui::GetID((void*)(intptr_t)1);
 					const bool child_is_visible = ImGui::BeginChild(child_id, size, true);
 					{
-						for (int i = 0; i < pastVal.size(); i++)
-							ImGui::Text(pastVal[i].c_str());
+						// Every entry takes the height of a separator, its operations, "=" and a result so the clipper can skip straight to the visible ones
+						const float entryHeight = ImGui::GetTextLineHeightWithSpacing() * 4;
+						ImGuiListClipper clipper;
+						clipper.Begin((int)pastVal->Size(), entryHeight);
+						while (clipper.Step())
+						{
+							for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+							{
+								float entryTop = ImGui::GetCursorPosY();
+								pastVal->FormatEntry(pastVal->FirstIndex() + i, pastLine);
+								ImGui::TextUnformatted("--------------");
+								ImGui::TextUnformatted(pastLine.c_str(), pastLine.c_str() + pastLine.size());
+
+								// Pad entries without a result out to the full height
+								float padding = entryHeight - (ImGui::GetCursorPosY() - entryTop) - ImGui::GetStyle().ItemSpacing.y;
+								if (padding > 0.0f) { ImGui::Dummy(ImVec2(1.0f, padding)); }
+							}
+						}
 
 						ImGui::SetScrollHereY(1.0f); // 0.0f:top, 0.5f:center, 1.0f:bottom
 	
@@ -88,6 +133,7 @@ public:
 					draw_list->PushClipRect(p0, p1, true);
 					draw_list->AddRectFilled(p0, p1, IM_COL32(50, 50, 50, 255));
 					draw_list->AddText(text_pos, IM_COL32_WHITE, val);
+					draw_list->AddText(ImVec2(p0.x, p1.y - ImGui::GetTextLineHeightWithSpacing()), IM_COL32(160, 160, 160, 255), preview);
 					draw_list->PopClipRect();
 					break;
 				}
@@ -118,19 +164,73 @@ public:
 		if (ImGui::Button("/", buttonSize)) { onOperationPressed(Operation::Divide); }
 
 		if (ImGui::Button("C", buttonSize))		{ onOperationPressed(Operation::Clear); }	ImGui::SameLine();
-		if (ImGui::Button("DEL", buttonSize))	{ onOperationPressed(Operation::DelLast); }
-		
+		if (ImGui::Button("DEL", buttonSize))	{ onOperationPressed(Operation::DelLast); }	ImGui::SameLine();
+		if (ImGui::Button("(", buttonSize))		{ onOperationPressed(Operation::OpenBracket); }	ImGui::SameLine();
+		if (ImGui::Button(")", buttonSize))		{ onOperationPressed(Operation::CloseBracket); }
+
+		//-------------------------------------------------------------------------------- History search
+		ImGui::SetNextItemWidth(buttonSize.x * 4 + ImGui::GetStyle().ItemSpacing.x * 3);
+		bool queryChanged = ImGui::InputTextWithHint("##search", "Search history: 17* or =1234.5", searchQuery, sizeof(searchQuery));
+		if (historySearch != nullptr && pastVal != nullptr)
+		{
+			// Search again when the query changes or new entries have been indexed
+			historySearch->Update(*pastVal, SearchEntriesPerFrame);
+			// Keep frames coming until the index has caught up, the app otherwise only renders on input
+			if (historySearch->IndexedEnd() < pastVal->EndIndex()) { Walnut::Application::Get().RequestRedraw(); }
+			if (queryChanged || historySearch->IndexedEnd() != searchedEnd)
+			{
+				searchCount = historySearch->Find(*pastVal, searchQuery, searchResults, SearchResultLimit);
+				searchedEnd = historySearch->IndexedEnd();
+			}
+
+			if (searchQuery[0] != '\0')
+			{
+				// Text searches stop counting once they reach the limit
+				ImGui::Text("%zu%s matches", searchCount, searchCount == SearchResultLimit ? "+" : "");
+				if (searchedEnd < pastVal->EndIndex()) { ImGui::SameLine(); ImGui::TextDisabled("(indexed %zu of %zu)", searchedEnd, pastVal->EndIndex()); }
+
+				// Newest first, one line each
+				ImGui::BeginChild("##searchResults", ImVec2(0.0f, 0.0f), true);
+				ImGuiListClipper clipper;
+				clipper.Begin((int)searchResults.size());
+				while (clipper.Step())
+				{
+					for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+					{
+						pastVal->FormatEntry(searchResults[i], pastLine);
+						size_t result = pastLine.find("\n=\n");
+						if (result != std::string::npos) { pastLine.replace(result, 3, " = "); }
+						ImGui::TextDisabled("#%zu", searchResults[i]);
+						ImGui::SameLine();
+						ImGui::TextUnformatted(pastLine.c_str(), pastLine.c_str() + pastLine.size());
+					}
+				}
+				ImGui::EndChild();
+			}
+		}
+
 		ImGui::End();	
 		
 		//Keyboard inputs and their callback values
 		// Imguikey enum https://github.com/ocornut/imgui/blob/a8df192df022ed6ac447e7b7ada718c4c4824b41/imgui.h#L1353
 		//Get pointer to current IMGUI Context so we can access io further down to check if shift is depressed
 		ImGuiContext& g = *GImGui;
+		// Keys typed into the search box aren't calculator input
+		if (g.IO.WantTextInput) { return; }
+		// Undo and redo (Ctrl+Z, and Ctrl+Y or Ctrl+Shift+Z), nothing else is typed with Ctrl held
+		if (g.IO.KeyCtrl == true)
+		{
+			if (ImGui::IsKeyPressed(ImGuiKey_Z)) { onOperationPressed(g.IO.KeyShift ? Operation::Redo : Operation::Undo); }
+			if (ImGui::IsKeyPressed(ImGuiKey_Y)) { onOperationPressed(Operation::Redo); }
+			return;
+		}
 		// Shift keys for people without numpads (like me :-p)
 		if (g.IO.KeyShift == true)
 		{
 			if (ImGui::IsKeyPressed(ImGuiKey_8)) { onOperationPressed(Operation::Multiply); }
 			if (ImGui::IsKeyPressed(ImGuiKey_Equal)) { onOperationPressed(Operation::Add); }
+			if (ImGui::IsKeyPressed(ImGuiKey_9)) { onOperationPressed(Operation::OpenBracket); }
+			if (ImGui::IsKeyPressed(ImGuiKey_0)) { onOperationPressed(Operation::CloseBracket); }
 		}
 		//All other inputs
 		else
@@ -164,69 +264,86 @@ std::shared_ptr<CalculatorUI> calcUI;
 // Pointer to our Calculator IO Stream Class
 CalcIOStreamObj *calcStream = new CalcIOStreamObj();
 
+// Every input from the UI when started with --record-trace FILE, for replaying with CalculatorCLI --replay FILE
+CalcTraceWriter trace;
+
 //Request IO Stream tries to add an operation
 void SetOperation(Operation o)
 {
-	// enum Operation { Add, Subtract, Divide, Multiply, Equals, Decimal};
-	switch (o)
-	{
-		case Operation::Add:
-			calcStream->AddOperation(OpAdd, '+');
-			break;
-
-		case Operation::Subtract:
-			calcStream->AddOperation(OpSubtract, '-');
-			break;
-
-		case Operation::Divide:
-			calcStream->AddOperation(OpDivide, '/');
-			break;
-
-		case Operation::Multiply:
-			calcStream->AddOperation(OpMultiply, '*');
-			break;
-
-		case Operation::Equals:
-			calcStream->Equals();
-			break;
-
-		case Operation::Decimal:
-			calcStream->SetDecimalMode();
-			break;
-
-		case Operation::Clear:
-			calcStream->ClearOperations();
-			break;
-		
-		case Operation::DelLast:
-			calcStream->DelLast();
-			break;
-	}
+	WL_PROFILE_FUNCTION();
+	ApplyOperation(*calcStream, o);
+	trace.RecordOperation(o, calcUI->GetValueString());
 }
 
 //Request IO Stream tries to add a number
-void SetNum(float inF) { calcStream->AddNum(inF); }
+void SetNum(float inF)
+{
+	WL_PROFILE_FUNCTION();
+	calcStream->AddNum(inF);
+	trace.RecordNum((int)inF, calcUI->GetValueString());
+}
+
+// Finish the trace (if we're recording one) with the line the calculator ended on
+void CloseTrace() { trace.Close(calcUI->GetValueString(), calcUI->GetPreviewString()); }
 
 // Update the value of the calculator based on a callback from the IO stream (linked in CreateApplication)
 // Is there a better way to update the calculator UI than via a function here? Ideally I'd like to just have the callback directly call the function in &calcUI
-void UpdateCalcUI(std::tuple<const char*, std::vector<std::string>> t)
+void UpdateCalcUI(std::tuple<const char*, const char*, const CalcHistory&> t)
 {
 	calcUI->SetCalculatorValueString(t);
 }
 
-Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
+// Where the history log is kept, in the user's data directory so it's the same log whichever directory we're started from:
+// %APPDATA%\Calculator on Windows and $XDG_DATA_HOME/Calculator (or ~/.local/share/Calculator) elsewhere.
+// Falls back to the working directory if there's no such directory and it can't be made
+std::string HistoryLogPath()
 {
-	// Get pointers for CalcFunc functions as std::function types
-	std::function<void(float, float&)> add = OpAdd;
-	std::function<void(float, float&)> subtract = OpSubtract;
-	std::function<void(float, float&)> divide = OpDivide;
-	std::function<void(float, float&)> multiply = OpMultiply;
+	std::filesystem::path dir;
+#ifdef WL_PLATFORM_WINDOWS
+	if (const char* appData = getenv("APPDATA")) { dir = appData; }
+#else
+	const char* dataHome = getenv("XDG_DATA_HOME");
+	const char* home = getenv("HOME");
+	if (dataHome != nullptr && dataHome[0] != '\0') { dir = dataHome; }
+	else if (home != nullptr) { dir = std::filesystem::path(home) / ".local" / "share"; }
+#endif
+	if (dir.empty()) { return "CalculatorHistory.log"; }
+
+	dir /= "Calculator";
+	std::error_code error;
+	std::filesystem::create_directories(dir, error);
+	if (error) { return "CalculatorHistory.log"; }
+	return (dir / "CalculatorHistory.log").string();
+}
 
+Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
+{
 	//Walnut app instantiation
 	Walnut::ApplicationSpecification spec;
 	spec.Name = "My Awesome Calculator";
 	spec.Width = 500.0f;
-	spec.Height = 900.0f;
+	spec.Height = 1100.0f;
+	spec.RenderOnDemand = true;
+
+	// A Chrome trace of where each frame's time goes, when started with --profile FILE.
+	// --headless FRAMES builds the UI that many times without a window or GPU and reports how long it took (at --tick-rate HZ if given).
+	// --bench-uploads FRAMES updates 1000 images a frame for that many frames, then reports the CPU time and queue submissions it took.
+	// --history-log PATH keeps the history in that log instead of the user's, --no-history only keeps it in memory
+	uint32_t benchUploadFrames = 0;
+	const char* historyLog = nullptr;
+	bool noHistory = false;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--profile") == 0) { spec.ProfileFilepath = argv[i + 1]; }
+		if (strcmp(argv[i], "--headless") == 0) { spec.Headless = true; spec.HeadlessFrameCount = strtoull(argv[i + 1], nullptr, 10); }
+		if (strcmp(argv[i], "--tick-rate") == 0) { spec.HeadlessTickRate = (float)atof(argv[i + 1]); }
+		if (strcmp(argv[i], "--bench-uploads") == 0) { benchUploadFrames = (uint32_t)strtoul(argv[i + 1], nullptr, 10); }
+		if (strcmp(argv[i], "--history-log") == 0) { historyLog = argv[i + 1]; }
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-history") == 0) { noHistory = true; }
+	}
 	Walnut::Application* app = new Walnut::Application(spec);
 
 	//CalculatorUI* calcUIObj = new CalculatorUI;
@@ -234,6 +351,20 @@ Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
 
 	app->PushLayer(calcUI);
 
+	// Frame times and where they go, shown from View > Performance
+	std::shared_ptr<Walnut::PerfOverlay> perfOverlay = std::make_shared<Walnut::PerfOverlay>();
+	app->PushLayer(perfOverlay);
+	if (benchUploadFrames > 0)
+		app->PushLayer(std::make_shared<Walnut::UploadBenchmark>(benchUploadFrames));
+	app->SetMenubarCallback([perfOverlay]()
+	{
+		if (ImGui::BeginMenu("View"))
+		{
+			perfOverlay->MenuItem();
+			ImGui::EndMenu();
+		}
+	});
+
 
 	//Link UI Callbacks to IO Stream
 	// Numbers
@@ -245,10 +376,23 @@ Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
 	//Link callback from IO stream to UI
 	// Is there a better way to update the calculator UI than via a function here? Ideally I'd like to just have the callback directly call the function in &calcUI
 	calcStream->onValUpdated = &UpdateCalcUI;
+	calcUI->historySearch = &calcStream->GetSearch();
+
+	// Keep history between runs, it's only kept in memory if the log can't be opened. Nothing locks the log against another
+	// instance, so runs that only measure (--headless, --bench-uploads) leave the user's log alone unless given one of their own
+	std::string logPath = historyLog != nullptr ? historyLog : spec.Headless || benchUploadFrames > 0 ? "" : HistoryLogPath();
+	if (!noHistory && !logPath.empty()) { calcStream->GetHistory().OpenLog(logPath); }
 
 	//Set the default value of our to zero
 	SetNum(0.0f);
 
+	// Record inputs from here on if asked to (a replay starts from the same zero)
+	calcUI->onClosed = &CloseTrace;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--record-trace") == 0) { trace.Open(argv[i + 1]); }
+	}
+
 	//std::cin.get();
 	return app;
 }
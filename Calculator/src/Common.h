@@ -1,10 +1,25 @@
 #pragma once
 #include <iostream>
+#include <cstdint>
 #include <vector>
 #include <functional>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "CalcOperand.h"
+#include "CalcDecimal.h"
+#include "CalcArena.h"
+#include "CalcTape.h"
+#include "CalcMemo.h"
+#include "CalcParser.h"
+#include "CalcHistoryLog.h"
+#include "CalcHistory.h"
+#include "CalcHistorySearch.h"
+#include "CalcFold.h"
 #include "CalcIOStreamObj.h"
+#include "CalcTrace.h"
 #include <string>
-#include <imgui_internal.h>
 #include <sstream>
 
 // Declare functions from CalcFunc.cpp
@@ -12,4 +27,22 @@ void OpAdd(float amt, float& value);
 void OpSubtract(float amt, float& value);
 void OpDivide(float by, float& value);
 void OpMultiply(float by, float& value);
+void ApplyOp(OpCode op, float operand, float& value);
+void ApplyOp(OpCode op, const CalcDecimal& operand, CalcDecimal& value);
+// Run a tape starting from a running value of value (the stack starts empty)
+float EvaluateTape(const TapeEntry* tape, size_t count, float value = 0.0f);
+
+// Column versions of the operations, applied element-wise across count values (values[i] = values[i] op amts[i])
+enum class ColumnKernel { Scalar, SSE, AVX2 };
+void OpAddColumn(const float* amts, float* values, size_t count);
+void OpSubtractColumn(const float* amts, float* values, size_t count);
+void OpDivideColumn(const float* bys, float* values, size_t count);
+void OpMultiplyColumn(const float* bys, float* values, size_t count);
+void EvaluateColumns(const OpCode* ops, const float* const* columns, size_t opCount, float* out, size_t rows);
+ColumnKernel GetColumnKernel();
+ColumnKernel SetColumnKernel(ColumnKernel kernel);
+
+// Declare functions from CalcIOStreamObj.cpp
+// Format a result the way the calculator displays it (trailing zeros trimmed), returns the length written to buffer
+size_t FormatFloat(float value, char* buffer, size_t bufferSize);
 
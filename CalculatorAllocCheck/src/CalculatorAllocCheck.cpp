@@ -0,0 +1,93 @@
+#include "CountingAllocator.h"
+#include "Common.h"
+#include <random>
+#include <cstdlib>
+
+/// <summary>
+/// Types keystrokes into a UI calculation stream (CalcIOStreamObj) and counts the heap allocations each keystroke makes once
+/// the stream's arena has warmed up, which should be none. It's a program of its own because counting allocations means
+/// replacing operator new for the whole program (see CountingAllocator.cpp). Returns non-zero if any keystroke allocated
+///
+/// Usage: CalculatorAllocCheck [streams]   (default 1000 streams)
+/// </summary>
+
+// Different streams typed in turn, so the arena has to fit the longest of them
+static const int AllocationCheckScripts = 16;
+static const int AllocationCheckKeys = 200;
+
+// Press a single key on a stream, D is DEL, U and R are undo and redo
+static void PressKey(CalcIOStreamObj& stream, char key)
+{
+	switch (key)
+	{
+		case '+': stream.AddOperation(OpCode::Add, '+'); break;
+		case '-': stream.AddOperation(OpCode::Subtract, '-'); break;
+		case '*': stream.AddOperation(OpCode::Multiply, '*'); break;
+		case '/': stream.AddOperation(OpCode::Divide, '/'); break;
+		case '.': stream.SetDecimalMode(); break;
+		case '(': stream.OpenBracket(); break;
+		case ')': stream.CloseBracket(); break;
+		case 'D': stream.DelLast(); break;
+		case 'U': stream.Undo(); break;
+		case 'R': stream.Redo(); break;
+		case '=': stream.Equals(); break;
+		default: stream.AddNum((float)(key - '0')); break;
+	}
+}
+
+static int RunAllocationCheck(size_t streams)
+{
+	// Mostly digits with operations, brackets and the odd DEL, undo, redo or equals mixed in
+	std::mt19937 rng(1234);
+	const char keyChoices[] = "0123456789012345678901234567890123456789++--**/..(()DDUR=";
+	std::vector<std::string> scripts(AllocationCheckScripts);
+	for (std::string& script : scripts)
+	{
+		for (int i = 0; i < AllocationCheckKeys; i++) { script.push_back(keyChoices[rng() % (sizeof(keyChoices) - 1)]); }
+	}
+
+	// Keep track of how many previous streams the UI has been given, they're the only thing kept between streams
+	CalcIOStreamObj stream;
+	size_t updates = 0, historyLines = 0;
+	stream.onValUpdated = [&](std::tuple<const char*, const char*, const CalcHistory&> t) { updates++; historyLines = std::get<2>(t).Size(); };
+	stream.AddNum(0.0f);
+
+	// Type every script once to warm the arena up, then count allocations over the rest
+	// A key that ends a stream (i.e. a number after an equals) also adds it to the history, count that separately
+	uint64_t keyAllocations = 0, historyAllocations = 0, keystrokes = 0, warmupAllocations = 0;
+	for (size_t s = 0; s < streams + AllocationCheckScripts; s++)
+	{
+		bool warmup = s < AllocationCheckScripts;
+		for (char key : scripts[s % AllocationCheckScripts])
+		{
+			size_t lines = historyLines;
+			uint64_t before = HeapAllocationCount();
+			PressKey(stream, key);
+			uint64_t allocations = HeapAllocationCount() - before;
+
+			if (warmup) { warmupAllocations += allocations; }
+			else if (historyLines != lines) { historyAllocations += allocations; }
+			else { keyAllocations += allocations; }
+		}
+		uint64_t before = HeapAllocationCount();
+		stream.ClearOperations();
+		uint64_t allocations = HeapAllocationCount() - before;
+
+		if (warmup) { warmupAllocations += allocations; continue; }
+		historyAllocations += allocations;
+		keystrokes += AllocationCheckKeys;
+	}
+
+	printf("%zu streams of %d keystrokes (%zu UI updates) after warming up with %d streams (%llu allocations)\n",
+		streams, AllocationCheckKeys, updates, AllocationCheckScripts, (unsigned long long)warmupAllocations);
+	printf("keystrokes       %12llu allocations %10.4f per keystroke\n", (unsigned long long)keyAllocations, keystrokes ? (double)keyAllocations / keystrokes : 0.0);
+	printf("history          %12llu allocations %10.4f per stream (ending a stream keeps its line for the UI)\n", (unsigned long long)historyAllocations, streams ? (double)historyAllocations / streams : 0.0);
+	printf("stream arena     %12zu blocks\n", stream.GetArenaBlockCount());
+	return keyAllocations == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	size_t streams = argc > 1 ? (size_t)atoll(argv[1]) : 0;
+	return RunAllocationCheck(streams > 0 ? streams : 1000);
+}
@@ -0,0 +1,88 @@
+#include "CountingAllocator.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef WL_PLATFORM_WINDOWS
+#include <malloc.h>
+#endif
+
+// Replacing the global operator new replaces it for the whole program, which is why this has its own program rather than
+// being a mode of the CLI. Every form is replaced in pairs so each delete frees memory the way its new allocated it, and
+// they're kept in a file of their own so none of them are inlined into the code using them
+
+static std::atomic<uint64_t> heapAllocations{ 0 };
+
+uint64_t HeapAllocationCount()
+{
+	return heapAllocations.load(std::memory_order_relaxed);
+}
+
+static void* Allocate(size_t size)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+static void* AllocateAligned(size_t size, std::align_val_t alignment)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	size_t align = (size_t)alignment;
+#ifdef WL_PLATFORM_WINDOWS
+	return _aligned_malloc(size ? size : 1, align);
+#else
+	// aligned_alloc wants the size to be a multiple of the alignment
+	return aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+}
+
+static void FreeAligned(void* p)
+{
+#ifdef WL_PLATFORM_WINDOWS
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void* operator new(size_t size)
+{
+	if (void* p = Allocate(size)) { return p; }
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	if (void* p = Allocate(size)) { return p; }
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if (void* p = AllocateAligned(size, alignment)) { return p; }
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	if (void* p = AllocateAligned(size, alignment)) { return p; }
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateAligned(size, alignment); }
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(p); }
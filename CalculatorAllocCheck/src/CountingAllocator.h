@@ -0,0 +1,6 @@
+#pragma once
+#include <cstdint>
+
+// Number of heap allocations made through operator new since the program started
+// (every operator new and delete is replaced in CountingAllocator.cpp to count them, for this program only)
+uint64_t HeapAllocationCount();
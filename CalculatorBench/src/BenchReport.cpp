@@ -0,0 +1,107 @@
+#include "BenchReport.h"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+double BenchResult::Median() const
+{
+	if (samples.empty()) { return 0.0; }
+	std::vector<double> sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+	size_t middle = sorted.size() / 2;
+	return sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2.0;
+}
+
+double BenchResult::Min() const { return samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end()); }
+double BenchResult::Max() const { return samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end()); }
+
+bool BenchReport::Wants(const char* name) const
+{
+	// A filter naming one of the group's results (i.e. equals.decimal) still needs the group to run
+	std::string n(name);
+	return filter.empty() || n.find(filter) != std::string::npos || filter.compare(0, n.size(), n) == 0;
+}
+
+void BenchReport::Add(BenchResult result)
+{
+	if (!filter.empty() && result.name.find(filter) == std::string::npos) { return; }
+
+	std::string params;
+	for (const BenchValue& p : result.params) { params += " " + p.first + "=" + std::to_string((long long)p.second); }
+	fprintf(stderr, "%-28s%-22s %12.1f ns (min %.1f, max %.1f)\n", result.name.c_str(), params.c_str(), result.Median(), result.Min(), result.Max());
+	results.push_back(std::move(result));
+}
+
+void BenchReport::WriteJson(FILE* out) const
+{
+#if defined(WL_DEBUG)
+	const char* config = "Debug";
+#elif defined(WL_RELEASE)
+	const char* config = "Release";
+#elif defined(WL_DIST)
+	const char* config = "Dist";
+#else
+	const char* config = "Unknown";
+#endif
+
+	char timestamp[32];
+	std::time_t now = std::time(nullptr);
+	std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+	fprintf(out, "{\n  \"suite\": \"CalculatorBench\",\n  \"format\": %d,\n  \"config\": \"%s\",\n  \"timestamp\": \"%s\",\n  \"repeat\": %d,\n  \"results\": [",
+		Format, config, timestamp, repeat);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult& r = results[i];
+		fprintf(out, "%s\n    {\n      \"name\": ", i > 0 ? "," : "");
+		WriteString(out, r.name);
+		fprintf(out, ",\n      \"params\": ");
+		WriteValues(out, r.params);
+		fprintf(out, ",\n      \"unit\": \"ns\",\n      \"median\": %.3f,\n      \"min\": %.3f,\n      \"max\": %.3f,\n      \"operations\": %zu,\n      \"samples\": [",
+			r.Median(), r.Min(), r.Max(), r.operations);
+		for (size_t s = 0; s < r.samples.size(); s++) { fprintf(out, "%s%.3f", s > 0 ? ", " : "", r.samples[s]); }
+		fprintf(out, "],\n      \"metrics\": ");
+		WriteValues(out, r.metrics);
+		fprintf(out, "\n    }");
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+void BenchReport::WriteString(FILE* out, const std::string& s)
+{
+	fputc('"', out);
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\') { fputc('\\', out); fputc(c, out); }
+		else if ((unsigned char)c < 0x20) { fprintf(out, "\\u%04x", c); }
+		else { fputc(c, out); }
+	}
+	fputc('"', out);
+}
+
+void BenchReport::WriteValues(FILE* out, const std::vector<BenchValue>& values)
+{
+	// JSON has no NaN or infinity, leave them out as null
+	fputc('{', out);
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		fprintf(out, "%s", i > 0 ? ", " : " ");
+		WriteString(out, values[i].first);
+		if (std::isfinite(values[i].second)) { fprintf(out, ": %.17g", values[i].second); }
+		else { fprintf(out, ": null"); }
+	}
+	fprintf(out, "%s}", values.empty() ? "" : " ");
+}
+
+double TimerOverheadNs()
+{
+	// Smallest of many back to back reads, the clock itself doesn't get any cheaper than that
+	double best = 1e9;
+	for (int i = 0; i < 10000; i++)
+	{
+		BenchClock::time_point start = BenchClock::now();
+		BenchClock::time_point end = BenchClock::now();
+		best = std::min(best, ElapsedNs(start, end));
+	}
+	return best;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+
+// A named number attached to a result, either a parameter of the run (i.e. the stream length) or something it measured besides time
+using BenchValue = std::pair<std::string, double>;
+
+/// <summary>
+/// One benchmark at one set of parameters. Each sample is the average time of an operation over one run,
+/// a benchmark is run several times and the median sample is the one to compare between builds
+/// </summary>
+struct BenchResult
+{
+	std::string name;
+	std::vector<BenchValue> params;
+	std::vector<BenchValue> metrics;
+
+	// Nanoseconds per operation of each run, and how many operations each run timed
+	std::vector<double> samples;
+	size_t operations = 0;
+
+	double Median() const;
+	double Min() const;
+	double Max() const;
+};
+
+/// <summary>
+/// Collects benchmark results and writes them out as JSON, so runs from different builds can be compared by a script.
+/// The layout is one object per run of the suite:
+///   { "suite", "format", "config", "timestamp", "repeat",
+///     "results": [ { "name", "params": {..}, "unit": "ns", "median", "min", "max", "operations", "samples": [..], "metrics": {..} } ] }
+/// "format" only changes if an existing field changes meaning, new fields can be added without it changing
+/// </summary>
+class BenchReport
+{
+public:
+	static const int Format = 1;
+
+	explicit BenchReport(int repeat) : repeat(repeat) {}
+
+	// How many times each benchmark should be run
+	int Repeat() const { return repeat; }
+
+	// Only results whose name contains the filter are kept (all of them if it's empty)
+	void SetFilter(const std::string& f) { filter = f; }
+
+	// Whether a benchmark has any results the filter keeps, given its name or the start of its results' names (i.e. "equals")
+	bool Wants(const char* name) const;
+
+	// Add a result if the filter keeps it, printing a one line summary of it to stderr as we go
+	void Add(BenchResult result);
+
+	void WriteJson(FILE* out) const;
+
+private:
+	int repeat;
+	std::string filter;
+	std::vector<BenchResult> results;
+
+	static void WriteString(FILE* out, const std::string& s);
+	static void WriteValues(FILE* out, const std::vector<BenchValue>& values);
+};
+
+// Time between two points in nanoseconds
+using BenchClock = std::chrono::steady_clock;
+inline double ElapsedNs(BenchClock::time_point start, BenchClock::time_point end) { return std::chrono::duration<double, std::nano>(end - start).count(); }
+
+// What reading the clock twice costs, taken off benchmarks that time each call on its own
+double TimerOverheadNs();
@@ -0,0 +1,56 @@
+#include "BenchReport.h"
+#include "StreamBenchmarks.h"
+#include <cstring>
+#include <cstdlib>
+
+/// <summary>
+/// Microbenchmarks for the calculation engine behind the UI (CalcIOStreamObj and what it uses), built without ImGui or Vulkan.
+/// Every benchmark types the same keystrokes each time it's run, is run several times after an untimed warm up run, and
+/// reports the median. Results are written as JSON (see BenchReport) so runs from different builds can be compared,
+/// with a one line summary of each on stderr as it finishes
+///
+/// Options:
+///   --out FILE   Write the JSON to FILE rather than stdout
+///   --repeat N   Run each benchmark N times (default 5)
+///   --filter S   Only run the benchmarks whose name contains S (i.e. equals, or equals.decimal)
+///   --quick      Smaller runs, for checking the benchmarks themselves still work
+/// </summary>
+
+int main(int argc, char** argv)
+{
+	const char* outPath = nullptr;
+	int repeat = 5;
+	const char* filter = "";
+	bool quick = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) { outPath = argv[++i]; }
+		else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) { repeat = atoi(argv[++i]); }
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) { filter = argv[++i]; }
+		else if (strcmp(argv[i], "--quick") == 0) { quick = true; }
+		else
+		{
+			fprintf(stderr, "unknown option %s\nusage: CalculatorBench [--out FILE] [--repeat N] [--filter S] [--quick]\n", argv[i]);
+			return 2;
+		}
+	}
+
+	BenchReport report(repeat > 0 ? repeat : 1);
+	report.SetFilter(filter);
+	BenchKeystrokes(report, quick);
+	BenchGenerateString(report, quick);
+	BenchEquals(report, quick);
+	BenchCleanFloat(report, quick);
+	BenchHistoryGrowth(report, quick);
+
+	FILE* out = outPath != nullptr ? fopen(outPath, "w") : stdout;
+	if (out == nullptr)
+	{
+		fprintf(stderr, "couldn't open %s\n", outPath);
+		return 1;
+	}
+	report.WriteJson(out);
+	if (out != stdout) { fclose(out); }
+	return 0;
+}
@@ -0,0 +1,262 @@
+#include "StreamBenchmarks.h"
+#include "BenchReport.h"
+#include "Common.h"
+#include <random>
+#include <algorithm>
+
+// Press a single key on a stream, digits, + - * / . ( ) and = for equals
+static void PressKey(CalcIOStreamObj& stream, char key)
+{
+	switch (key)
+	{
+		case '+': stream.AddOperation(OpCode::Add, '+'); break;
+		case '-': stream.AddOperation(OpCode::Subtract, '-'); break;
+		case '*': stream.AddOperation(OpCode::Multiply, '*'); break;
+		case '/': stream.AddOperation(OpCode::Divide, '/'); break;
+		case '.': stream.SetDecimalMode(); break;
+		case '(': stream.OpenBracket(); break;
+		case ')': stream.CloseBracket(); break;
+		case '=': stream.Equals(); break;
+		default: stream.AddNum((float)(key - '0')); break;
+	}
+}
+
+// A stream that only keeps the line it was last given, like the UI does
+static void ListenQuietly(CalcIOStreamObj& stream, const char*& line)
+{
+	stream.onValUpdated = [&line](std::tuple<const char*, const char*, const CalcHistory&> t) { line = std::get<0>(t); };
+	stream.AddNum(0.0f);
+}
+
+// About keys keystrokes of a calculation someone might type, operands of up to 5 digits (some with a couple of decimal places)
+// joined by operations, with the odd bracket. It always ends on an operand with every bracket closed
+static std::string MakeExpression(std::mt19937& rng, size_t keys)
+{
+	std::string s;
+	int open = 0;
+	while (true)
+	{
+		if (rng() % 8 == 0) { s.push_back('('); open++; }
+		s.push_back((char)('1' + rng() % 9));
+		for (int digits = rng() % 5; digits > 0; digits--) { s.push_back((char)('0' + rng() % 10)); }
+		if (rng() % 4 == 0)
+		{
+			s.push_back('.');
+			for (int digits = 1 + rng() % 2; digits > 0; digits--) { s.push_back((char)('0' + rng() % 10)); }
+		}
+		if (open > 0 && rng() % 3 == 0) { s.push_back(')'); open--; }
+		if (s.size() + open >= keys) { break; }
+		s.push_back("+-*/"[rng() % 4]);
+	}
+	s.append(open, ')');
+	return s;
+}
+
+void BenchKeystrokes(BenchReport& report, bool quick)
+{
+	if (!report.Wants("keystroke")) { return; }
+	const size_t streams = quick ? 200 : 2000;
+	const size_t keys = 200;
+
+	// Runs of digits with an operation between them, which keeps every key either an AddNum or an AddOperation
+	std::mt19937 rng(1234);
+	std::vector<std::string> scripts(streams);
+	for (std::string& script : scripts)
+	{
+		while (script.size() < keys) { script.push_back(rng() % 10 < 7 ? (char)('0' + rng() % 10) : "+-*/"[rng() % 4]); }
+	}
+
+	const char* line = "";
+	CalcIOStreamObj stream;
+	ListenQuietly(stream, line);
+	double overhead = TimerOverheadNs();
+
+	BenchResult addNum, addOperation;
+	addNum.name = "keystroke.add_num";
+	addOperation.name = "keystroke.add_operation";
+	// The first run warms the stream's arena up and isn't kept
+	for (int run = 0; run <= report.Repeat(); run++)
+	{
+		double numNs = 0.0, operationNs = 0.0;
+		size_t nums = 0, operations = 0;
+		for (const std::string& script : scripts)
+		{
+			for (char key : script)
+			{
+				bool digit = key >= '0' && key <= '9';
+				BenchClock::time_point start = BenchClock::now();
+				PressKey(stream, key);
+				double ns = ElapsedNs(start, BenchClock::now()) - overhead;
+				if (digit) { numNs += ns; nums++; }
+				else { operationNs += ns; operations++; }
+			}
+			stream.ClearOperations();
+		}
+		if (run == 0) { continue; }
+		addNum.samples.push_back(numNs / nums);
+		addNum.operations = nums;
+		addOperation.samples.push_back(operationNs / operations);
+		addOperation.operations = operations;
+	}
+	addNum.metrics.push_back({ "per_second", 1e9 / addNum.Median() });
+	addOperation.metrics.push_back({ "per_second", 1e9 / addOperation.Median() });
+	report.Add(addNum);
+	report.Add(addOperation);
+}
+
+void BenchGenerateString(BenchReport& report, bool quick)
+{
+	if (!report.Wants("generate_string")) { return; }
+	const size_t updates = quick ? 20000 : 200000;
+	std::vector<size_t> lengths = { 16, 256, 4096 };
+	if (quick) { lengths.pop_back(); }
+
+	for (size_t length : lengths)
+	{
+		std::mt19937 rng(4321);
+		std::string script = MakeExpression(rng, length) + "+";
+
+		// Replacing the trailing operation pops it and pushes the new one, then the whole output is regenerated
+		const char* line = "";
+		CalcIOStreamObj stream;
+		ListenQuietly(stream, line);
+		for (char key : script) { PressKey(stream, key); }
+
+		BenchResult result;
+		result.name = "generate_string";
+		result.params.push_back({ "stream_length", (double)length });
+		for (int run = 0; run <= report.Repeat(); run++)
+		{
+			BenchClock::time_point start = BenchClock::now();
+			for (size_t i = 0; i < updates; i++) { stream.AddOperation(i % 2 ? OpCode::Add : OpCode::Multiply, i % 2 ? '+' : '*'); }
+			double ns = ElapsedNs(start, BenchClock::now());
+			if (run > 0) { result.samples.push_back(ns / updates); }
+		}
+		result.operations = updates;
+		result.metrics.push_back({ "line_length", (double)strlen(line) });
+		report.Add(result);
+	}
+}
+
+void BenchEquals(BenchReport& report, bool quick)
+{
+	const size_t streams = quick ? 100 : 1000;
+	const size_t lengths[] = { 8, 64, 512 };
+
+	struct Case { const char* name; NumericBackend backend; };
+	const Case cases[] = {
+		{ "equals.float", NumericBackend::Float },
+		{ "equals.decimal", NumericBackend::Decimal },
+	};
+
+	double overhead = TimerOverheadNs();
+	for (const Case& c : cases)
+	{
+		if (!report.Wants(c.name)) { continue; }
+		for (size_t length : lengths)
+		{
+			std::mt19937 rng(5678);
+			std::vector<std::string> scripts(streams);
+			for (std::string& script : scripts) { script = MakeExpression(rng, length); }
+
+			const char* line = "";
+			CalcIOStreamObj stream;
+			stream.SetNumericBackend(c.backend);
+			ListenQuietly(stream, line);
+
+			BenchResult result;
+			result.name = c.name;
+			result.params.push_back({ "stream_length", (double)length });
+			for (int run = 0; run <= report.Repeat(); run++)
+			{
+				double ns = 0.0;
+				for (const std::string& script : scripts)
+				{
+					for (char key : script) { PressKey(stream, key); }
+					BenchClock::time_point start = BenchClock::now();
+					stream.Equals();
+					ns += ElapsedNs(start, BenchClock::now()) - overhead;
+					stream.ClearOperations();
+				}
+				if (run > 0) { result.samples.push_back(ns / streams); }
+			}
+			result.operations = streams;
+			report.Add(result);
+		}
+	}
+}
+
+void BenchCleanFloat(BenchReport& report, bool quick)
+{
+	if (!report.Wants("clean_float")) { return; }
+	const size_t calls = quick ? 100000 : 1000000;
+
+	// Results from tiny fractions up to the billions, whole numbers and not, either sign
+	std::mt19937 rng(8765);
+	std::vector<float> values(4096);
+	for (float& v : values)
+	{
+		float magnitude = std::pow(10.0f, (float)((int)(rng() % 16) - 6));
+		v = (rng() % 3 == 0 ? (float)(rng() % 1000) : (float)(rng() % 1000000) / 1000.0f) * magnitude;
+		if (rng() % 4 == 0) { v = -v; }
+	}
+
+	BenchResult result;
+	result.name = "clean_float";
+	size_t characters = 0;
+	char buffer[64];
+	for (int run = 0; run <= report.Repeat(); run++)
+	{
+		BenchClock::time_point start = BenchClock::now();
+		for (size_t i = 0; i < calls; i++) { characters += FormatFloat(values[i % values.size()], buffer, sizeof(buffer)); }
+		double ns = ElapsedNs(start, BenchClock::now());
+		if (run > 0) { result.samples.push_back(ns / calls); }
+	}
+	result.operations = calls;
+	result.metrics.push_back({ "average_length", (double)characters / (calls * (report.Repeat() + 1)) });
+	report.Add(result);
+}
+
+void BenchHistoryGrowth(BenchReport& report, bool quick)
+{
+	if (!report.Wants("history")) { return; }
+	std::vector<size_t> checkpoints = { 1000, 10000, 100000 };
+	if (quick) { checkpoints.pop_back(); }
+
+	// The same calculations every run, each ending in an equals like most history entries
+	std::mt19937 rng(2468);
+	std::vector<std::string> scripts(checkpoints.back());
+	for (std::string& script : scripts) { script = MakeExpression(rng, 4 + rng() % 30) + "="; }
+
+	std::vector<BenchResult> results(checkpoints.size());
+	for (int run = 0; run <= report.Repeat(); run++)
+	{
+		const char* line = "";
+		CalcIOStreamObj stream;
+		ListenQuietly(stream, line);
+
+		// Time archiving each stream, averaged over the streams since the last checkpoint
+		size_t from = 0;
+		for (size_t c = 0; c < checkpoints.size(); c++)
+		{
+			double ns = 0.0;
+			for (size_t i = from; i < checkpoints[c]; i++)
+			{
+				for (char key : scripts[i]) { PressKey(stream, key); }
+				BenchClock::time_point start = BenchClock::now();
+				stream.ClearOperations();
+				ns += ElapsedNs(start, BenchClock::now());
+			}
+			if (run > 0) { results[c].samples.push_back(ns / (checkpoints[c] - from)); }
+
+			// Memory doesn't depend on timing, the last run's is as good as any
+			size_t bytes = stream.GetHistory().MemoryUsage();
+			results[c].name = "history.archive";
+			results[c].params = { { "entries", (double)stream.GetHistory().Size() } };
+			results[c].metrics = { { "bytes", (double)bytes }, { "bytes_per_entry", (double)bytes / stream.GetHistory().Size() } };
+			results[c].operations = checkpoints[c] - from;
+			from = checkpoints[c];
+		}
+	}
+	for (BenchResult& result : results) { report.Add(result); }
+}
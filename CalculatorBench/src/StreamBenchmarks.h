@@ -0,0 +1,22 @@
+#pragma once
+
+class BenchReport;
+
+// Benchmarks of a UI calculation stream (CalcIOStreamObj), each runs report.Repeat() times and adds its results to the report.
+// Every run types the same keystrokes (the random streams come from fixed seeds), quick types fewer of them for a fast check
+
+// Time per AddNum and AddOperation call while typing streams of digits and operations
+void BenchKeystrokes(BenchReport& report, bool quick);
+
+// Time to regenerate the active line and preview (GenerateStringFromStream) after replacing the last operation of streams of
+// increasing length, which should stay flat as the stream grows
+void BenchGenerateString(BenchReport& report, bool quick);
+
+// Time for Equals on streams of increasing length with the float backend (with the result cache off, and hitting it) and the decimal backend
+void BenchEquals(BenchReport& report, bool quick);
+
+// Time to format a float for display (FormatFloat, which CleanFloat writes with)
+void BenchCleanFloat(BenchReport& report, bool quick);
+
+// Memory used by the history and time to archive a stream into it (ClearOperations) as the history grows
+void BenchHistoryGrowth(BenchReport& report, bool quick);
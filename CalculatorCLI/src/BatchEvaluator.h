@@ -0,0 +1,85 @@
+#pragma once
+#include "Common.h"
+#include <cstdio>
+
+/// <summary>
+/// Line by line evaluation shared by the serial and parallel paths of CalculatorCLI.
+/// Output types only need a Write(const char*, size_t) method
+/// </summary>
+
+static const size_t ReadBufferSize = 1 << 20;
+static const size_t WriteBufferSize = 1 << 16;
+
+// Buffered writer for stdout so we aren't making a write call per line. Discards everything if discard is set (used for benchmarking)
+struct OutputBuffer
+{
+	char data[WriteBufferSize];
+	size_t size = 0;
+	bool discard = false;
+
+	void Flush()
+	{
+		if (!discard) { fwrite(data, 1, size, stdout); }
+		size = 0;
+	}
+
+	void Write(const char* s, size_t len)
+	{
+		if (size + len > WriteBufferSize) { Flush(); }
+		if (len > WriteBufferSize) { if (!discard) { fwrite(s, 1, len, stdout); } return; }
+		memcpy(data + size, s, len);
+		size += len;
+	}
+};
+
+// Output for a single chunk of a parallel run, kept until it can be written in order
+struct StringOutput
+{
+	std::string& text;
+
+	void Write(const char* s, size_t len) { text.append(s, len); }
+};
+
+// Write the result of the line folded so far and reset ready for the next line
+template<typename Output>
+void EmitLine(CalcFold& fold, bool lineHasInput, Output& out)
+{
+	char buf[64];
+	float result;
+
+	// Keep blank lines blank so output lines always match up with input lines
+	if (!lineHasInput) { out.Write("\n", 1); }
+	else if (fold.Finish(result))
+	{
+		// Formatted exactly as the calculator UI shows it
+		size_t len = FormatFloat(result, buf, sizeof(buf) - 1);
+		buf[len++] = '\n';
+		out.Write(buf, len);
+	}
+	else { out.Write("ERR\n", 4); }
+
+	fold.Reset();
+}
+
+// Fold every character in the buffer, writing a result for each line that ends inside it
+// A line that runs past the end of the buffer is left in fold/lineHasInput to be continued by the next call
+// Returns the number of lines written
+template<typename Output>
+uint64_t EvaluateLines(const char* data, size_t size, CalcFold& fold, bool& lineHasInput, Output& out)
+{
+	uint64_t lines = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		char c = data[i];
+		if (c == '\n')
+		{
+			EmitLine(fold, lineHasInput, out);
+			lineHasInput = false;
+			lines++;
+			continue;
+		}
+		fold.Feed(c);
+		lineHasInput |= (c != ' ' && c != '\t' && c != '\r');
+	}
+	return lines;
+}
@@ -0,0 +1,180 @@
+#include "BatchEvaluator.h"
+#include "ParallelEvaluator.h"
+#include "ColumnBenchmark.h"
+#include "DecimalBenchmark.h"
+#include "HistoryBenchmark.h"
+#include "MemoBenchmark.h"
+#include "TraceReplay.h"
+#include <chrono>
+#include <algorithm>
+#include <memory>
+
+/// <summary>
+/// Headless batch evaluator for the calculation engine. Reads expressions one per line from the files given on the
+/// command line (or stdin if there are none, or for "-") and writes one result per line to stdout.
+/// Input is streamed through fixed size buffers and each expression is folded as it's read, so memory use stays
+/// constant regardless of input size. Throughput is reported on stderr once everything has been evaluated
+///
+/// Options:
+///   -j N        Evaluate across N worker threads (0 uses every core), results are still written in input order
+///   --scaling   Evaluate the input files once per thread count from 1 up to every core, discarding the results,
+///               and report throughput and speedup for each
+///   --column-bench [rows]
+///               Compare the column kernels against the per-row scalar path evaluating a*b+c (default 10M rows)
+///   --decimal-bench [count]
+///               Compare the float and CalcDecimal backends on short money-like expressions (default 1M expressions)
+///   --history-bench [entries]
+///               Compare the memory used by the compact history against formatted strings, and check calculations carried on
+///               from an equals show what came before it bracketed (default 1M entries)
+///   --history-log-bench [entries]
+///               Write history to a log file, time reopening it and check a torn record is recovered from (default 1M entries)
+///   --search-bench [entries]
+///               Time searching the history by result and by text through the search index against a linear scan (default 1M entries)
+///   --memo-bench [streams]
+///               Evaluate the tapes of recurring rate chains with and without the result cache, report its hits and misses and
+///               check tapes with the same hash are kept apart (default 100000 streams)
+///   --replay TRACE
+///               Replay a trace recorded by the calculator (--record-trace) headlessly, reporting latency percentiles per input
+///               and checking every line matches the recording
+/// </summary>
+
+// Evaluate every line of a file on this thread, returns the number of lines evaluated
+static uint64_t EvaluateFile(FILE* file, char* readBuffer, OutputBuffer& out)
+{
+	CalcFold fold;
+	uint64_t lines = 0;
+	bool lineHasInput = false;
+
+	size_t n;
+	while ((n = fread(readBuffer, 1, ReadBufferSize, file)) > 0)
+	{
+		lines += EvaluateLines(readBuffer, n, fold, lineHasInput, out);
+	}
+
+	// The last line might not end in a newline
+	if (lineHasInput)
+	{
+		EmitLine(fold, lineHasInput, out);
+		lines++;
+	}
+	return lines;
+}
+
+// Evaluate every input, serially if threadCount is 1 or across a thread pool otherwise. Returns the number of lines evaluated, or -1 on error
+static int64_t EvaluateInputs(const std::vector<const char*>& inputs, unsigned threadCount, OutputBuffer& out)
+{
+	static char readBuffer[ReadBufferSize];
+	std::unique_ptr<ParallelEvaluator> parallel;
+	if (threadCount > 1) { parallel = std::make_unique<ParallelEvaluator>(threadCount); }
+
+	int64_t lines = 0;
+	for (const char* input : inputs)
+	{
+		bool isStdin = strcmp(input, "-") == 0;
+		FILE* file = isStdin ? stdin : fopen(input, "rb");
+		if (!file)
+		{
+			fprintf(stderr, "Could not open %s\n", input);
+			return -1;
+		}
+
+		lines += parallel ? parallel->Run(file, out) : EvaluateFile(file, readBuffer, out);
+
+		if (!isStdin) { fclose(file); }
+	}
+	return lines;
+}
+
+int main(int argc, char** argv)
+{
+	static OutputBuffer out;
+
+	std::vector<const char*> inputs;
+	unsigned threadCount = 1;
+	bool scaling = false;
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+		{
+			threadCount = (unsigned)atoi(argv[++i]);
+			if (threadCount == 0) { threadCount = cores; }
+		}
+		else if (strcmp(argv[i], "--scaling") == 0) { scaling = true; }
+		else if (strcmp(argv[i], "--column-bench") == 0)
+		{
+			size_t rows = (i + 1 < argc) ? (size_t)atoll(argv[i + 1]) : 0;
+			return RunColumnBenchmark(rows > 0 ? rows : 10000000);
+		}
+		else if (strcmp(argv[i], "--decimal-bench") == 0)
+		{
+			size_t count = (i + 1 < argc) ? (size_t)atoll(argv[i + 1]) : 0;
+			return RunDecimalBenchmark(count > 0 ? count : 1000000);
+		}
+		else if (strcmp(argv[i], "--history-bench") == 0)
+		{
+			size_t entries = (i + 1 < argc) ? (size_t)atoll(argv[i + 1]) : 0;
+			return RunHistoryBenchmark(entries > 0 ? entries : 1000000);
+		}
+		else if (strcmp(argv[i], "--history-log-bench") == 0)
+		{
+			size_t entries = (i + 1 < argc) ? (size_t)atoll(argv[i + 1]) : 0;
+			return RunHistoryLogBenchmark(entries > 0 ? entries : 1000000);
+		}
+		else if (strcmp(argv[i], "--search-bench") == 0)
+		{
+			size_t entries = (i + 1 < argc) ? (size_t)atoll(argv[i + 1]) : 0;
+			return RunHistorySearchBenchmark(entries > 0 ? entries : 1000000);
+		}
+		else if (strcmp(argv[i], "--memo-bench") == 0)
+		{
+			size_t streams = (i + 1 < argc) ? (size_t)atoll(argv[i + 1]) : 0;
+			return RunMemoBenchmark(streams > 0 ? streams : 100000);
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) { return RunTraceReplay(argv[i + 1]); }
+		else { inputs.push_back(argv[i]); }
+	}
+	if (inputs.empty()) { inputs.push_back("-"); }
+
+	// Run the same input at increasing thread counts, the input has to be files as we read it more than once
+	if (scaling)
+	{
+		for (const char* input : inputs)
+		{
+			if (strcmp(input, "-") == 0)
+			{
+				fprintf(stderr, "--scaling needs input files rather than stdin\n");
+				return 1;
+			}
+		}
+
+		out.discard = true;
+		double baseline = 0.0;
+		fprintf(stderr, "threads\tlines/sec\tspeedup\n");
+		for (unsigned threads = 1; ; threads = std::min(threads * 2, cores))
+		{
+			auto start = std::chrono::steady_clock::now();
+			int64_t lines = EvaluateInputs(inputs, threads, out);
+			if (lines < 0) { return 1; }
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			double rate = seconds > 0.0 ? lines / seconds : 0.0;
+			if (threads == 1) { baseline = rate; }
+			fprintf(stderr, "%u\t%.0f\t%.2fx\n", threads, rate, baseline > 0.0 ? rate / baseline : 0.0);
+
+			if (threads == cores) { break; }
+		}
+		return 0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	int64_t lines = EvaluateInputs(inputs, threadCount, out);
+	out.Flush();
+	fflush(stdout);
+	if (lines < 0) { return 1; }
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stderr, "[CalculatorCLI] %lld lines in %.3fs (%.0f lines/sec) on %u thread(s)\n", (long long)lines, seconds, seconds > 0.0 ? lines / seconds : 0.0, threadCount);
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include "ColumnBenchmark.h"
+#include "Common.h"
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+static const int ColumnBenchmarkRepeats = 10;
+
+// Run a benchmark body a few times and return the fastest time in seconds
+template<typename Body>
+static double TimeBest(Body body)
+{
+	double best = 1e30;
+	for (int i = 0; i < ColumnBenchmarkRepeats; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		body();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+int RunColumnBenchmark(size_t rows)
+{
+	std::vector<float> a(rows), b(rows), c(rows), expected(rows), out(rows);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+	for (size_t i = 0; i < rows; i++) { a[i] = dist(rng); b[i] = dist(rng); c[i] = dist(rng); }
+
+	const OpCode ops[] = { OpCode::Load, OpCode::Multiply, OpCode::Add };
+	const float* columns[] = { a.data(), b.data(), c.data() };
+
+	// The existing scalar path, one tape per row
+	double scalarSeconds = TimeBest([&]
+	{
+		TapeEntry tape[3] = { { OpCode::Load, 0.0f }, { OpCode::Multiply, 0.0f }, { OpCode::Add, 0.0f } };
+		for (size_t i = 0; i < rows; i++)
+		{
+			tape[0].operand = a[i]; tape[1].operand = b[i]; tape[2].operand = c[i];
+			expected[i] = EvaluateTape(tape, 3);
+		}
+	});
+
+	printf("a*b+c over %zu rows (best of %d)\n", rows, ColumnBenchmarkRepeats);
+	printf("%-16s %10.3f ms %8.0f Mrows/sec\n", "per-row tape", scalarSeconds * 1000.0, rows / scalarSeconds / 1e6);
+
+	int result = 0;
+	const ColumnKernel original = GetColumnKernel();
+	const ColumnKernel kernels[] = { ColumnKernel::Scalar, ColumnKernel::SSE, ColumnKernel::AVX2 };
+	const char* names[] = { "column scalar", "column SSE", "column AVX2" };
+	for (int k = 0; k < 3; k++)
+	{
+		// Skip anything this CPU can't run
+		if (SetColumnKernel(kernels[k]) != kernels[k]) { continue; }
+
+		double seconds = TimeBest([&] { EvaluateColumns(ops, columns, 3, out.data(), rows); });
+		bool identical = memcmp(out.data(), expected.data(), rows * sizeof(float)) == 0;
+		if (!identical) { result = 1; }
+
+		printf("%-16s %10.3f ms %8.0f Mrows/sec %6.2fx %s\n", names[k], seconds * 1000.0, rows / seconds / 1e6,
+			scalarSeconds / seconds, identical ? "identical" : "MISMATCH");
+	}
+	SetColumnKernel(original);
+	return result;
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+// Time a*b+c over the given number of rows through the per-row scalar path and each column kernel the CPU supports,
+// checking every kernel gives identical results. Returns non-zero if any of them didn't match
+int RunColumnBenchmark(size_t rows);
@@ -0,0 +1,60 @@
+#include "DecimalBenchmark.h"
+#include "Common.h"
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+// Operands and operations per expression
+static const int DecimalBenchmarkOperands = 4;
+
+int RunDecimalBenchmark(size_t expressions)
+{
+	// Up to 7 digit operands with 2 decimal places, mostly adds, subtracts and multiplies with the odd divide
+	std::mt19937 rng(1234);
+	std::vector<Operand> operands(expressions * DecimalBenchmarkOperands);
+	std::vector<OpCode> ops(expressions * DecimalBenchmarkOperands);
+	for (size_t i = 0; i < operands.size(); i++)
+	{
+		operands[i].digits = (uint8_t)(3 + rng() % 5);
+		operands[i].mantissa = 1 + rng() % (PowersOfTen[operands[i].digits] - 1);
+		operands[i].scale = 2;
+
+		const OpCode choices[] = { OpCode::Add, OpCode::Subtract, OpCode::Multiply, OpCode::Add, OpCode::Multiply, OpCode::Divide };
+		ops[i] = (i % DecimalBenchmarkOperands == 0) ? OpCode::Load : choices[rng() % 6];
+	}
+
+	// Keep a running total of the results so the work can't be optimized away
+	double floatSum = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t e = 0; e < expressions; e++)
+	{
+		float value = 0.0f;
+		for (int i = 0; i < DecimalBenchmarkOperands; i++)
+		{
+			size_t index = e * DecimalBenchmarkOperands + i;
+			ApplyOp(ops[index], operands[index].Value(), value);
+		}
+		floatSum += value;
+	}
+	double floatSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double decimalSum = 0.0;
+	start = std::chrono::steady_clock::now();
+	for (size_t e = 0; e < expressions; e++)
+	{
+		CalcDecimal value;
+		for (int i = 0; i < DecimalBenchmarkOperands; i++)
+		{
+			size_t index = e * DecimalBenchmarkOperands + i;
+			ApplyOp(ops[index], CalcDecimal(operands[index]), value);
+		}
+		decimalSum += value.IsZero() ? 0.0 : 1.0;
+	}
+	double decimalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%zu expressions of %d short operands\n", expressions, DecimalBenchmarkOperands);
+	printf("%-10s %10.3f ms %10.2f M expressions/sec\n", "float", floatSeconds * 1000.0, expressions / floatSeconds / 1e6);
+	printf("%-10s %10.3f ms %10.2f M expressions/sec %6.1fx slower\n", "decimal", decimalSeconds * 1000.0, expressions / decimalSeconds / 1e6, decimalSeconds / floatSeconds);
+	fprintf(stderr, "(checksums %f %f)\n", floatSum, decimalSum);
+	return 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+// Time the float and CalcDecimal backends evaluating the same short money-like expressions (i.e. 1234.56*3+78.9/4)
+// and report the throughput of each
+int RunDecimalBenchmark(size_t expressions);
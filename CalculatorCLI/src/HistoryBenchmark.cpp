@@ -0,0 +1,317 @@
+#include "HistoryBenchmark.h"
+#include "Common.h"
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <filesystem>
+
+// Press a single key on a stream, using the same characters as the CLI's expressions plus = for equals
+static void PressKey(CalcIOStreamObj& stream, char key)
+{
+	switch (key)
+	{
+		case '+': stream.AddOperation(OpCode::Add, '+'); break;
+		case '-': stream.AddOperation(OpCode::Subtract, '-'); break;
+		case '*': stream.AddOperation(OpCode::Multiply, '*'); break;
+		case '/': stream.AddOperation(OpCode::Divide, '/'); break;
+		case '.': stream.SetDecimalMode(); break;
+		case '(': stream.OpenBracket(); break;
+		case ')': stream.CloseBracket(); break;
+		case '=': stream.Equals(); break;
+		default: stream.AddNum((float)(key - '0')); break;
+	}
+}
+
+// Bytes held by a string, including its heap buffer if it's too long to be stored inline
+static size_t StringMemory(const std::string& s)
+{
+	const char* object = (const char*)&s;
+	bool inline_ = s.data() >= object && s.data() < object + sizeof(std::string);
+	return sizeof(std::string) + (inline_ ? 0 : s.capacity() + 1);
+}
+
+// Calculations of 2 to 6 operands with a few decimals, brackets and unary minuses, mostly ending in an equals
+static void MakeCalculation(std::mt19937& rng, std::string& script)
+{
+	script.clear();
+	int operands = 2 + rng() % 5;
+	bool open = false;
+	for (int i = 0; i < operands; i++)
+	{
+		if (i > 0) { script.push_back("+-*/+-"[rng() % 6]); }
+		if (rng() % 8 == 0) { script.push_back('-'); }
+		if (!open && i + 1 < operands && rng() % 6 == 0) { script.push_back('('); open = true; }
+		int digits = 1 + rng() % 5;
+		for (int d = 0; d < digits; d++) { script.push_back((char)('1' + rng() % 9)); }
+		if (rng() % 4 == 0) { script.push_back('.'); script.push_back((char)('0' + rng() % 10)); }
+		if (open && rng() % 2 == 0) { script.push_back(')'); open = false; }
+	}
+	if (rng() % 10 != 0) { script.push_back('='); }
+}
+
+// Type calculations that carry on from an equals and check the line and the history entry bracket what came before it, and
+// that undoing back to the equals and redoing puts the line back. Returns how many didn't
+static size_t CheckContinuedEquals()
+{
+	const char* cases[][2] = {
+		{ "2+3=*4=", "(2+3)*4\n=\n20" },
+		{ "(2+3)=*4=", "(2+3)*4\n=\n20" },
+		{ "(2+3=*4=", "(2+3)*4\n=\n20" },
+		{ "1+(2=*3-1=/2=", "((1+(2))*3-1)/2\n=\n4" },
+	};
+	CalcIOStreamObj stream;
+	std::string activeLine;
+	stream.onValUpdated = [&activeLine](std::tuple<const char*, const char*, const CalcHistory&> t) { activeLine = std::get<0>(t); };
+	stream.AddNum(0.0f);
+
+	size_t failures = 0;
+	std::string text;
+	for (const auto& c : cases)
+	{
+		std::string script = c[0];
+		for (char key : script) { PressKey(stream, key); }
+		std::string typed = activeLine;
+
+		// Back to the first equals and forward again
+		size_t continued = script.find('=') + 1;
+		for (size_t i = continued; i < script.size(); i++) { stream.Undo(); }
+		std::string undone = activeLine;
+		for (size_t i = continued; i < script.size(); i++) { stream.Redo(); }
+		std::string redone = activeLine;
+
+		stream.ClearOperations();
+		CalcHistory& history = stream.GetHistory();
+		history.FormatEntry(history.EndIndex() - 1, text);
+
+		std::string firstLine = script.substr(0, continued - 1);
+		bool ok = typed == c[1] && text == c[1] && redone == c[1] && undone.compare(0, firstLine.size() + 3, firstLine + "\n=\n") == 0;
+		failures += !ok;
+		if (!ok) { printf("%s shows \"%s\", history \"%s\", undone \"%s\", redone \"%s\"\n", c[0], typed.c_str(), text.c_str(), undone.c_str(), redone.c_str()); }
+	}
+	printf("%zu of %zu calculations carried on from an equals shown bracketed\n", std::size(cases) - failures, std::size(cases));
+	return failures;
+}
+
+int RunHistoryBenchmark(size_t entries)
+{
+	std::mt19937 rng(1234);
+	std::string script;
+
+	CalcIOStreamObj stream;
+	CalcHistory& history = stream.GetHistory();
+	history.SetMemoryCap(SIZE_MAX);
+	const char* activeLine = "";
+	stream.onValUpdated = [&activeLine](std::tuple<const char*, const char*, const CalcHistory&> t) { activeLine = std::get<0>(t); };
+	stream.AddNum(0.0f);
+
+	// Keep the lines the way the stream used to, a separator and the formatted line for every stream cleared
+	std::vector<std::string> lines;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t e = 0; e < entries; e++)
+	{
+		MakeCalculation(rng, script);
+		for (char key : script) { PressKey(stream, key); }
+		lines.push_back("--------------\n");
+		lines.push_back(activeLine);
+		stream.ClearOperations();
+	}
+	double typeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Make sure every entry formats back to exactly what was displayed
+	std::string text;
+	size_t mismatches = 0;
+	start = std::chrono::steady_clock::now();
+	for (size_t e = 0; e < history.Size(); e++)
+	{
+		history.FormatEntry(history.FirstIndex() + e, text);
+		if (text != lines[e * 2 + 1]) { mismatches++; }
+	}
+	double formatSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t lineBytes = lines.capacity() * sizeof(std::string);
+	for (const std::string& line : lines) { lineBytes += StringMemory(line); }
+	size_t historyBytes = history.MemoryUsage();
+
+	printf("%zu calculations typed in %.3fs\n", entries, typeSeconds);
+	printf("%-28s %12zu bytes %8.1f bytes/entry\n", "std::vector<std::string>", lineBytes, (double)lineBytes / entries);
+	printf("%-28s %12zu bytes %8.1f bytes/entry %6.1fx smaller\n", "CalcHistory", historyBytes, (double)historyBytes / entries, (double)lineBytes / historyBytes);
+	printf("formatted every entry in %.3fs (%.0f ns/entry), %zu mismatches\n", formatSeconds, formatSeconds * 1e9 / entries, mismatches);
+	mismatches += CheckContinuedEquals();
+	return mismatches == 0 ? 0 : 1;
+}
+
+int RunHistoryLogBenchmark(size_t entries)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "CalculatorHistoryBench.log";
+	std::filesystem::path indexPath = path;
+	indexPath += ".idx";
+	std::filesystem::remove(path);
+	std::filesystem::remove(indexPath);
+
+	// Type the calculations into a stream with the log attached, keeping the lines it displayed to check against
+	std::mt19937 rng(1234);
+	std::string script;
+	std::vector<std::string> lines;
+	auto start = std::chrono::steady_clock::now();
+	{
+		CalcIOStreamObj stream;
+		if (!stream.GetHistory().OpenLog(path.string()))
+		{
+			fprintf(stderr, "Couldn't open %s\n", path.string().c_str());
+			return 1;
+		}
+		const char* activeLine = "";
+		stream.onValUpdated = [&activeLine](std::tuple<const char*, const char*, const CalcHistory&> t) { activeLine = std::get<0>(t); };
+		stream.AddNum(0.0f);
+		for (size_t e = 0; e < entries; e++)
+		{
+			MakeCalculation(rng, script);
+			for (char key : script) { PressKey(stream, key); }
+			lines.push_back(activeLine);
+			stream.ClearOperations();
+		}
+	}
+	double typeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uintmax_t logBytes = std::filesystem::file_size(path);
+	uintmax_t indexBytes = std::filesystem::file_size(indexPath);
+
+	// Opening again should only touch the end of the log, then the newest screenful of entries is all the UI formats
+	std::string text;
+	size_t mismatches = 0;
+	double openSeconds, screenSeconds;
+	{
+		CalcHistory history;
+		start = std::chrono::steady_clock::now();
+		bool opened = history.OpenLog(path.string());
+		openSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!opened || history.Size() != entries)
+		{
+			fprintf(stderr, "Reopened log has %zu entries, expected %zu\n", history.Size(), entries);
+			return 1;
+		}
+
+		start = std::chrono::steady_clock::now();
+		for (size_t e = entries > 20 ? entries - 20 : 0; e < entries; e++) { history.FormatEntry(e, text); }
+		screenSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for (size_t e = 0; e < entries; e++)
+		{
+			history.FormatEntry(e, text);
+			if (text != lines[e]) { mismatches++; }
+		}
+	}
+
+	// Tear the last record as if we crashed part way through writing it, it should be dropped and everything before it kept
+	std::filesystem::resize_file(path, logBytes - 3);
+	size_t recovered;
+	{
+		CalcHistory history;
+		history.OpenLog(path.string());
+		recovered = history.Size();
+	}
+	std::filesystem::remove(path);
+	std::filesystem::remove(indexPath);
+
+	printf("%zu calculations typed into the log in %.3fs\n", entries, typeSeconds);
+	printf("log %ju bytes (%.1f bytes/entry), index %ju bytes\n", logBytes, (double)logBytes / entries, indexBytes);
+	printf("reopened in %.3fms, newest 20 entries formatted in %.3fms, %zu mismatches\n", openSeconds * 1e3, screenSeconds * 1e3, mismatches);
+	printf("after tearing the last record %zu of %zu entries recovered\n", recovered, entries);
+	return mismatches == 0 && recovered + 1 == entries ? 0 : 1;
+}
+
+// Run each query through the search index and check it finds the same entries as formatting every entry and looking through it.
+// Returns how many queries found something different
+static size_t CheckQueries(const CalcHistory& history, const CalcHistorySearch& search, const std::vector<std::string>& queries)
+{
+	const size_t limit = 1000;
+	std::vector<size_t> found, expected;
+	std::string text;
+	size_t mismatches = 0;
+	for (const std::string& query : queries)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t count = search.Find(history, query, found, limit);
+		double searchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// The newest limit matches, found the slow way
+		expected.clear();
+		size_t total = 0;
+		start = std::chrono::steady_clock::now();
+		for (size_t e = history.EndIndex(); e-- > history.FirstIndex(); )
+		{
+			history.FormatEntry(e, text);
+			size_t resultStart = text.find("\n=\n");
+			char* resultEnd = nullptr;
+			bool match = query[0] == '='
+				? resultStart != std::string::npos && strtod(text.c_str() + resultStart + 3, &resultEnd) == strtod(query.c_str() + 1, nullptr) &&
+					resultEnd != text.c_str() + resultStart + 3 && *resultEnd == '\0'
+				: text.substr(0, resultStart).find(query) != std::string::npos;
+			if (match && expected.size() < limit) { expected.push_back(e); }
+			total += match;
+		}
+		double scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		bool same = found == expected && (query[0] == '=' ? count == total : count == std::min(total, limit));
+		mismatches += !same;
+		printf("%-14s %8zu matches  index %9.3fms  scan %9.3fms %s\n", query.c_str(), count, searchSeconds * 1e3, scanSeconds * 1e3, same ? "" : "MISMATCH");
+	}
+	return mismatches;
+}
+
+// The result of the newest entry at or before e that has one, as a search for it
+static std::string ResultQuery(const CalcHistory& history, size_t e)
+{
+	std::string text;
+	for (e++; text.find("\n=\n") == std::string::npos && e-- > history.FirstIndex(); ) { history.FormatEntry(e, text); }
+	size_t resultStart = text.find("\n=\n");
+	return resultStart == std::string::npos ? "=0" : "=" + text.substr(resultStart + 3);
+}
+
+int RunHistorySearchBenchmark(size_t entries)
+{
+	std::mt19937 rng(1234);
+	std::string script;
+	CalcIOStreamObj stream;
+	CalcHistory& history = stream.GetHistory();
+	CalcHistorySearch& search = stream.GetSearch();
+	history.SetMemoryCap(SIZE_MAX);
+	stream.onValUpdated = [](std::tuple<const char*, const char*, const CalcHistory&>) {};
+	stream.AddNum(0.0f);
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t e = 0; e < entries; e++)
+	{
+		MakeCalculation(rng, script);
+		for (char key : script) { PressKey(stream, key); }
+		stream.ClearOperations();
+	}
+	double typeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%zu calculations typed and indexed in %.3fs, index %zu bytes (%.1f bytes/entry)\n", entries, typeSeconds, search.MemoryUsage(), (double)search.MemoryUsage() / entries);
+
+	// Search for a result we know is there and some text
+	std::vector<std::string> queries = { ResultQuery(history, history.EndIndex() - 1), "17*", "(12", "999", "-(", "5.5", "1234", "/0", "+" };
+	size_t mismatches = CheckQueries(history, search, queries);
+
+	// Drop the oldest half of the history to get under a lower memory cap, the index still has the dropped entries but
+	// mustn't find them. Look for the result of one of the dropped entries as well, most of its matches are gone
+	std::string droppedResult = ResultQuery(history, history.FirstIndex() + history.Size() / 4);
+	size_t before = history.Size();
+	history.SetMemoryCap(history.MemoryUsage() / 2);
+	printf("after dropping %zu of %zu entries\n", before - history.Size(), before);
+	queries.push_back(droppedResult);
+	mismatches += CheckQueries(history, search, queries);
+
+	// A division by zero on the Decimal backend ends in "Error", which isn't a result of 0 to search for
+	stream.SetNumericBackend(NumericBackend::Decimal);
+	for (char key : std::string("7/0=")) { PressKey(stream, key); }
+	stream.ClearOperations();
+	stream.SetNumericBackend(NumericBackend::Float);
+	std::string errorText;
+	history.FormatEntry(history.EndIndex() - 1, errorText);
+	std::vector<size_t> found;
+	search.Find(history, "=0", found, 1);
+	bool errorSkipped = errorText.find("Error") != std::string::npos && (found.empty() || found[0] != history.EndIndex() - 1);
+	printf("entry ending in an error %s a search for =0\n", errorSkipped ? "isn't found by" : "is FOUND by");
+	mismatches += CheckQueries(history, search, { "=0", "7/0" });
+	return mismatches == 0 && errorSkipped ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+
+// Type short calculations into a UI calculation stream, clearing after each one, and compare the memory used by its compact
+// history against the std::vector<std::string> of formatted lines it used to keep. Also checks every entry formats back to the line
+// the stream displayed and reports how long formatting takes
+int RunHistoryBenchmark(size_t entries);
+
+// Type calculations into a stream whose history is kept in a log file, then reopen the log, report how long that takes and check
+// every entry reads back. Finally tears the last record and checks reopening drops just that one
+int RunHistoryLogBenchmark(size_t entries);
+
+// Type calculations into a stream and time searching its history through the search index against formatting and checking every
+// entry, making sure both find the same entries
+int RunHistorySearchBenchmark(size_t entries);
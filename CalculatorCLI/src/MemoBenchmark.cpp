@@ -0,0 +1,220 @@
+#include "MemoBenchmark.h"
+#include "Common.h"
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <unordered_map>
+
+// Compile the tape of a script up to each equals, the same way the history works a result out again
+static void CompileScript(const std::string& script, std::vector<CalcTape>& tapes)
+{
+	CalcParser parser;
+	std::vector<Operand> operands;
+	bool typing = false, decimal = false;
+	for (char key : script)
+	{
+		if (key >= '0' && key <= '9')
+		{
+			if (!typing) { operands.emplace_back(); parser.PushOperand((uint32_t)(operands.size() - 1)); }
+			Operand& op = operands.back();
+			op.mantissa = op.mantissa * 10 + (key - '0');
+			op.scale += decimal;
+			op.digits++;
+			typing = true;
+			continue;
+		}
+		if (key == '.') { decimal = true; continue; }
+
+		typing = decimal = false;
+		if (key == '=')
+		{
+			tapes.emplace_back();
+			CompileTape(parser.Finish(), operands.data(), tapes.back());
+			continue;
+		}
+		parser.PushOperation(key == '*' ? OpCode::Multiply : key == '/' ? OpCode::Divide : key == '+' ? OpCode::Add : OpCode::Subtract);
+	}
+}
+
+// Evaluate and format every tape with the given cache capacity (0 evaluates and formats them directly, without the cache), appending each formatted result to lines.
+// Returns the time spent evaluating and formatting
+static double EvaluateTapes(const std::vector<CalcTape>& tapes, size_t capacity, std::vector<std::string>& lines, CalcMemo& memo)
+{
+	memo.SetCapacity(capacity);
+	memo.ResetCounters();
+	lines.clear();
+	lines.reserve(tapes.size());
+
+	double seconds = 0.0;
+	char buffer[64];
+	for (const CalcTape& tape : tapes)
+	{
+		auto start = std::chrono::steady_clock::now();
+		size_t length;
+		if (capacity == 0) { length = FormatFloat(tape.Evaluate(), buffer, sizeof(buffer)); }
+		else
+		{
+			memo.Evaluate(tape);
+			length = memo.FormatResult(buffer, sizeof(buffer));
+		}
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		lines.emplace_back(buffer, length);
+	}
+	return seconds;
+}
+
+// Build two different tapes "a * b * c" with the same hash and check the cache still gives each its own result.
+// The hash is FNV-1a, so two "a * b" prefixes whose hashes (once the last Multiply is folded in) agree in the top 32 bits
+// only differ in the bits c is xored into, and values of c that cancel that difference out make the whole tapes collide
+static bool CheckCollision()
+{
+	const uint64_t prime = 1099511628211ull;
+	auto prefixState = [prime](float a, float b)
+	{
+		uint64_t hash = CalcMemo::HashEntry(CalcMemo::HashEntry(CalcMemo::HashSeed, { OpCode::Load, a }), { OpCode::Multiply, b });
+		return (hash ^ (uint64_t)OpCode::Multiply) * prime;
+	};
+
+	// Random prefixes until two share the top half of their state, which takes around 2^16 of them
+	std::mt19937 rng(99);
+	std::unordered_map<uint32_t, std::pair<float, float>> seen;
+	float a1 = 0.0f, b1 = 0.0f, a2 = 0.0f, b2 = 0.0f;
+	while (a1 == a2 && b1 == b2)
+	{
+		float a = (float)(rng() % 1000000) / 100.0f, b = (float)(rng() % 1000000) / 100.0f;
+		auto [it, added] = seen.emplace((uint32_t)(prefixState(a, b) >> 32), std::make_pair(a, b));
+		if (!added && it->second != std::make_pair(a, b)) { a1 = it->second.first; b1 = it->second.second; a2 = a; b2 = b; }
+	}
+
+	uint32_t difference = (uint32_t)(prefixState(a1, b1) ^ prefixState(a2, b2));
+	CalcTape tape1, tape2;
+	for (float c1 = 1.0f; tape1.Size() == 0; c1 *= 2.0f)
+	{
+		uint32_t bits;
+		memcpy(&bits, &c1, sizeof(bits));
+		bits ^= difference;
+		float c2;
+		memcpy(&c2, &bits, sizeof(c2));
+		if (!std::isfinite(c2)) { continue; }
+		tape1.Push(OpCode::Load, a1); tape1.Push(OpCode::Multiply, b1); tape1.Push(OpCode::Multiply, c1);
+		tape2.Push(OpCode::Load, a2); tape2.Push(OpCode::Multiply, b2); tape2.Push(OpCode::Multiply, c2);
+	}
+
+	uint64_t hash1 = CalcMemo::HashSeed, hash2 = CalcMemo::HashSeed;
+	for (size_t i = 0; i < tape1.Size(); i++)
+	{
+		hash1 = CalcMemo::HashEntry(hash1, tape1.Data()[i]);
+		hash2 = CalcMemo::HashEntry(hash2, tape2.Data()[i]);
+	}
+
+	CalcMemo memo;
+	float first = memo.Evaluate(tape1);
+	float second = memo.Evaluate(tape2);
+	bool ok = hash1 == hash2 && first == tape1.Evaluate() && second == tape2.Evaluate() && memo.Hits() == 0;
+	printf("colliding tapes %g*%g*%g and %g*%g*%g (hash %016llx): %s\n", a1, b1, tape1.Data()[2].operand, a2, b2, tape2.Data()[2].operand,
+		(unsigned long long)hash2, ok ? "kept apart" : hash1 != hash2 ? "don't collide" : "MIXED UP");
+	return ok;
+}
+
+// Add a script to the history as one entry, the same tokens typing it into a stream would archive
+static void CommitScript(CalcHistory& history, const std::string& script)
+{
+	history.BeginEntry(NumericBackend::Float);
+	Operand op;
+	bool typing = false, point = false;
+	for (char key : script)
+	{
+		if (key >= '0' && key <= '9')
+		{
+			op.mantissa = op.mantissa * 10 + (key - '0');
+			op.scale += point;
+			op.digits++;
+			typing = true;
+			continue;
+		}
+		if (key == '.') { point = true; continue; }
+
+		if (typing) { history.AddOperand(op, point); }
+		op = Operand();
+		typing = point = false;
+		if (key == '=') { history.AddEqual(); }
+		else { history.AddOperation(key == '*' ? OpCode::Multiply : key == '/' ? OpCode::Divide : key == '+' ? OpCode::Add : OpCode::Subtract); }
+	}
+	if (typing) { history.AddOperand(op, point); }
+	history.CommitEntry();
+}
+
+// Format the entries in view every frame like the UI does, scrolling back through the history an entry every few frames, with the
+// history's result memo at the given capacity. The lines of the last frame are left in lines, returns the time spent formatting
+static double FormatFrames(const CalcHistory& history, size_t capacity, size_t frames, std::vector<std::string>& lines)
+{
+	const size_t inView = 8;
+	history.GetResultMemo().SetCapacity(capacity);
+	history.GetResultMemo().ResetCounters();
+	lines.assign(inView, std::string());
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t frame = 0; frame < frames; frame++)
+	{
+		size_t top = history.EndIndex() - inView - (frame / 4) % (history.Size() - inView);
+		for (size_t i = 0; i < inView; i++) { history.FormatEntry(top + i, lines[i]); }
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int RunMemoBenchmark(size_t streams)
+{
+	// A few bases and rates used over and over, each stream applying its rate up to 40 times and checking the total after each
+	std::mt19937 rng(1234);
+	const char* bases[] = { "1000", "2500", "125.5", "99.99", "10000", "4200", "750", "18.75" };
+	const char* rates[] = { "*1.05", "*1.0125", "*0.98", "/1.2", "*1.175" };
+	std::vector<CalcTape> tapes;
+	std::string script;
+	for (size_t i = 0; i < streams; i++)
+	{
+		script = bases[rng() % 8];
+		const char* rate = rates[rng() % 5];
+		for (int n = 1 + rng() % 40; n > 0; n--) { script += rate; script += '='; }
+		CompileScript(script, tapes);
+	}
+
+	std::vector<std::string> uncachedLines, cachedLines;
+	CalcMemo memo(0);
+	double uncachedSeconds = EvaluateTapes(tapes, 0, uncachedLines, memo);
+	double cachedSeconds = EvaluateTapes(tapes, CalcMemo::DefaultCapacity, cachedLines, memo);
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < uncachedLines.size(); i++) { mismatches += uncachedLines[i] != cachedLines[i]; }
+
+	size_t equals = tapes.size();
+	printf("%zu streams, %zu results\n", streams, equals);
+	printf("%-12s %8.3fs evaluating (%.0f ns each)\n", "no cache", uncachedSeconds, uncachedSeconds * 1e9 / equals);
+	printf("%-12s %8.3fs evaluating (%.0f ns each)\n", "cache", cachedSeconds, cachedSeconds * 1e9 / equals);
+	printf("hits %zu (%.1f%%), misses %zu (%zu resumed from a prefix), %zu of %zu entries in use\n",
+		memo.Hits(), equals > 0 ? 100.0 * memo.Hits() / equals : 0.0, memo.Misses(), memo.PrefixHits(), memo.Size(), memo.GetCapacity());
+	printf("%zu mismatches\n", mismatches);
+
+	// The history formats its entries' results through a memo too, check drawing them is the same with and without it
+	CalcHistory history;
+	for (size_t i = 0; i < std::min(streams, (size_t)1000); i++)
+	{
+		script = bases[rng() % 8];
+		const char* rate = rates[rng() % 5];
+		for (int n = 1 + rng() % 40; n > 0; n--) { script += rate; script += '='; }
+		CommitScript(history, script);
+	}
+	const size_t frames = 10000;
+	std::vector<std::string> uncachedView, cachedView;
+	double uncachedFrames = FormatFrames(history, 0, frames, uncachedView);
+	double cachedFrames = FormatFrames(history, CalcMemo::DefaultCapacity, frames, cachedView);
+	const CalcMemo& resultMemo = history.GetResultMemo();
+	size_t viewMismatches = uncachedView != cachedView;
+	printf("history view %zu frames of %zu entries: %.1f us a frame without the cache, %.1f us with it (%.1f%% hits), %zu mismatches\n",
+		frames, uncachedView.size(), uncachedFrames * 1e6 / frames, cachedFrames * 1e6 / frames,
+		100.0 * resultMemo.Hits() / std::max((size_t)1, resultMemo.Hits() + resultMemo.Misses()), viewMismatches);
+
+	bool collisionOk = CheckCollision();
+	return mismatches == 0 && viewMismatches == 0 && collisionOk ? 0 : 1;
+}
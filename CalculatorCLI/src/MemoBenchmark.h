@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+// Evaluate the tapes of streams that keep extending a recurring rate chain (a base amount then "*1.05=" over and over) with and without the
+// result cache, checking both display the same results and reporting the cache's hits and misses
+int RunMemoBenchmark(size_t streams);
@@ -0,0 +1,172 @@
+#include "ParallelEvaluator.h"
+
+// Size of the reads making up each chunk, and how many chunks each worker can have in flight
+static const size_t ChunkSize = 1 << 20;
+static const size_t ChunksPerThread = 4;
+
+ParallelEvaluator::ParallelEvaluator(unsigned threadCount)
+	: threadCount(threadCount), queues(threadCount), chunks(threadCount * ChunksPerThread)
+{
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		threads.emplace_back(&ParallelEvaluator::WorkerLoop, this, i);
+	}
+}
+
+ParallelEvaluator::~ParallelEvaluator()
+{
+	{
+		std::lock_guard<std::mutex> lock(workMutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+uint64_t ParallelEvaluator::Run(FILE* file, OutputBuffer& out)
+{
+	carry.clear();
+	uint64_t nextRead = 0;
+	uint64_t nextWrite = 0;
+	uint64_t lines = 0;
+	bool endOfFile = false;
+
+	while (true)
+	{
+		// Keep the reorder window full while there's input left
+		if (!endOfFile && nextRead - nextWrite < chunks.size())
+		{
+			Chunk& chunk = chunks[nextRead % chunks.size()];
+			if (!ReadChunk(file, chunk)) { endOfFile = true; continue; }
+
+			chunk.index = nextRead++;
+			chunk.done = false;
+			Submit(&chunk);
+			continue;
+		}
+
+		// Everything has been written
+		if (nextWrite == nextRead) { break; }
+
+		// Otherwise write the oldest chunk as soon as it's done, which frees its slot for the next read
+		Chunk& chunk = chunks[nextWrite % chunks.size()];
+		{
+			std::unique_lock<std::mutex> lock(doneMutex);
+			chunkDone.wait(lock, [&chunk] { return chunk.done; });
+		}
+		out.Write(chunk.output.data(), chunk.output.size());
+		lines += chunk.lines;
+		nextWrite++;
+	}
+	return lines;
+}
+
+bool ParallelEvaluator::ReadChunk(FILE* file, Chunk& chunk)
+{
+	// Start with whatever was left over from the last chunk
+	chunk.input.assign(carry.begin(), carry.end());
+	carry.clear();
+
+	size_t start = chunk.input.size();
+	while (true)
+	{
+		chunk.input.resize(start + ChunkSize);
+		size_t n = fread(chunk.input.data() + start, 1, ChunkSize, file);
+		chunk.input.resize(start + n);
+
+		// End of file, anything left is the last line (which didn't end in a newline)
+		if (n == 0) { return chunk.input.size() > 0; }
+
+		// Cut the chunk after its last newline and carry the rest over to the next chunk
+		const char* data = chunk.input.data();
+		for (size_t i = start + n; i > start; i--)
+		{
+			if (data[i - 1] == '\n')
+			{
+				carry.assign(data + i, data + start + n);
+				chunk.input.resize(i);
+				return true;
+			}
+		}
+
+		// No newline yet, this line is longer than a read so keep going
+		start += n;
+	}
+}
+
+void ParallelEvaluator::Submit(Chunk* chunk)
+{
+	WorkQueue& queue = queues[chunk->index % threadCount];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.chunks.push_back(chunk);
+	}
+
+	// Count the chunk under workMutex so a worker can't check for work and go to sleep in between
+	{
+		std::lock_guard<std::mutex> lock(workMutex);
+		queuedChunks++;
+	}
+	workAvailable.notify_one();
+}
+
+ParallelEvaluator::Chunk* ParallelEvaluator::TakeWork(unsigned worker)
+{
+	// Oldest chunk from our own queue first, so results come back roughly in the order the writer needs them
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		WorkQueue& queue = queues[(worker + i) % threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.chunks.empty()) { continue; }
+
+		Chunk* chunk;
+		if (i == 0) { chunk = queue.chunks.front(); queue.chunks.pop_front(); }
+		// Steal from the back of anyone else's queue
+		else { chunk = queue.chunks.back(); queue.chunks.pop_back(); }
+
+		queuedChunks--;
+		return chunk;
+	}
+	return nullptr;
+}
+
+void ParallelEvaluator::WorkerLoop(unsigned worker)
+{
+	// Each worker has its own engine instance, nothing is shared while evaluating
+	CalcFold fold;
+
+	while (true)
+	{
+		Chunk* chunk = TakeWork(worker);
+		if (!chunk)
+		{
+			std::unique_lock<std::mutex> lock(workMutex);
+			workAvailable.wait(lock, [this] { return stopping || queuedChunks > 0; });
+			if (stopping && queuedChunks == 0) { return; }
+			continue;
+		}
+
+		fold.Reset();
+		bool lineHasInput = false;
+		chunk->output.clear();
+		StringOutput out{ chunk->output };
+		chunk->lines = EvaluateLines(chunk->input.data(), chunk->input.size(), fold, lineHasInput, out);
+
+		// Only the last chunk of a file can end part way through a line
+		if (lineHasInput)
+		{
+			EmitLine(fold, lineHasInput, out);
+			chunk->lines++;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(doneMutex);
+			chunk->done = true;
+		}
+		chunkDone.notify_one();
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "BatchEvaluator.h"
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+/// <summary>
+/// Evaluates a file across a pool of worker threads. The input is split into chunks on line boundaries and each chunk is
+/// queued on a worker; idle workers steal chunks from the back of other workers' queues. Every worker owns its own CalcFold,
+/// so nothing is shared while evaluating. Results are written in input order through a fixed size reorder window,
+/// which also bounds memory use to a constant number of chunks
+/// </summary>
+
+class ParallelEvaluator {
+
+public:
+	ParallelEvaluator(unsigned threadCount);
+	~ParallelEvaluator();
+
+	// Evaluate every line of a file, writing the results to out in order. Returns the number of lines evaluated
+	uint64_t Run(FILE* file, OutputBuffer& out);
+
+private:
+	// A block of complete lines and the results for them
+	struct Chunk
+	{
+		uint64_t index = 0;
+		std::vector<char> input;
+		std::string output;
+		uint64_t lines = 0;
+		bool done = false;
+	};
+
+	// A worker's own queue of chunks, other workers steal from the back
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Chunk*> chunks;
+	};
+
+	// Read the next chunk of complete lines from the file, returns false once the file has nothing left
+	bool ReadChunk(FILE* file, Chunk& chunk);
+
+	// Queue a chunk for evaluation on one of the workers
+	void Submit(Chunk* chunk);
+
+	// Take a chunk from our own queue, or steal one from another worker. Returns nullptr if every queue is empty
+	Chunk* TakeWork(unsigned worker);
+
+	// Main loop for each worker thread
+	void WorkerLoop(unsigned worker);
+
+	unsigned threadCount;
+	std::vector<std::thread> threads;
+	std::vector<WorkQueue> queues;
+
+	// Workers sleep on this when there is nothing to take or steal
+	std::mutex workMutex;
+	std::condition_variable workAvailable;
+	std::atomic<uint64_t> queuedChunks{ 0 };
+	bool stopping = false;
+
+	// The writer waits on this for the next chunk in order to finish
+	std::mutex doneMutex;
+	std::condition_variable chunkDone;
+
+	// Every chunk we'll ever use, so the memory for a run is fixed (also the size of the reorder window)
+	std::vector<Chunk> chunks;
+
+	// Part of a line left over at the end of the last chunk read, carried into the start of the next
+	std::vector<char> carry;
+};
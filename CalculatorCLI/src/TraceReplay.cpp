@@ -0,0 +1,108 @@
+#include "TraceReplay.h"
+#include "Common.h"
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+// How the inputs are shown in the report, digits are all counted together
+static const char* OperationNames[] = { "+", "-", "/", "*", "=", ".", "C", "DEL", "(", ")", "undo", "redo" };
+static const int OperationCount = sizeof(OperationNames) / sizeof(OperationNames[0]);
+
+// The latency below which a fraction of the (sorted) samples fall
+static double Percentile(const std::vector<double>& sorted, double fraction)
+{
+	if (sorted.empty()) { return 0.0; }
+	return sorted[std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()))];
+}
+
+static void PrintLatencies(const char* name, std::vector<double>& samples)
+{
+	if (samples.empty()) { return; }
+	std::sort(samples.begin(), samples.end());
+	printf("%-8s %10zu %10.0f %10.0f %10.0f %10.0f %12.0f\n", name, samples.size(),
+		Percentile(samples, 0.5), Percentile(samples, 0.9), Percentile(samples, 0.99), Percentile(samples, 0.999), samples.back());
+}
+
+int RunTraceReplay(const char* path)
+{
+	CalcTraceReader trace;
+	if (!trace.Open(path))
+	{
+		fprintf(stderr, "couldn't read a trace from %s\n", path);
+		return 1;
+	}
+	const std::vector<CalcTraceEntry>& entries = trace.Entries();
+
+	// Start where the UI does before it starts recording
+	CalcIOStreamObj stream;
+	const char* line = "";
+	const char* preview = "";
+	stream.onValUpdated = [&](std::tuple<const char*, const char*, const CalcHistory&> t) { line = std::get<0>(t); preview = std::get<1>(t); };
+	stream.AddNum(0.0f);
+
+	// What reading the clock twice costs, taken off every latency
+	double overhead = 1e9;
+	for (int i = 0; i < 10000; i++)
+	{
+		auto a = std::chrono::steady_clock::now();
+		auto b = std::chrono::steady_clock::now();
+		overhead = std::min(overhead, std::chrono::duration<double, std::nano>(b - a).count());
+	}
+
+	std::vector<double> all, digits, operations[OperationCount];
+	all.reserve(entries.size());
+	size_t mismatches = 0, invalid = 0, firstMismatch = entries.size();
+	std::string firstMismatchLine;
+	auto replayStart = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const CalcTraceEntry& entry = entries[i];
+		bool digit = entry.kind == TraceEvent::Num && entry.value <= 9;
+		if (!digit && (entry.kind != TraceEvent::Operation || entry.value >= OperationCount)) { invalid++; continue; }
+
+		auto start = std::chrono::steady_clock::now();
+		if (digit) { stream.AddNum((float)entry.value); }
+		else { ApplyOperation(stream, (Operation)entry.value); }
+		double ns = std::max(0.0, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() - overhead);
+
+		all.push_back(ns);
+		(digit ? digits : operations[entry.value]).push_back(ns);
+
+		if (Crc32((const uint8_t*)line, strlen(line)) != entry.lineCrc)
+		{
+			if (mismatches++ == 0) { firstMismatch = i; firstMismatchLine = line; }
+		}
+	}
+	double replaySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+
+	double recordedSeconds = entries.empty() ? 0.0 : entries.back().time / 1e9;
+	printf("%zu inputs over %.1fs of recorded input%s\n", entries.size(), recordedSeconds,
+		trace.HasEnd() ? "" : trace.Truncated() ? " (not closed, the last input was cut short)" : " (not closed)");
+	printf("replayed in %.3fs, %.0f inputs/s\n\n", replaySeconds, replaySeconds > 0.0 ? all.size() / replaySeconds : 0.0);
+
+	printf("%-8s %10s %10s %10s %10s %10s %12s   (ns)\n", "input", "count", "p50", "p90", "p99", "p99.9", "max");
+	PrintLatencies("all", all);
+	PrintLatencies("digit", digits);
+	for (int o = 0; o < OperationCount; o++) { PrintLatencies(OperationNames[o], operations[o]); }
+
+	// Every line should be exactly what the UI showed, and so should the final line and preview if the trace has them
+	printf("\n%zu of %zu lines matched the recording", all.size() - mismatches, all.size());
+	if (invalid > 0) { printf(", %zu unknown inputs skipped", invalid); }
+	printf("\n");
+	if (mismatches > 0)
+	{
+		printf("first difference after input %zu, replay shows:\n%s\n", firstMismatch, firstMismatchLine.c_str());
+	}
+	bool finalMatches = true;
+	if (trace.HasEnd())
+	{
+		finalMatches = trace.FinalLine() == line && trace.FinalPreview() == preview;
+		printf("final line and preview %s\n", finalMatches ? "match" : "differ");
+		if (!finalMatches)
+		{
+			printf("recorded: %s [%s]\nreplayed: %s [%s]\n", trace.FinalLine().c_str(), trace.FinalPreview().c_str(), line, preview);
+		}
+	}
+	else { printf("no final line recorded to check\n"); }
+	return mismatches == 0 && invalid == 0 && finalMatches ? 0 : 1;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Replay a trace recorded by the calculator UI (--record-trace) into a new calculation stream as fast as it'll go, reporting
+// latency percentiles for each input and checking the line after every input, and the final line and preview, match the recording
+int RunTraceReplay(const char* path);
@@ -34,6 +34,9 @@ project "Walnut"
       systemversion "latest"
       defines { "WL_PLATFORM_WINDOWS" }
 
+   filter "system:linux"
+      defines { "WL_PLATFORM_LINUX" }
+
    filter "configurations:Debug"
       defines { "WL_DEBUG" }
       runtime "Debug"
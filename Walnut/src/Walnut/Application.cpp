@@ -1,4 +1,6 @@
 #include "Application.h"
+#include "Profiler.h"
+#include "SamplerCache.h"
 
 //
 // Adapted from Dear ImGui Vulkan example
@@ -6,6 +8,7 @@
 
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_vulkan.h"
+#include "imgui_internal.h"
 #include <stdio.h>          // printf, fprintf
 #include <stdlib.h>         // abort
 #define GLFW_INCLUDE_NONE
@@ -15,6 +18,8 @@
 #include <glm/glm.hpp>
 
 #include <iostream>
+#include <chrono>
+#include <thread>
 
 // Emedded font
 #include "ImGui/Roboto-Regular.embed"
@@ -47,14 +52,65 @@ static ImGui_ImplVulkanH_Window g_MainWindowData;
 static int                      g_MinImageCount = 2;
 static bool                     g_SwapChainRebuild = false;
 
+// Command buffers Application::GetCommandBuffer has allocated from a swapchain image's command pool. Resetting the pool at the
+// start of the image's next frame resets them all, and they're handed out again in order rather than freed and allocated again
+struct RecycledCommandBuffers
+{
+	std::vector<VkCommandBuffer> CommandBuffers;
+	uint32_t Used = 0;
+};
+
 // Per-frame-in-flight
-static std::vector<std::vector<VkCommandBuffer>> s_AllocatedCommandBuffers;
-static std::vector<std::vector<std::function<void()>>> s_ResourceFreeQueue;
+static std::vector<RecycledCommandBuffers> s_AllocatedCommandBuffers;
+static std::vector<std::vector<Walnut::DeferredFree>> s_ResourceFreeQueue;
+
+// What Application::SubmitResourceFree has been given, from any thread, until the main thread collects it into this frame's queue
+static Walnut::DeferredFreeQueue s_ResourceFreeSubmissions;
+static std::thread::id s_MainThreadId;
+
+// Waited on by Application::FlushCommandBuffer, made the first time it's needed
+static VkFence g_FlushFence = VK_NULL_HANDLE;
+
+// Every vkQueueSubmit Walnut makes (ImGui's own for platform windows aside), see Application::GetQueueSubmitCount
+static uint64_t s_QueueSubmitCount = 0;
 
 // Unlike g_MainWindowData.FrameIndex, this is not the the swapchain image index
 // and is always guaranteed to increase (eg. 0, 1, 2, 0, 1, 2)
 static uint32_t s_CurrentFrameIndex = 0;
 
+// What Application::GetTime() counts from when there's no GLFW to ask
+static std::chrono::steady_clock::time_point s_HeadlessStart;
+
+// Timestamps written around the main render pass while frames are being timed, two queries per swapchain image.
+// g_TimestampPeriod is nanoseconds per tick, 0 if the graphics queue can't write timestamps
+static VkQueryPool g_TimestampQueryPool = VK_NULL_HANDLE;
+static uint32_t g_TimestampQueryImages = 0;
+static float g_TimestampPeriod = 0.0f;
+static uint64_t g_TimestampMask = 0;
+static std::vector<bool> s_TimestampsWritten;
+static bool g_GpuTimingEnabled = false;
+static float g_GpuTime = -1.0f;
+
+// Uploads (Application::BeginUpload) recorded during a frame are submitted together just before it's rendered, in a submission of
+// their own with its own pool, command buffer and fence. Their staging space in s_StagingRing is given back once the fence signals,
+// along with any buffers made for uploads too big for the ring
+struct UploadSubmission
+{
+	VkCommandPool CommandPool = VK_NULL_HANDLE;
+	VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+	VkFence Fence = VK_NULL_HANDLE;
+	bool Recording = false;
+	bool InFlight = false;
+
+	uint64_t StagingEnd = 0;
+	std::vector<Walnut::StagingRing> OversizeStaging;
+};
+
+static Walnut::StagingRing s_StagingRing;
+static VkDeviceSize g_StagingAlignment = 16;
+static UploadSubmission s_UploadSubmissions[4];
+static uint32_t s_UploadIndex = 0;
+
 static Walnut::Application* s_Instance = nullptr;
 
 void check_vk_result(VkResult err)
@@ -165,8 +221,18 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 				g_QueueFamily = i;
 				break;
 			}
-		free(queues);
 		IM_ASSERT(g_QueueFamily != (uint32_t)-1);
+
+		// Whether the render pass can be timed on the GPU (see Application::GetFrameTimings)
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+		uint32_t timestampBits = queues[g_QueueFamily].timestampValidBits;
+		if (timestampBits > 0 && properties.limits.timestampPeriod > 0.0f)
+		{
+			g_TimestampPeriod = properties.limits.timestampPeriod;
+			g_TimestampMask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+		}
+		free(queues);
 	}
 
 	// Create Logical Device (with 1 queue)
@@ -270,6 +336,228 @@ static void CleanupVulkanWindow()
 	ImGui_ImplVulkanH_DestroyWindow(g_Instance, g_Device, &g_MainWindowData, g_Allocator);
 }
 
+static void DestroyGpuTimer()
+{
+	if (g_TimestampQueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(g_Device, g_TimestampQueryPool, g_Allocator);
+	g_TimestampQueryPool = VK_NULL_HANDLE;
+	g_TimestampQueryImages = 0;
+	s_TimestampsWritten.clear();
+}
+
+// Read the GPU time of the last frame rendered to a swapchain image, once its fence says the GPU is done with it
+static void ReadGpuTime(uint32_t imageIndex)
+{
+	if (imageIndex >= s_TimestampsWritten.size() || !s_TimestampsWritten[imageIndex])
+		return;
+
+	uint64_t timestamps[2];
+	VkResult err = vkGetQueryPoolResults(g_Device, g_TimestampQueryPool, imageIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (err == VK_SUCCESS)
+		g_GpuTime = (float)(((timestamps[1] - timestamps[0]) & g_TimestampMask) * g_TimestampPeriod / 1000000.0);
+	s_TimestampsWritten[imageIndex] = false;
+}
+
+// Write a timestamp before the render pass when its frame is being timed (making the query pool for it the first time)
+static void BeginGpuTimer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t imageCount)
+{
+	if (!g_GpuTimingEnabled || g_TimestampPeriod == 0.0f)
+		return;
+
+	if (g_TimestampQueryImages != imageCount)
+	{
+		DestroyGpuTimer();
+		VkQueryPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = imageCount * 2;
+		VkResult err = vkCreateQueryPool(g_Device, &info, g_Allocator, &g_TimestampQueryPool);
+		check_vk_result(err);
+		g_TimestampQueryImages = imageCount;
+		s_TimestampsWritten.assign(imageCount, false);
+	}
+
+	vkCmdResetQueryPool(commandBuffer, g_TimestampQueryPool, imageIndex * 2, 2);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, g_TimestampQueryPool, imageIndex * 2);
+}
+
+static void EndGpuTimer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (!g_GpuTimingEnabled || g_TimestampQueryPool == VK_NULL_HANDLE)
+		return;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, g_TimestampQueryPool, imageIndex * 2 + 1);
+	s_TimestampsWritten[imageIndex] = true;
+}
+
+static void CreateUploadSubmissions(VkDeviceSize stagingRingSize)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+	g_StagingAlignment = glm::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+	s_StagingRing.Init(g_PhysicalDevice, g_Device, g_Allocator, stagingRingSize);
+
+	for (UploadSubmission& submission : s_UploadSubmissions)
+	{
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = g_QueueFamily;
+		VkResult err = vkCreateCommandPool(g_Device, &poolInfo, g_Allocator, &submission.CommandPool);
+		check_vk_result(err);
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = submission.CommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		err = vkAllocateCommandBuffers(g_Device, &allocInfo, &submission.CommandBuffer);
+		check_vk_result(err);
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		err = vkCreateFence(g_Device, &fenceInfo, g_Allocator, &submission.Fence);
+		check_vk_result(err);
+	}
+}
+
+// Once the device is idle
+static void DestroyUploadSubmissions()
+{
+	for (UploadSubmission& submission : s_UploadSubmissions)
+	{
+		for (Walnut::StagingRing& oversize : submission.OversizeStaging)
+			oversize.Shutdown();
+		vkDestroyFence(g_Device, submission.Fence, g_Allocator);
+		vkDestroyCommandPool(g_Device, submission.CommandPool, g_Allocator);
+		submission = UploadSubmission();
+	}
+	s_StagingRing.Shutdown();
+}
+
+// Give back what a submission's uploads were using if the GPU's done with them (or once it is, if told to wait)
+static bool CompleteUploadSubmission(UploadSubmission& submission, bool wait)
+{
+	if (!submission.InFlight)
+		return false;
+
+	VkResult err = wait ? vkWaitForFences(g_Device, 1, &submission.Fence, VK_TRUE, UINT64_MAX) : vkGetFenceStatus(g_Device, submission.Fence);
+	if (err == VK_NOT_READY)
+		return false;
+	check_vk_result(err);
+	err = vkResetFences(g_Device, 1, &submission.Fence);
+	check_vk_result(err);
+
+	s_StagingRing.Release(submission.StagingEnd);
+	for (Walnut::StagingRing& oversize : submission.OversizeStaging)
+		oversize.Shutdown();
+	submission.OversizeStaging.clear();
+	submission.InFlight = false;
+	return true;
+}
+
+// Complete every submission the GPU has finished, oldest first, or wait for the oldest one in flight if it hasn't finished any.
+// Returns false if there are none in flight
+static bool CompleteUploadSubmissions(bool waitForOldest)
+{
+	bool completed = false;
+	UploadSubmission* oldest = nullptr;
+	for (uint32_t i = 0; i < IM_ARRAYSIZE(s_UploadSubmissions); i++)
+	{
+		UploadSubmission& submission = s_UploadSubmissions[(s_UploadIndex + i) % IM_ARRAYSIZE(s_UploadSubmissions)];
+		if (!oldest && submission.InFlight)
+			oldest = &submission;
+		completed |= CompleteUploadSubmission(submission, false);
+	}
+
+	if (!completed && waitForOldest && oldest)
+		completed = CompleteUploadSubmission(*oldest, true);
+	return completed;
+}
+
+// The submission uploads are being recorded into this frame, starting to record it if nothing has yet
+static UploadSubmission& BeginUploadSubmission()
+{
+	UploadSubmission& submission = s_UploadSubmissions[s_UploadIndex];
+	if (submission.Recording)
+		return submission;
+
+	// This was submitted a few frames ago, so it's normally long since done
+	CompleteUploadSubmission(submission, true);
+
+	VkResult err = vkResetCommandPool(g_Device, submission.CommandPool, 0);
+	check_vk_result(err);
+	VkCommandBufferBeginInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	err = vkBeginCommandBuffer(submission.CommandBuffer, &info);
+	check_vk_result(err);
+
+	submission.Recording = true;
+	return submission;
+}
+
+// Submit this frame's uploads, if there are any, ahead of the frame's rendering. Submission order alone doesn't make the rendering
+// wait for them, so whatever records into these command buffers also records its own barrier to the stage that uses the result
+// (Image::SetData has a TRANSFER -> FRAGMENT_SHADER barrier after its copy)
+static void SubmitUploads()
+{
+	CompleteUploadSubmissions(false);
+
+	UploadSubmission& submission = s_UploadSubmissions[s_UploadIndex];
+	if (!submission.Recording)
+		return;
+
+	WL_PROFILE_FUNCTION();
+
+	s_StagingRing.Flush();
+	for (Walnut::StagingRing& oversize : submission.OversizeStaging)
+		oversize.Flush();
+
+	VkResult err = vkEndCommandBuffer(submission.CommandBuffer);
+	check_vk_result(err);
+	VkSubmitInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	info.commandBufferCount = 1;
+	info.pCommandBuffers = &submission.CommandBuffer;
+	err = vkQueueSubmit(g_Queue, 1, &info, submission.Fence);
+	check_vk_result(err);
+	s_QueueSubmitCount++;
+
+	submission.StagingEnd = s_StagingRing.GetHead();
+	submission.Recording = false;
+	submission.InFlight = true;
+	s_UploadIndex = (s_UploadIndex + 1) % IM_ARRAYSIZE(s_UploadSubmissions);
+}
+
+static void FreeResources(std::vector<Walnut::DeferredFree>& resources)
+{
+	for (Walnut::DeferredFree& resource : resources)
+	{
+		switch (resource.Type)
+		{
+			case Walnut::DeferredFreeType::Callback:     resource.Callback(resource.Data); break;
+			case Walnut::DeferredFreeType::Buffer:       vkDestroyBuffer(g_Device, (VkBuffer)resource.Handle, g_Allocator); break;
+			case Walnut::DeferredFreeType::Image:        vkDestroyImage(g_Device, (VkImage)resource.Handle, g_Allocator); break;
+			case Walnut::DeferredFreeType::ImageView:    vkDestroyImageView(g_Device, (VkImageView)resource.Handle, g_Allocator); break;
+			case Walnut::DeferredFreeType::Sampler:      vkDestroySampler(g_Device, (VkSampler)resource.Handle, g_Allocator); break;
+			case Walnut::DeferredFreeType::DeviceMemory: vkFreeMemory(g_Device, (VkDeviceMemory)resource.Handle, g_Allocator); break;
+			case Walnut::DeferredFreeType::CommandPool:  vkDestroyCommandPool(g_Device, (VkCommandPool)resource.Handle, g_Allocator); break;
+			case Walnut::DeferredFreeType::Fence:        vkDestroyFence(g_Device, (VkFence)resource.Handle, g_Allocator); break;
+		}
+	}
+	resources.clear();
+}
+
+// Everything submitted since the last time is freed with this frame's resources. Main thread only
+static void CollectResourceFrees()
+{
+	std::vector<Walnut::DeferredFree>& resources = s_ResourceFreeQueue[s_CurrentFrameIndex];
+	Walnut::DeferredFree resource;
+	while (s_ResourceFreeSubmissions.TryPop(resource))
+		resources.push_back(resource);
+}
+
 static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 {
 	VkResult err;
@@ -293,23 +581,17 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 
 		err = vkResetFences(g_Device, 1, &fd->Fence);
 		check_vk_result(err);
+
+		ReadGpuTime(wd->FrameIndex);
 	}
 	
+	// Free resources in queue
+	FreeResources(s_ResourceFreeQueue[s_CurrentFrameIndex]);
+
 	{
-		// Free resources in queue
-		for (auto& func : s_ResourceFreeQueue[s_CurrentFrameIndex])
-			func();
-		s_ResourceFreeQueue[s_CurrentFrameIndex].clear();
-	}
-	{
-		// Free command buffers allocated by Application::GetCommandBuffer
+		// Command buffers allocated by Application::GetCommandBuffer are reset along with the pool, ready to be used again
 		// These use g_MainWindowData.FrameIndex and not s_CurrentFrameIndex because they're tied to the swapchain image index
-		auto& allocatedCommandBuffers = s_AllocatedCommandBuffers[wd->FrameIndex];
-		if (allocatedCommandBuffers.size() > 0)
-		{
-			vkFreeCommandBuffers(g_Device, fd->CommandPool, (uint32_t)allocatedCommandBuffers.size(), allocatedCommandBuffers.data());
-			allocatedCommandBuffers.clear();
-		}
+		s_AllocatedCommandBuffers[wd->FrameIndex].Used = 0;
 
 		err = vkResetCommandPool(g_Device, fd->CommandPool, 0);
 		check_vk_result(err);
@@ -318,6 +600,8 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 		info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 		err = vkBeginCommandBuffer(fd->CommandBuffer, &info);
 		check_vk_result(err);
+
+		BeginGpuTimer(fd->CommandBuffer, wd->FrameIndex, wd->ImageCount);
 	}
 	{
 		VkRenderPassBeginInfo info = {};
@@ -336,6 +620,7 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 
 	// Submit command buffer
 	vkCmdEndRenderPass(fd->CommandBuffer);
+	EndGpuTimer(fd->CommandBuffer, wd->FrameIndex);
 	{
 		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		VkSubmitInfo info = {};
@@ -352,6 +637,7 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 		check_vk_result(err);
 		err = vkQueueSubmit(g_Queue, 1, &info, fd->Fence);
 		check_vk_result(err);
+		s_QueueSubmitCount++;
 	}
 }
 
@@ -382,6 +668,27 @@ static void glfw_error_callback(int error, const char* description)
 	fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
+// Times a stage of Run() into one of the frame's timings, or does nothing if it's given nowhere to put it
+class FrameStageTimer
+{
+public:
+	FrameStageTimer(float* stage)
+		: m_Stage(stage)
+	{
+		if (m_Stage)
+			m_Start = std::chrono::steady_clock::now();
+	}
+
+	~FrameStageTimer()
+	{
+		if (m_Stage)
+			*m_Stage = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+	}
+private:
+	float* m_Stage;
+	std::chrono::steady_clock::time_point m_Start;
+};
+
 namespace Walnut {
 
 	Application::Application(const ApplicationSpecification& specification)
@@ -406,6 +713,19 @@ namespace Walnut {
 
 	void Application::Init()
 	{
+#if !defined(WL_DIST)
+		if (!m_Specification.ProfileFilepath.empty() && !WL_PROFILE_BEGIN_SESSION(m_Specification.ProfileFilepath))
+			std::cerr << "Could not open profile " << m_Specification.ProfileFilepath << "!\n";
+#endif
+		WL_PROFILE_THREAD("Main");
+		WL_PROFILE_FUNCTION();
+
+		if (m_Specification.Headless)
+		{
+			InitHeadless();
+			return;
+		}
+
 		// Setup GLFW window
 		glfwSetErrorCallback(glfw_error_callback);
 		if (!glfwInit())
@@ -440,6 +760,11 @@ namespace Walnut {
 
 		s_AllocatedCommandBuffers.resize(wd->ImageCount);
 		s_ResourceFreeQueue.resize(wd->ImageCount);
+		for (auto& resources : s_ResourceFreeQueue)
+			resources.reserve(1024);
+		s_ResourceFreeSubmissions.Init(4096);
+		s_MainThreadId = std::this_thread::get_id();
+		CreateUploadSubmissions(m_Specification.StagingRingSize);
 
 		// Setup Dear ImGui context
 		IMGUI_CHECKVERSION();
@@ -512,6 +837,7 @@ namespace Walnut {
 			check_vk_result(err);
 			err = vkQueueSubmit(g_Queue, 1, &end_info, VK_NULL_HANDLE);
 			check_vk_result(err);
+			s_QueueSubmitCount++;
 
 			err = vkDeviceWaitIdle(g_Device);
 			check_vk_result(err);
@@ -519,6 +845,33 @@ namespace Walnut {
 		}
 	}
 
+	void Application::InitHeadless()
+	{
+		s_HeadlessStart = std::chrono::steady_clock::now();
+
+		// The same context as with a window, less the platform windows. The layout is read from imgui.ini like it is with a
+		// window (so layers are docked the same way), but never written back
+		IMGUI_CHECKVERSION();
+		ImGui::CreateContext();
+		ImGuiIO& io = ImGui::GetIO();
+		io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+		io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+		ImGui::LoadIniSettingsFromDisk(io.IniFilename);
+		io.IniFilename = nullptr;
+		io.BackendPlatformName = "walnut_headless";
+		io.DisplaySize = ImVec2((float)m_Specification.Width, (float)m_Specification.Height);
+		ImGui::StyleColorsDark();
+
+		ImFontConfig fontConfig;
+		fontConfig.FontDataOwnedByAtlas = false;
+		io.FontDefault = io.Fonts->AddFontFromMemoryTTF((void*)g_RobotoRegular, sizeof(g_RobotoRegular), 20.0f, &fontConfig);
+
+		// The atlas still has to be built for text to be laid out, it's just never uploaded
+		unsigned char* pixels;
+		int width, height;
+		io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+	}
+
 	void Application::Shutdown()
 	{
 		for (auto& layer : m_LayerStack)
@@ -526,33 +879,56 @@ namespace Walnut {
 
 		m_LayerStack.clear();
 
+		if (m_Specification.Headless)
+		{
+			ImGui::DestroyContext();
+			WL_PROFILE_END_SESSION();
+			g_ApplicationRunning = false;
+			return;
+		}
+
 		// Cleanup
 		VkResult err = vkDeviceWaitIdle(g_Device);
 		check_vk_result(err);
 
 		// Free resources in queue
-		for (auto& queue : s_ResourceFreeQueue)
-		{
-			for (auto& func : queue)
-				func();
-		}
+		CollectResourceFrees();
+		for (auto& resources : s_ResourceFreeQueue)
+			FreeResources(resources);
 		s_ResourceFreeQueue.clear();
 
+		if (g_FlushFence != VK_NULL_HANDLE)
+			vkDestroyFence(g_Device, g_FlushFence, g_Allocator);
+		g_FlushFence = VK_NULL_HANDLE;
+
+		// Uploads still being recorded are dropped along with their command pool, there's nothing left to draw them
+		DestroyUploadSubmissions();
+		SamplerCache::Shutdown();
+
 		ImGui_ImplVulkan_Shutdown();
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
 
+		DestroyGpuTimer();
 		CleanupVulkanWindow();
 		CleanupVulkan();
 
 		glfwDestroyWindow(m_WindowHandle);
 		glfwTerminate();
 
+		WL_PROFILE_END_SESSION();
+
 		g_ApplicationRunning = false;
 	}
 
 	void Application::Run()
 	{
+		if (m_Specification.Headless)
+		{
+			RunHeadless();
+			return;
+		}
+
 		m_Running = true;
 
 		ImGui_ImplVulkanH_Window* wd = &g_MainWindowData;
@@ -567,10 +943,44 @@ namespace Walnut {
 			// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
 			// - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
 			// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-			glfwPollEvents();
+			// When rendering on demand, sleep until there's something to render
+			float waitTime = 0.0f;
+			if (m_Specification.RenderOnDemand && m_SettleFramesLeft == 0 && !m_RedrawRequested.load())
+			{
+				WL_PROFILE_SCOPE("WaitEvents");
+				float waitStart = GetTime();
+				glfwWaitEventsTimeout(m_Specification.MaxIdleTime);
+				waitTime = GetTime() - waitStart;
+			}
+			else
+			{
+				WL_PROFILE_SCOPE("PollEvents");
+				glfwPollEvents();
+			}
 
-			for (auto& layer : m_LayerStack)
-				layer->OnUpdate(m_TimeStep);
+			// Input for ImGui (in any of its windows) or a redraw request starts the settle frames over,
+			// otherwise this is one of them, or the one frame rendered each time the loop wakes up
+			if (m_Specification.RenderOnDemand)
+			{
+				if (m_RedrawRequested.exchange(false) || GImGui->InputEventsQueue.Size > 0)
+					m_SettleFramesLeft = m_Specification.SettleFrames;
+				else if (m_SettleFramesLeft > 0)
+					m_SettleFramesLeft--;
+			}
+
+			// Whether to time this frame's stages, the timings are only handed out once the whole frame has been timed
+			const bool timeFrame = m_FrameTimingsEnabled;
+			FrameTimings timings;
+			if (timeFrame && !g_GpuTimingEnabled)
+				g_GpuTime = -1.0f;
+			g_GpuTimingEnabled = timeFrame;
+
+			{
+				WL_PROFILE_SCOPE("OnUpdate");
+				FrameStageTimer stageTimer(timeFrame ? &timings.OnUpdate : nullptr);
+				for (auto& layer : m_LayerStack)
+					layer->OnUpdate(m_TimeStep);
+			}
 
 			// Resize swap chain?
 			if (g_SwapChainRebuild)
@@ -583,7 +993,7 @@ namespace Walnut {
 					ImGui_ImplVulkanH_CreateOrResizeWindow(g_Instance, g_PhysicalDevice, g_Device, &g_MainWindowData, g_QueueFamily, g_Allocator, width, height, g_MinImageCount);
 					g_MainWindowData.FrameIndex = 0;
 
-					// Clear allocated command buffers from here since entire pool is destroyed
+					// Forget the allocated command buffers since the entire pool they came from is destroyed
 					s_AllocatedCommandBuffers.clear();
 					s_AllocatedCommandBuffers.resize(g_MainWindowData.ImageCount);
 
@@ -596,92 +1006,189 @@ namespace Walnut {
 			ImGui_ImplGlfw_NewFrame();
 			ImGui::NewFrame();
 
-			{
-				static ImGuiDockNodeFlags dockspace_flags = ImGuiDockNodeFlags_None;
-
-				// We are using the ImGuiWindowFlags_NoDocking flag to make the parent window not dockable into,
-				// because it would be confusing to have two docking targets within each others.
-				ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDocking;
-				if (m_MenubarCallback)
-					window_flags |= ImGuiWindowFlags_MenuBar;
-
-				const ImGuiViewport* viewport = ImGui::GetMainViewport();
-				ImGui::SetNextWindowPos(viewport->WorkPos);
-				ImGui::SetNextWindowSize(viewport->WorkSize);
-				ImGui::SetNextWindowViewport(viewport->ID);
-				ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
-				ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
-				window_flags |= ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove;
-				window_flags |= ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoNavFocus;
-
-				// When using ImGuiDockNodeFlags_PassthruCentralNode, DockSpace() will render our background
-				// and handle the pass-thru hole, so we ask Begin() to not render a background.
-				if (dockspace_flags & ImGuiDockNodeFlags_PassthruCentralNode)
-					window_flags |= ImGuiWindowFlags_NoBackground;
-
-				// Important: note that we proceed even if Begin() returns false (aka window is collapsed).
-				// This is because we want to keep our DockSpace() active. If a DockSpace() is inactive,
-				// all active windows docked into it will lose their parent and become undocked.
-				// We cannot preserve the docking relationship between an active window and an inactive docking, otherwise
-				// any change of dockspace/settings would lead to windows being stuck in limbo and never being visible.
-				ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
-				ImGui::Begin("DockSpace Demo", nullptr, window_flags);
-				ImGui::PopStyleVar();
-
-				ImGui::PopStyleVar(2);
-
-				// Submit the DockSpace
-				ImGuiIO& io = ImGui::GetIO();
-				if (io.ConfigFlags & ImGuiConfigFlags_DockingEnable)
-				{
-					ImGuiID dockspace_id = ImGui::GetID("VulkanAppDockspace");
-					ImGui::DockSpace(dockspace_id, ImVec2(0.0f, 0.0f), dockspace_flags);
-				}
-
-				if (m_MenubarCallback)
-				{
-					if (ImGui::BeginMenuBar())
-					{
-						m_MenubarCallback();
-						ImGui::EndMenuBar();
-					}
-				}
-
-				for (auto& layer : m_LayerStack)
-					layer->OnUIRender();
-
-				ImGui::End();
-			}
+			RenderDockspace(timeFrame ? &timings.OnUIRender : nullptr);
 
 			// Rendering
-			ImGui::Render();
+			{
+				WL_PROFILE_SCOPE("ImGui::Render");
+				FrameStageTimer stageTimer(timeFrame ? &timings.ImGuiRender : nullptr);
+				ImGui::Render();
+			}
 			ImDrawData* main_draw_data = ImGui::GetDrawData();
 			const bool main_is_minimized = (main_draw_data->DisplaySize.x <= 0.0f || main_draw_data->DisplaySize.y <= 0.0f);
 			wd->ClearValue.color.float32[0] = clear_color.x * clear_color.w;
 			wd->ClearValue.color.float32[1] = clear_color.y * clear_color.w;
 			wd->ClearValue.color.float32[2] = clear_color.z * clear_color.w;
 			wd->ClearValue.color.float32[3] = clear_color.w;
+
+			// Even when minimized, so their staging space comes back
+			SubmitUploads();
+			CollectResourceFrees();
+
 			if (!main_is_minimized)
+			{
+				WL_PROFILE_SCOPE("FrameRender");
+				FrameStageTimer stageTimer(timeFrame ? &timings.FrameRender : nullptr);
 				FrameRender(wd, main_draw_data);
+			}
 
 			// Update and Render additional Platform Windows
 			if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
 			{
+				WL_PROFILE_SCOPE("RenderPlatformWindows");
 				ImGui::UpdatePlatformWindows();
 				ImGui::RenderPlatformWindowsDefault();
 			}
 
 			// Present Main Platform Window
 			if (!main_is_minimized)
+			{
+				WL_PROFILE_SCOPE("FramePresent");
+				FrameStageTimer stageTimer(timeFrame ? &timings.FramePresent : nullptr);
 				FramePresent(wd);
+			}
 
 			float time = GetTime();
 			m_FrameTime = time - m_LastFrameTime;
 			m_TimeStep = glm::min<float>(m_FrameTime, 0.0333f);
 			m_LastFrameTime = time;
 
+			if (timeFrame)
+			{
+				timings.FrameTime = (m_FrameTime - waitTime) * 1000.0f;
+				timings.GpuTime = g_TimestampPeriod > 0.0f ? g_GpuTime : -1.0f;
+				m_FrameTimings = timings;
+			}
+
+			WL_PROFILE_FRAME();
+		}
+
+	}
+
+	// The window everything docks into filling the main viewport, with the menubar and every layer's UI in it
+	void Application::RenderDockspace(float* uiRenderTime)
+	{
+		static ImGuiDockNodeFlags dockspace_flags = ImGuiDockNodeFlags_None;
+
+		// We are using the ImGuiWindowFlags_NoDocking flag to make the parent window not dockable into,
+		// because it would be confusing to have two docking targets within each others.
+		ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDocking;
+		if (m_MenubarCallback)
+			window_flags |= ImGuiWindowFlags_MenuBar;
+
+		const ImGuiViewport* viewport = ImGui::GetMainViewport();
+		ImGui::SetNextWindowPos(viewport->WorkPos);
+		ImGui::SetNextWindowSize(viewport->WorkSize);
+		ImGui::SetNextWindowViewport(viewport->ID);
+		ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
+		ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
+		window_flags |= ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove;
+		window_flags |= ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoNavFocus;
+
+		// When using ImGuiDockNodeFlags_PassthruCentralNode, DockSpace() will render our background
+		// and handle the pass-thru hole, so we ask Begin() to not render a background.
+		if (dockspace_flags & ImGuiDockNodeFlags_PassthruCentralNode)
+			window_flags |= ImGuiWindowFlags_NoBackground;
+
+		// Important: note that we proceed even if Begin() returns false (aka window is collapsed).
+		// This is because we want to keep our DockSpace() active. If a DockSpace() is inactive,
+		// all active windows docked into it will lose their parent and become undocked.
+		// We cannot preserve the docking relationship between an active window and an inactive docking, otherwise
+		// any change of dockspace/settings would lead to windows being stuck in limbo and never being visible.
+		ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
+		ImGui::Begin("DockSpace Demo", nullptr, window_flags);
+		ImGui::PopStyleVar();
+
+		ImGui::PopStyleVar(2);
+
+		// Submit the DockSpace
+		ImGuiIO& io = ImGui::GetIO();
+		if (io.ConfigFlags & ImGuiConfigFlags_DockingEnable)
+		{
+			ImGuiID dockspace_id = ImGui::GetID("VulkanAppDockspace");
+			ImGui::DockSpace(dockspace_id, ImVec2(0.0f, 0.0f), dockspace_flags);
+		}
+
+		if (m_MenubarCallback)
+		{
+			if (ImGui::BeginMenuBar())
+			{
+				m_MenubarCallback();
+				ImGui::EndMenuBar();
+			}
+		}
+
+		{
+			WL_PROFILE_SCOPE("OnUIRender");
+			FrameStageTimer stageTimer(uiRenderTime);
+			for (auto& layer : m_LayerStack)
+				layer->OnUIRender();
 		}
 
+		ImGui::End();
+	}
+
+	void Application::RunHeadless()
+	{
+		m_Running = true;
+
+		ImGuiIO& io = ImGui::GetIO();
+		const bool fixedTick = m_Specification.HeadlessTickRate > 0.0f;
+		const auto tickLength = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(fixedTick ? 1.0 / m_Specification.HeadlessTickRate : 0.0));
+		auto nextTick = std::chrono::steady_clock::now();
+		const float runStart = GetTime();
+		m_LastFrameTime = runStart;
+
+		uint64_t frames = 0;
+		while (m_Running && (m_Specification.HeadlessFrameCount == 0 || frames < m_Specification.HeadlessFrameCount))
+		{
+			if (fixedTick)
+			{
+				std::this_thread::sleep_until(nextTick);
+				nextTick += tickLength;
+			}
+
+			const bool timeFrame = m_FrameTimingsEnabled;
+			FrameTimings timings;
+
+			{
+				WL_PROFILE_SCOPE("OnUpdate");
+				FrameStageTimer stageTimer(timeFrame ? &timings.OnUpdate : nullptr);
+				for (auto& layer : m_LayerStack)
+					layer->OnUpdate(m_TimeStep);
+			}
+
+			// A fixed tick steps ImGui by exactly one tick, so its animations play out the same on every machine
+			float time = GetTime();
+			io.DeltaTime = fixedTick ? 1.0f / m_Specification.HeadlessTickRate : glm::max(time - m_LastFrameTime, 1e-6f);
+			ImGui::NewFrame();
+
+			RenderDockspace(timeFrame ? &timings.OnUIRender : nullptr);
+
+			{
+				WL_PROFILE_SCOPE("ImGui::Render");
+				FrameStageTimer stageTimer(timeFrame ? &timings.ImGuiRender : nullptr);
+				ImGui::Render();
+			}
+
+			time = GetTime();
+			m_FrameTime = time - m_LastFrameTime;
+			m_TimeStep = glm::min<float>(m_FrameTime, 0.0333f);
+			m_LastFrameTime = time;
+			frames++;
+
+			if (timeFrame)
+			{
+				timings.FrameTime = m_FrameTime * 1000.0f;
+				m_FrameTimings = timings;
+			}
+
+			WL_PROFILE_FRAME();
+		}
+
+		float elapsed = GetTime() - runStart;
+		printf("%s: %llu headless frames in %.3f s (%.1f frames/s, %.3f ms a frame)\n", m_Specification.Name.c_str(), (unsigned long long)frames, elapsed,
+			elapsed > 0.0f ? frames / elapsed : 0.0f, frames > 0 ? elapsed * 1000.0f / frames : 0.0f);
 	}
 
 	void Application::Close()
@@ -689,8 +1196,17 @@ namespace Walnut {
 		m_Running = false;
 	}
 
+	void Application::RequestRedraw()
+	{
+		m_RedrawRequested.store(true);
+		if (!m_Specification.Headless)
+			glfwPostEmptyEvent();
+	}
+
 	float Application::GetTime()
 	{
+		if (m_Specification.Headless)
+			return std::chrono::duration<float>(std::chrono::steady_clock::now() - s_HeadlessStart).count();
 		return (float)glfwGetTime();
 	}
 
@@ -716,20 +1232,30 @@ namespace Walnut {
 		// Use any command queue
 		VkCommandPool command_pool = wd->Frames[wd->FrameIndex].CommandPool;
 
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
-		cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		cmdBufAllocateInfo.commandPool = command_pool;
-		cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		cmdBufAllocateInfo.commandBufferCount = 1;
-
-		VkCommandBuffer& command_buffer = s_AllocatedCommandBuffers[wd->FrameIndex].emplace_back();
-		auto err = vkAllocateCommandBuffers(g_Device, &cmdBufAllocateInfo, &command_buffer);
+		// One from an earlier frame if there's one left over, otherwise it's allocated and kept for next time
+		RecycledCommandBuffers& recycled = s_AllocatedCommandBuffers[wd->FrameIndex];
+		if (recycled.Used == recycled.CommandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
+			cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			cmdBufAllocateInfo.commandPool = command_pool;
+			cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			cmdBufAllocateInfo.commandBufferCount = 1;
+
+			VkCommandBuffer& command_buffer = recycled.CommandBuffers.emplace_back();
+			auto err = vkAllocateCommandBuffers(g_Device, &cmdBufAllocateInfo, &command_buffer);
+			check_vk_result(err);
+		}
+		VkCommandBuffer command_buffer = recycled.CommandBuffers[recycled.Used++];
 
-		VkCommandBufferBeginInfo begin_info = {};
-		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		err = vkBeginCommandBuffer(command_buffer, &begin_info);
-		check_vk_result(err);
+		if (begin)
+		{
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			auto err = vkBeginCommandBuffer(command_buffer, &begin_info);
+			check_vk_result(err);
+		}
 
 		return command_buffer;
 	}
@@ -745,27 +1271,69 @@ namespace Walnut {
 		auto err = vkEndCommandBuffer(commandBuffer);
 		check_vk_result(err);
 
-		// Create fence to ensure that the command buffer has finished executing
-		VkFenceCreateInfo fenceCreateInfo = {};
-		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceCreateInfo.flags = 0;
-		VkFence fence;
-		err = vkCreateFence(g_Device, &fenceCreateInfo, nullptr, &fence);
-		check_vk_result(err);
+		// One fence to ensure that the command buffer has finished executing, reset for the next flush once it has
+		if (g_FlushFence == VK_NULL_HANDLE)
+		{
+			VkFenceCreateInfo fenceCreateInfo = {};
+			fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			err = vkCreateFence(g_Device, &fenceCreateInfo, g_Allocator, &g_FlushFence);
+			check_vk_result(err);
+		}
 
-		err = vkQueueSubmit(g_Queue, 1, &end_info, fence);
+		err = vkQueueSubmit(g_Queue, 1, &end_info, g_FlushFence);
 		check_vk_result(err);
+		s_QueueSubmitCount++;
 
-		err = vkWaitForFences(g_Device, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT);
+		err = vkWaitForFences(g_Device, 1, &g_FlushFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT);
+		check_vk_result(err);
+		err = vkResetFences(g_Device, 1, &g_FlushFence);
 		check_vk_result(err);
+	}
 
-		vkDestroyFence(g_Device, fence, nullptr);
+	VkCommandBuffer Application::GetBatchCommandBuffer()
+	{
+		return BeginUploadSubmission().CommandBuffer;
 	}
 
+	uint64_t Application::GetQueueSubmitCount()
+	{
+		return s_QueueSubmitCount;
+	}
 
-	void Application::SubmitResourceFree(std::function<void()>&& func)
+	VkCommandBuffer Application::BeginUpload(uint64_t size, StagingAllocation& staging)
 	{
-		s_ResourceFreeQueue[s_CurrentFrameIndex].emplace_back(func);
+		if (size > s_StagingRing.GetSize())
+		{
+			// Too big for the ring at all, so it gets a buffer of its own for as long as the copy takes
+			UploadSubmission& submission = BeginUploadSubmission();
+			StagingRing& oversize = submission.OversizeStaging.emplace_back();
+			oversize.Init(g_PhysicalDevice, g_Device, g_Allocator, size);
+			oversize.Allocate(size, 1, staging);
+			return submission.CommandBuffer;
+		}
+
+		while (!s_StagingRing.Allocate(size, g_StagingAlignment, staging))
+		{
+			// The ring's full: take back space from uploads the GPU has finished, waiting for the oldest if it hasn't finished any.
+			// If it's full of this frame's uploads, they're submitted early so there's something to wait for
+			WL_PROFILE_SCOPE("StagingRingFull");
+			if (!CompleteUploadSubmissions(true))
+				SubmitUploads();
+		}
+
+		return BeginUploadSubmission().CommandBuffer;
+	}
+
+	void Application::SubmitResourceFree(DeferredFree resource)
+	{
+		// When it's full the main thread makes room itself, any other waits for the main thread to
+		while (!s_ResourceFreeSubmissions.TryPush(resource))
+		{
+			if (std::this_thread::get_id() == s_MainThreadId)
+				CollectResourceFrees();
+			else
+				std::this_thread::yield();
+		}
 	}
 
 }
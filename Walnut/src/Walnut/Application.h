@@ -1,7 +1,10 @@
 #pragma once
 
 #include "Layer.h"
+#include "StagingRing.h"
+#include "DeferredFree.h"
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <memory>
@@ -21,6 +24,42 @@ namespace Walnut {
 		std::string Name = "Walnut App";
 		uint32_t Width = 1600;
 		uint32_t Height = 900;
+
+		// Render only when something changes instead of continuously: the main loop sleeps until there's input (or a layer calls
+		// Application::RequestRedraw), renders SettleFrames more frames after it so ImGui can finish reacting, then sleeps again.
+		// It still wakes to render a frame every MaxIdleTime seconds
+		bool RenderOnDemand = false;
+		uint32_t SettleFrames = 3;
+		float MaxIdleTime = 1.0f;
+
+		// Run without a window or GPU: layers are updated and their UI built into ImGui draw data that's never drawn, as fast
+		// as possible or HeadlessTickRate frames a second, for HeadlessFrameCount frames (or until Close() if it's 0).
+		// Nothing that needs the Vulkan device (i.e. Walnut::Image) can be used
+		bool Headless = false;
+		float HeadlessTickRate = 0.0f;
+		uint64_t HeadlessFrameCount = 0;
+
+		// Size of the staging ring that Image (and anything else using Application::BeginUpload) copies its data through to
+		// the GPU. Uploads are only held up when a frame's worth of them don't fit, and anything bigger than it all gets a buffer of its own
+		uint64_t StagingRingSize = 32 * 1024 * 1024;
+
+		// Write a Chrome trace of every profile zone (see Profiler.h) to this file while the app runs, if it's set. Ignored in Dist builds
+		std::string ProfileFilepath;
+	};
+
+	// How long the last frame took in milliseconds, with the CPU time of each stage of Run() and the GPU time of its render pass.
+	// The stages are only timed while Application::SetFrameTimingsEnabled(true) (see PerfOverlay)
+	struct FrameTimings
+	{
+		float FrameTime = 0.0f;
+		float OnUpdate = 0.0f;
+		float OnUIRender = 0.0f;
+		float ImGuiRender = 0.0f;
+		float FrameRender = 0.0f;
+		float FramePresent = 0.0f;
+
+		// From a frame or two earlier, when the GPU has finished with it. Negative if the device can't write timestamps
+		float GpuTime = -1.0f;
 	};
 
 	class Application
@@ -45,20 +84,57 @@ namespace Walnut {
 
 		void Close();
 
+		// Render at least one more frame (and SettleFrames after it) when rendering on demand. Can be called from any thread
+		void RequestRedraw();
+
 		float GetTime();
+		bool IsHeadless() const { return m_Specification.Headless; }
+		float GetFrameTime() const { return m_FrameTime; }
+
+		void SetFrameTimingsEnabled(bool enabled) { m_FrameTimingsEnabled = enabled; }
+		bool IsFrameTimingsEnabled() const { return m_FrameTimingsEnabled; }
+		const FrameTimings& GetFrameTimings() const { return m_FrameTimings; }
+
 		GLFWwindow* GetWindowHandle() const { return m_WindowHandle; }
 
 		static VkInstance GetInstance();
 		static VkPhysicalDevice GetPhysicalDevice();
 		static VkDevice GetDevice();
 
+		// A one-shot command buffer (from a pool of them that are reused every few frames) and submitting it, returning once the GPU
+		// has run it. Each flush is a queue submission of its own, work that can wait for the end of the frame is better batched
 		static VkCommandBuffer GetCommandBuffer(bool begin);
 		static void FlushCommandBuffer(VkCommandBuffer commandBuffer);
 
-		static void SubmitResourceFree(std::function<void()>&& func);
+		// A command buffer for one-shot work (layout transitions, copies between GPU resources) that's submitted at the end of the frame
+		// along with its uploads, all in one submission ahead of the frame's rendering. Nothing waits for it, and being submitted first
+		// doesn't order it before the rendering: record a barrier from the work to the stage that consumes its result
+		static VkCommandBuffer GetBatchCommandBuffer();
+
+		// Staging space for an upload of size bytes, and a command buffer to record copying out of it. Both are good until the end
+		// of the frame, when every upload recorded in it is submitted together ahead of the frame's rendering. Nothing waits for
+		// the copies to finish: the staging space is reused once the GPU's done with them. Being submitted first doesn't order the
+		// copies before the rendering either, record a barrier from TRANSFER to the stage that reads the data after copying it
+		// (Image::SetData's goes to FRAGMENT_SHADER)
+		static VkCommandBuffer BeginUpload(uint64_t size, StagingAllocation& staging);
+
+		// Destroy a Vulkan object, or call a function, once the GPU can't be using it any more (a few frames from now). Any thread can
+		// submit them without locking or allocating, see DeferredFree for what a function can capture
+		static void SubmitResourceFree(DeferredFree resource);
+
+		template<typename Func>
+		static void SubmitResourceFree(Func&& func) { SubmitResourceFree(DeferredFree::Call(std::forward<Func>(func))); }
+
+		// How many times Walnut has submitted work to the GPU queue so far: once a frame for rendering, once for the frame's batched
+		// uploads if it had any, and once for every FlushCommandBuffer
+		static uint64_t GetQueueSubmitCount();
 	private:
 		void Init();
+		void InitHeadless();
 		void Shutdown();
+
+		void RunHeadless();
+		void RenderDockspace(float* uiRenderTime);
 	private:
 		ApplicationSpecification m_Specification;
 		GLFWwindow* m_WindowHandle = nullptr;
@@ -68,6 +144,13 @@ namespace Walnut {
 		float m_FrameTime = 0.0f;
 		float m_LastFrameTime = 0.0f;
 
+		// Frames left to render before the main loop can sleep, when rendering on demand
+		uint32_t m_SettleFramesLeft = 0;
+		std::atomic<bool> m_RedrawRequested{ false };
+
+		bool m_FrameTimingsEnabled = false;
+		FrameTimings m_FrameTimings;
+
 		std::vector<std::shared_ptr<Layer>> m_LayerStack;
 		std::function<void()> m_MenubarCallback;
 	};
@@ -0,0 +1,58 @@
+#include "DeferredFree.h"
+
+namespace Walnut {
+
+	void DeferredFreeQueue::Init(uint32_t capacity)
+	{
+		uint64_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+
+		m_Slots = std::make_unique<Slot[]>(size);
+		for (uint64_t i = 0; i < size; i++)
+			m_Slots[i].Sequence.store(i, std::memory_order_relaxed);
+		m_Mask = size - 1;
+		m_Head.store(0, std::memory_order_relaxed);
+		m_Tail = 0;
+	}
+
+	bool DeferredFreeQueue::TryPush(const DeferredFree& record)
+	{
+		// A slot's sequence is its position while it's free for that position, so one behind the position means the
+		// consumer hasn't taken what was there a lap ago (it's full) and ahead of it means another producer got there first
+		uint64_t position = m_Head.load(std::memory_order_relaxed);
+		Slot* slot;
+		for (;;)
+		{
+			slot = &m_Slots[position & m_Mask];
+			int64_t diff = (int64_t)(slot->Sequence.load(std::memory_order_acquire) - position);
+			if (diff == 0)
+			{
+				if (m_Head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				position = m_Head.load(std::memory_order_relaxed);
+		}
+
+		slot->Record = record;
+		slot->Sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool DeferredFreeQueue::TryPop(DeferredFree& record)
+	{
+		Slot& slot = m_Slots[m_Tail & m_Mask];
+		if (slot.Sequence.load(std::memory_order_acquire) != m_Tail + 1)
+			return false;
+
+		record = slot.Record;
+		// Free for the producer a lap from now
+		slot.Sequence.store(m_Tail + m_Mask + 1, std::memory_order_release);
+		m_Tail++;
+		return true;
+	}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "vulkan/vulkan.h"
+
+namespace Walnut {
+
+	enum class DeferredFreeType : uint32_t
+	{
+		Callback = 0,
+		Buffer,
+		Image,
+		ImageView,
+		Sampler,
+		DeviceMemory,
+		CommandPool,
+		Fence
+	};
+
+	// Something to destroy once the GPU can't be using it any more (see Application::SubmitResourceFree): a Vulkan handle and its
+	// type, or a small callable stored in the record itself. Records are copied around as plain bytes, so nothing is allocated
+	// for them and callables have to be trivially copyable (capture handles and plain values, not objects that own things)
+	struct DeferredFree
+	{
+		DeferredFreeType Type = DeferredFreeType::Callback;
+		uint64_t Handle = 0;
+		void (*Callback)(void* data) = nullptr;
+		alignas(8) unsigned char Data[32];
+
+		static DeferredFree DestroyBuffer(VkBuffer buffer) { return { DeferredFreeType::Buffer, (uint64_t)buffer }; }
+		static DeferredFree DestroyImage(VkImage image) { return { DeferredFreeType::Image, (uint64_t)image }; }
+		static DeferredFree DestroyImageView(VkImageView imageView) { return { DeferredFreeType::ImageView, (uint64_t)imageView }; }
+		static DeferredFree DestroySampler(VkSampler sampler) { return { DeferredFreeType::Sampler, (uint64_t)sampler }; }
+		static DeferredFree FreeMemory(VkDeviceMemory memory) { return { DeferredFreeType::DeviceMemory, (uint64_t)memory }; }
+		static DeferredFree DestroyCommandPool(VkCommandPool commandPool) { return { DeferredFreeType::CommandPool, (uint64_t)commandPool }; }
+		static DeferredFree DestroyFence(VkFence fence) { return { DeferredFreeType::Fence, (uint64_t)fence }; }
+
+		template<typename Func>
+		static DeferredFree Call(Func&& func)
+		{
+			using F = std::decay_t<Func>;
+			static_assert(sizeof(F) <= sizeof(Data) && alignof(F) <= 8, "Deferred free callbacks are stored inline, capture less");
+			static_assert(std::is_trivially_copyable_v<F>, "Deferred free callbacks are copied as bytes, capture handles and plain values");
+
+			DeferredFree record;
+			new (record.Data) F(std::forward<Func>(func));
+			record.Callback = [](void* data) { (*std::launder((F*)data))(); };
+			return record;
+		}
+	};
+
+	// Hands records from any number of threads to the one thread that frees them, without locks or allocating. It's a bounded
+	// ring where each slot has a sequence number saying whose turn it is: a producer claims a position with one compare and swap,
+	// writes its record and bumps the slot's sequence to publish it, and the consumer takes records in position order once published
+	class DeferredFreeQueue
+	{
+	public:
+		// Capacity is rounded up to a power of two
+		void Init(uint32_t capacity);
+
+		// Returns false if the queue's full until the consumer catches up. Any thread
+		bool TryPush(const DeferredFree& record);
+
+		// Returns false if there's nothing published to take. Only from the consuming thread
+		bool TryPop(DeferredFree& record);
+	private:
+		struct Slot
+		{
+			std::atomic<uint64_t> Sequence{ 0 };
+			DeferredFree Record;
+		};
+
+		std::unique_ptr<Slot[]> m_Slots;
+		uint64_t m_Mask = 0;
+
+		alignas(64) std::atomic<uint64_t> m_Head{ 0 };
+		alignas(64) uint64_t m_Tail = 0;
+	};
+
+}
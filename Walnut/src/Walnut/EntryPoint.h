@@ -1,6 +1,6 @@
 #pragma once
 
-#ifdef WL_PLATFORM_WINDOWS
+#if defined(WL_PLATFORM_WINDOWS) || defined(WL_PLATFORM_LINUX)
 
 extern Walnut::Application* Walnut::CreateApplication(int argc, char** argv);
 bool g_ApplicationRunning = true;
@@ -21,7 +21,7 @@ namespace Walnut {
 
 }
 
-#ifdef WL_DIST
+#if defined(WL_PLATFORM_WINDOWS) && defined(WL_DIST)
 
 #include <Windows.h>
 
@@ -37,6 +37,6 @@ int main(int argc, char** argv)
 	return Walnut::Main(argc, argv);
 }
 
-#endif // WL_DIST
+#endif // WL_PLATFORM_WINDOWS && WL_DIST
 
-#endif // WL_PLATFORM_WINDOWS
+#endif // WL_PLATFORM_WINDOWS || WL_PLATFORM_LINUX
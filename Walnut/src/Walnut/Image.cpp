@@ -47,8 +47,8 @@ namespace Walnut {
 
 	}
 
-	Image::Image(std::string_view path)
-		: m_Filepath(path)
+	Image::Image(std::string_view path, const ImageSampler& sampler)
+		: m_SamplerSpec(sampler), m_Filepath(path)
 	{
 		int width, height, channels;
 		uint8_t* data = nullptr;
@@ -71,8 +71,8 @@ namespace Walnut {
 		SetData(data);
 	}
 
-	Image::Image(uint32_t width, uint32_t height, ImageFormat format, const void* data)
-		: m_Width(width), m_Height(height), m_Format(format)
+	Image::Image(uint32_t width, uint32_t height, ImageFormat format, const void* data, const ImageSampler& sampler)
+		: m_Width(width), m_Height(height), m_Format(format), m_SamplerSpec(sampler)
 	{
 		AllocateMemory(m_Width * m_Height * Utils::BytesPerPixel(m_Format));
 		if (data)
@@ -136,22 +136,8 @@ namespace Walnut {
 			check_vk_result(err);
 		}
 
-		// Create sampler:
-		{
-			VkSamplerCreateInfo info = {};
-			info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-			info.magFilter = VK_FILTER_LINEAR;
-			info.minFilter = VK_FILTER_LINEAR;
-			info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			info.minLod = -1000;
-			info.maxLod = 1000;
-			info.maxAnisotropy = 1.0f;
-			VkResult err = vkCreateSampler(device, &info, nullptr, &m_Sampler);
-			check_vk_result(err);
-		}
+		// Shared with every other image sampled the same way
+		m_Sampler = SamplerCache::Acquire(m_SamplerSpec);
 
 		// Create the Descriptor Set:
 		m_DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
@@ -159,81 +145,29 @@ namespace Walnut {
 
 	void Image::Release()
 	{
-		Application::SubmitResourceFree([sampler = m_Sampler, imageView = m_ImageView, image = m_Image,
-			memory = m_Memory, stagingBuffer = m_StagingBuffer, stagingBufferMemory = m_StagingBufferMemory]()
-		{
-			VkDevice device = Application::GetDevice();
-
-			vkDestroySampler(device, sampler, nullptr);
-			vkDestroyImageView(device, imageView, nullptr);
-			vkDestroyImage(device, image, nullptr);
-			vkFreeMemory(device, memory, nullptr);
-			vkDestroyBuffer(device, stagingBuffer, nullptr);
-			vkFreeMemory(device, stagingBufferMemory, nullptr);
-		});
+		Application::SubmitResourceFree(DeferredFree::DestroyImageView(m_ImageView));
+		Application::SubmitResourceFree(DeferredFree::DestroyImage(m_Image));
+		Application::SubmitResourceFree(DeferredFree::FreeMemory(m_Memory));
+		Application::SubmitResourceFree([sampler = m_SamplerSpec]() { SamplerCache::Release(sampler); });
 
 		m_Sampler = nullptr;
 		m_ImageView = nullptr;
 		m_Image = nullptr;
 		m_Memory = nullptr;
-		m_StagingBuffer = nullptr;
-		m_StagingBufferMemory = nullptr;
 	}
 
 	void Image::SetData(const void* data)
 	{
-		VkDevice device = Application::GetDevice();
-
 		size_t upload_size = m_Width * m_Height * Utils::BytesPerPixel(m_Format);
 
-		VkResult err;
-
-		if (!m_StagingBuffer)
-		{
-			// Create the Upload Buffer
-			{
-				VkBufferCreateInfo buffer_info = {};
-				buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-				buffer_info.size = upload_size;
-				buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-				buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-				err = vkCreateBuffer(device, &buffer_info, nullptr, &m_StagingBuffer);
-				check_vk_result(err);
-				VkMemoryRequirements req;
-				vkGetBufferMemoryRequirements(device, m_StagingBuffer, &req);
-				m_AlignedSize = req.size;
-				VkMemoryAllocateInfo alloc_info = {};
-				alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-				alloc_info.allocationSize = req.size;
-				alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
-				err = vkAllocateMemory(device, &alloc_info, nullptr, &m_StagingBufferMemory);
-				check_vk_result(err);
-				err = vkBindBufferMemory(device, m_StagingBuffer, m_StagingBufferMemory, 0);
-				check_vk_result(err);
-			}
-
-		}
-
-		// Upload to Buffer
-		{
-			char* map = NULL;
-			err = vkMapMemory(device, m_StagingBufferMemory, 0, m_AlignedSize, 0, (void**)(&map));
-			check_vk_result(err);
-			memcpy(map, data, upload_size);
-			VkMappedMemoryRange range[1] = {};
-			range[0].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-			range[0].memory = m_StagingBufferMemory;
-			range[0].size = m_AlignedSize;
-			err = vkFlushMappedMemoryRanges(device, 1, range);
-			check_vk_result(err);
-			vkUnmapMemory(device, m_StagingBufferMemory);
-		}
-
+		// Upload to the staging ring, the data's copied out of there when this frame's uploads are submitted
+		StagingAllocation staging;
+		VkCommandBuffer command_buffer = Application::BeginUpload(upload_size, staging);
+		memcpy(staging.Data, data, upload_size);
 
 		// Copy to Image
 		{
-			VkCommandBuffer command_buffer = Application::GetCommandBuffer(true);
-
+			// The last frame to sample the image may still be rendering, so the copy waits for its fragment shaders
 			VkImageMemoryBarrier copy_barrier = {};
 			copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 			copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
@@ -245,15 +179,16 @@ namespace Walnut {
 			copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			copy_barrier.subresourceRange.levelCount = 1;
 			copy_barrier.subresourceRange.layerCount = 1;
-			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &copy_barrier);
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &copy_barrier);
 
 			VkBufferImageCopy region = {};
+			region.bufferOffset = staging.Offset;
 			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			region.imageSubresource.layerCount = 1;
 			region.imageExtent.width = m_Width;
 			region.imageExtent.height = m_Height;
 			region.imageExtent.depth = 1;
-			vkCmdCopyBufferToImage(command_buffer, m_StagingBuffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+			vkCmdCopyBufferToImage(command_buffer, staging.Buffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
 			VkImageMemoryBarrier use_barrier = {};
 			use_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -268,8 +203,6 @@ namespace Walnut {
 			use_barrier.subresourceRange.levelCount = 1;
 			use_barrier.subresourceRange.layerCount = 1;
 			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
-
-			Application::FlushCommandBuffer(command_buffer);
 		}
 	}
 
@@ -4,6 +4,8 @@
 
 #include "vulkan/vulkan.h"
 
+#include "SamplerCache.h"
+
 namespace Walnut {
 
 	enum class ImageFormat
@@ -16,8 +18,8 @@ namespace Walnut {
 	class Image
 	{
 	public:
-		Image(std::string_view path);
-		Image(uint32_t width, uint32_t height, ImageFormat format, const void* data = nullptr);
+		Image(std::string_view path, const ImageSampler& sampler = ImageSampler());
+		Image(uint32_t width, uint32_t height, ImageFormat format, const void* data = nullptr, const ImageSampler& sampler = ImageSampler());
 		~Image();
 
 		void SetData(const void* data);
@@ -28,6 +30,7 @@ namespace Walnut {
 
 		uint32_t GetWidth() const { return m_Width; }
 		uint32_t GetHeight() const { return m_Height; }
+		const ImageSampler& GetSampler() const { return m_SamplerSpec; }
 	private:
 		void AllocateMemory(uint64_t size);
 		void Release();
@@ -40,11 +43,7 @@ namespace Walnut {
 		VkSampler m_Sampler = nullptr;
 
 		ImageFormat m_Format = ImageFormat::None;
-
-		VkBuffer m_StagingBuffer = nullptr;
-		VkDeviceMemory m_StagingBufferMemory = nullptr;
-
-		size_t m_AlignedSize = 0;
+		ImageSampler m_SamplerSpec;
 
 		VkDescriptorSet m_DescriptorSet = nullptr;
 
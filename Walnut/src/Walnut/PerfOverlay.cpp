@@ -0,0 +1,156 @@
+#include "PerfOverlay.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Walnut {
+
+	static const char* s_StageNames[] = { "OnUpdate", "OnUIRender", "ImGui::Render", "FrameRender", "FramePresent" };
+	static float FrameTimings::* const s_Stages[] = { &FrameTimings::OnUpdate, &FrameTimings::OnUIRender, &FrameTimings::ImGuiRender, &FrameTimings::FrameRender, &FrameTimings::FramePresent };
+
+	void PerfOverlay::SetVisible(bool visible)
+	{
+		if (visible == m_Visible)
+			return;
+
+		m_Visible = visible;
+		Application::Get().SetFrameTimingsEnabled(visible);
+		if (!visible)
+			return;
+
+		// Start counting again from the next frame that's timed
+		m_Window.clear();
+		m_Window.reserve(s_WindowLength);
+		m_Next = 0;
+		m_Bins.assign(s_BinCount, 0);
+		std::fill(std::begin(m_StageSums), std::end(m_StageSums), 0.0);
+		m_GpuSum = 0.0;
+		m_GpuFrames = 0;
+		m_SkipFrames = 1;
+	}
+
+	void PerfOverlay::MenuItem(const char* label)
+	{
+		bool visible = m_Visible;
+		if (ImGui::MenuItem(label, nullptr, &visible))
+			SetVisible(visible);
+	}
+
+	static size_t FrameTimeBin(float frameTime, float binWidth, size_t binCount)
+	{
+		return std::min((size_t)(std::max(frameTime, 0.0f) / binWidth), binCount - 1);
+	}
+
+	void PerfOverlay::AddFrame(const FrameTimings& timings)
+	{
+		// Take the oldest frame out of the window once it's full
+		if (m_Window.size() == s_WindowLength)
+		{
+			const FrameTimings& oldest = m_Window[m_Next];
+			m_Bins[FrameTimeBin(oldest.FrameTime, s_BinWidth, s_BinCount)]--;
+			for (size_t i = 0; i < IM_ARRAYSIZE(s_Stages); i++)
+				m_StageSums[i] -= oldest.*s_Stages[i];
+			if (oldest.GpuTime >= 0.0f)
+			{
+				m_GpuSum -= oldest.GpuTime;
+				m_GpuFrames--;
+			}
+			m_Window[m_Next] = timings;
+		}
+		else
+			m_Window.push_back(timings);
+		m_Next = (m_Next + 1) % s_WindowLength;
+
+		m_Bins[FrameTimeBin(timings.FrameTime, s_BinWidth, s_BinCount)]++;
+		for (size_t i = 0; i < IM_ARRAYSIZE(s_Stages); i++)
+			m_StageSums[i] += timings.*s_Stages[i];
+		if (timings.GpuTime >= 0.0f)
+		{
+			m_GpuSum += timings.GpuTime;
+			m_GpuFrames++;
+		}
+	}
+
+	float PerfOverlay::FrameTimePercentile(float percentile) const
+	{
+		// The top of the bin the percentile falls in, so it's at most a bin out (past the last bin it's the top of the range)
+		uint32_t target = (uint32_t)std::ceil(percentile * m_Window.size());
+		uint32_t count = 0;
+		for (size_t bin = 0; bin + 1 < s_BinCount; bin++)
+		{
+			count += m_Bins[bin];
+			if (count >= target)
+				return (bin + 1) * s_BinWidth;
+		}
+		return s_BinCount * s_BinWidth;
+	}
+
+	void PerfOverlay::OnUIRender()
+	{
+		if (!m_Visible)
+			return;
+
+		if (m_SkipFrames > 0)
+			m_SkipFrames--;
+		else if (Application::Get().GetFrameTimings().FrameTime > 0.0f)
+			AddFrame(Application::Get().GetFrameTimings());
+		if (m_Window.empty())
+			return;
+
+		float worst = 0.0f;
+		double total = 0.0;
+		for (const FrameTimings& frame : m_Window)
+		{
+			worst = std::max(worst, frame.FrameTime);
+			total += frame.FrameTime;
+		}
+		float average = (float)(total / m_Window.size());
+
+		// Pinned to the top right corner of the main window, on top of everything else
+		const ImGuiViewport* viewport = ImGui::GetMainViewport();
+		ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x - 10.0f, viewport->WorkPos.y + 10.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+		ImGui::SetNextWindowViewport(viewport->ID);
+		ImGui::SetNextWindowBgAlpha(0.8f);
+		ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings
+			| ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove;
+		if (ImGui::Begin("Performance", nullptr, flags))
+		{
+			ImGui::Text("%.1f fps, %.2f ms average over %d frames", average > 0.0f ? 1000.0f / average : 0.0f, average, (int)m_Window.size());
+			ImGui::Text("p50 %.2f  p95 %.2f  p99 %.2f  worst %.2f ms",
+				std::min(FrameTimePercentile(0.50f), worst), std::min(FrameTimePercentile(0.95f), worst), std::min(FrameTimePercentile(0.99f), worst), worst);
+
+			// Frame times oldest to newest, then how many frames took how long
+			struct Window { const std::vector<FrameTimings>* Frames; size_t Next; };
+			Window window = { &m_Window, m_Window.size() == s_WindowLength ? m_Next : 0 };
+			ImGui::PlotLines("##FrameTimes", [](void* data, int i) {
+				const Window& w = *(const Window*)data;
+				return (*w.Frames)[(w.Next + i) % w.Frames->size()].FrameTime;
+			}, &window, (int)m_Window.size(), 0, "frame time", 0.0f, std::max(worst, 1000.0f / 60.0f), ImVec2(320.0f, 60.0f));
+
+			size_t lastBin = FrameTimeBin(worst, s_BinWidth, s_BinCount);
+			ImGui::PlotHistogram("##FrameTimeHistogram", [](void* data, int i) {
+				return (float)(*(const std::vector<uint32_t>*)data)[i];
+			}, &m_Bins, (int)lastBin + 1, 0, nullptr, 0.0f, FLT_MAX, ImVec2(320.0f, 60.0f));
+			ImGui::SameLine();
+			ImGui::Text("0 - %.1f ms", (lastBin + 1) * s_BinWidth);
+
+			ImGui::Separator();
+			for (size_t i = 0; i < IM_ARRAYSIZE(s_Stages); i++)
+			{
+				ImGui::Text("CPU %-14s", s_StageNames[i]);
+				ImGui::SameLine(160.0f);
+				ImGui::Text("%6.3f ms", m_StageSums[i] / m_Window.size());
+			}
+			ImGui::Text("GPU %-14s", "render pass");
+			ImGui::SameLine(160.0f);
+			if (m_GpuFrames > 0)
+				ImGui::Text("%6.3f ms", m_GpuSum / m_GpuFrames);
+			else
+				ImGui::TextDisabled("not supported");
+		}
+		ImGui::End();
+	}
+
+}
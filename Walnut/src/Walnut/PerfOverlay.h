@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Layer.h"
+#include "Application.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Walnut {
+
+	// A corner overlay with how long frames are taking: p50/p95/p99 and the worst frame time over the last few seconds,
+	// a histogram of them, and where the time goes on the CPU (each stage of Application::Run()) and on the GPU.
+	// Push it as a layer and put MenuItem() in the app's menubar callback. It's hidden to start with, and while hidden
+	// it draws nothing and Application doesn't time its frames
+	class PerfOverlay : public Layer
+	{
+	public:
+		void SetVisible(bool visible);
+		bool IsVisible() const { return m_Visible; }
+		void Toggle() { SetVisible(!m_Visible); }
+
+		// A checkable menu item that shows and hides the overlay
+		void MenuItem(const char* label = "Performance");
+
+		virtual void OnDetach() override { SetVisible(false); }
+		virtual void OnUIRender() override;
+	private:
+		void AddFrame(const FrameTimings& timings);
+		float FrameTimePercentile(float percentile) const;
+	private:
+		// About ten seconds at 60 frames a second
+		static constexpr size_t s_WindowLength = 600;
+
+		// Frame times are counted in quarter millisecond bins up to 100 ms, and anything slower in the last one
+		static constexpr float s_BinWidth = 0.25f;
+		static constexpr size_t s_BinCount = 401;
+
+		bool m_Visible = false;
+		// Frames to wait after being shown, until Application's timings are of a frame it timed
+		int m_SkipFrames = 0;
+
+		// The last frames' timings, oldest first once it's wrapped around to m_Next
+		std::vector<FrameTimings> m_Window;
+		size_t m_Next = 0;
+
+		std::vector<uint32_t> m_Bins;
+
+		// Sums over the window for the averages, the GPU's only over the frames it was timed for
+		double m_StageSums[5] = {};
+		double m_GpuSum = 0.0;
+		uint32_t m_GpuFrames = 0;
+	};
+
+}
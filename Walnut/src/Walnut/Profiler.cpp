@@ -0,0 +1,280 @@
+#include "Profiler.h"
+
+#if !defined(WL_DIST)
+
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Walnut {
+
+	// Zones a thread can have waiting for the flusher, at 24 bytes each. The flusher wakes often enough that
+	// a thread has to close hundreds of thousands of zones a second to fill it
+	static constexpr uint64_t s_RingCapacity = 16 * 1024;
+	static constexpr auto s_FlushInterval = std::chrono::milliseconds(20);
+
+	// A single producer, single consumer queue of closed zones. Only its thread writes Head and only the flusher writes Tail,
+	// each keeps to its own cache line so they don't slow each other down
+	struct ProfileRing
+	{
+		alignas(64) std::atomic<uint64_t> Head{ 0 };
+		uint64_t CachedTail = 0;
+		std::atomic<uint64_t> Dropped{ 0 };
+
+		alignas(64) std::atomic<uint64_t> Tail{ 0 };
+
+		alignas(64) std::atomic<bool> Retired{ false };
+		uint32_t ThreadId = 0;
+		std::string ThreadName;
+		std::mutex NameMutex;
+
+		ProfileEvent Events[s_RingCapacity];
+	};
+
+	// Marks a thread's ring retired when the thread exits, so the flusher can free it once it's been emptied
+	struct ProfileRingOwner
+	{
+		ProfileRing* Ring = nullptr;
+		~ProfileRingOwner()
+		{
+			if (Ring)
+				Ring->Retired.store(true, std::memory_order_release);
+		}
+	};
+
+	std::atomic<bool> Profiler::s_Active{ false };
+
+	// Kept trivial so reaching it on the hot path is a plain thread local read
+	static thread_local ProfileRing* t_Ring = nullptr;
+
+	static std::mutex s_RegistryMutex;
+	static std::vector<std::unique_ptr<ProfileRing>> s_Rings;
+	static uint32_t s_NextThreadId = 1;
+	static uint64_t s_RetiredDropped = 0;
+
+	// Everything below is the session, only touched by the flusher thread while it runs
+	static std::mutex s_SessionMutex;
+	static std::condition_variable s_SessionWake;
+	static bool s_StopRequested = false;
+	static std::thread s_Flusher;
+	static FILE* s_File = nullptr;
+	static uint64_t s_SessionStart = 0;
+	static bool s_FirstEvent = true;
+
+	static const ProfileZone s_FrameZone = { "Frame", __FILE__, __LINE__ };
+	static thread_local uint64_t t_LastFrame = 0;
+
+	static ProfileRing* RegisterThread()
+	{
+		static thread_local ProfileRingOwner owner;
+
+		auto ring = std::make_unique<ProfileRing>();
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+		ring->ThreadId = s_NextThreadId++;
+		owner.Ring = ring.get();
+		t_Ring = ring.get();
+		s_Rings.push_back(std::move(ring));
+		return t_Ring;
+	}
+
+	static void WriteString(FILE* file, const char* s)
+	{
+		fputc('"', file);
+		for (; *s; s++)
+		{
+			if (*s == '"' || *s == '\\')
+			{
+				fputc('\\', file);
+				fputc(*s, file);
+			}
+			else if ((unsigned char)*s < 0x20)
+				fprintf(file, "\\u%04x", *s);
+			else
+				fputc(*s, file);
+		}
+		fputc('"', file);
+	}
+
+	static void BeginEvent()
+	{
+		fputs(s_FirstEvent ? "\n" : ",\n", s_File);
+		s_FirstEvent = false;
+	}
+
+	static void WriteThreadName(ProfileRing& ring)
+	{
+		std::string name;
+		{
+			std::lock_guard<std::mutex> lock(ring.NameMutex);
+			name = ring.ThreadName.empty() ? "Thread " + std::to_string(ring.ThreadId) : ring.ThreadName;
+		}
+
+		BeginEvent();
+		fprintf(s_File, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", ring.ThreadId);
+		WriteString(s_File, name.c_str());
+		fputs("}}", s_File);
+	}
+
+	// Write out every zone waiting in a ring, as a complete ("X") event with its start and duration in microseconds
+	static void DrainRing(ProfileRing& ring)
+	{
+		uint64_t tail = ring.Tail.load(std::memory_order_relaxed);
+		uint64_t head = ring.Head.load(std::memory_order_acquire);
+		for (; tail != head; tail++)
+		{
+			const ProfileEvent& event = ring.Events[tail & (s_RingCapacity - 1)];
+
+			// A zone opened before the session started is cut to the start of the session
+			uint64_t start = event.Start > s_SessionStart ? event.Start : s_SessionStart;
+			uint64_t end = event.End > start ? event.End : start;
+
+			BeginEvent();
+			fputs("{\"name\":", s_File);
+			WriteString(s_File, event.Zone->Name);
+			fprintf(s_File, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				event.Zone == &s_FrameZone ? "frame" : "zone", (start - s_SessionStart) / 1000.0, (end - start) / 1000.0, ring.ThreadId);
+		}
+		ring.Tail.store(tail, std::memory_order_release);
+	}
+
+	// Empty every ring, freeing the ones whose thread has exited
+	static void DrainAll()
+	{
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+		for (size_t i = 0; i < s_Rings.size();)
+		{
+			ProfileRing& ring = *s_Rings[i];
+			// Retired is read first, a retired thread can't add anything after it
+			bool retired = ring.Retired.load(std::memory_order_acquire);
+			DrainRing(ring);
+			if (retired)
+			{
+				WriteThreadName(ring);
+				s_RetiredDropped += ring.Dropped.load(std::memory_order_relaxed);
+				s_Rings.erase(s_Rings.begin() + i);
+			}
+			else
+				i++;
+		}
+	}
+
+	static void FlusherMain()
+	{
+		std::unique_lock<std::mutex> lock(s_SessionMutex);
+		while (!s_StopRequested)
+		{
+			s_SessionWake.wait_for(lock, s_FlushInterval);
+			DrainAll();
+		}
+	}
+
+	bool Profiler::BeginSession(const std::string& filepath)
+	{
+		if (s_File)
+			EndSession();
+
+		s_File = fopen(filepath.c_str(), "w");
+		if (!s_File)
+			return false;
+		setvbuf(s_File, nullptr, _IOFBF, 1 << 20);
+		fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", s_File);
+		s_FirstEvent = true;
+
+		// Anything left over from an earlier session is dropped
+		{
+			std::lock_guard<std::mutex> lock(s_RegistryMutex);
+			for (auto& ring : s_Rings)
+			{
+				ring->Tail.store(ring->Head.load(std::memory_order_acquire), std::memory_order_release);
+				ring->Dropped.exchange(0, std::memory_order_relaxed);
+			}
+			s_RetiredDropped = 0;
+		}
+
+		s_SessionStart = Now();
+		t_LastFrame = s_SessionStart;
+		s_StopRequested = false;
+		s_Flusher = std::thread(FlusherMain);
+		s_Active.store(true, std::memory_order_release);
+		return true;
+	}
+
+	void Profiler::EndSession()
+	{
+		if (!s_File)
+			return;
+
+		s_Active.store(false, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(s_SessionMutex);
+			s_StopRequested = true;
+		}
+		s_SessionWake.notify_one();
+		s_Flusher.join();
+
+		// Zones still open when the session ended are recorded after this and dropped by the next session
+		DrainAll();
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+		uint64_t dropped = s_RetiredDropped;
+		for (auto& ring : s_Rings)
+		{
+			WriteThreadName(*ring);
+			dropped += ring->Dropped.load(std::memory_order_relaxed);
+		}
+		fprintf(s_File, "\n],\"otherData\":{\"droppedEvents\":%llu}}\n", (unsigned long long)dropped);
+		fclose(s_File);
+		s_File = nullptr;
+	}
+
+	void Profiler::SetThreadName(const char* name)
+	{
+		ProfileRing* ring = t_Ring ? t_Ring : RegisterThread();
+		std::lock_guard<std::mutex> lock(ring->NameMutex);
+		ring->ThreadName = name;
+	}
+
+	void Profiler::MarkFrame()
+	{
+		uint64_t now = Now();
+		if (IsActive() && t_LastFrame != 0)
+			Record(&s_FrameZone, t_LastFrame, now);
+		t_LastFrame = now;
+	}
+
+	uint64_t Profiler::GetDroppedEvents()
+	{
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+		uint64_t dropped = s_RetiredDropped;
+		for (auto& ring : s_Rings)
+			dropped += ring->Dropped.load(std::memory_order_relaxed);
+		return dropped;
+	}
+
+	void Profiler::Record(const ProfileZone* zone, uint64_t start, uint64_t end)
+	{
+		ProfileRing* ring = t_Ring;
+		if (!ring)
+			ring = RegisterThread();
+
+		// Only go to the flusher's line for Tail when the ring looks full
+		uint64_t head = ring->Head.load(std::memory_order_relaxed);
+		if (head - ring->CachedTail >= s_RingCapacity)
+		{
+			ring->CachedTail = ring->Tail.load(std::memory_order_acquire);
+			if (head - ring->CachedTail >= s_RingCapacity)
+			{
+				ring->Dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+
+		ring->Events[head & (s_RingCapacity - 1)] = { zone, start, end };
+		ring->Head.store(head + 1, std::memory_order_release);
+	}
+
+}
+
+#endif
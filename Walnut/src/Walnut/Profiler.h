@@ -0,0 +1,108 @@
+#pragma once
+
+// Instrumentation for finding where frame time goes. Wrap code in a zone:
+//
+//     WL_PROFILE_SCOPE("Upload thumbnails");    or    WL_PROFILE_FUNCTION();
+//
+// and while a session is running (see ApplicationSpecification::ProfileFilepath) every zone any thread closes is written
+// to a Chrome trace-event JSON file, which chrome://tracing or https://ui.perfetto.dev can open.
+// Zone names are interned once per call site, so a zone costs two clock reads and a store into the thread's own buffer.
+// All of it compiles out in Dist builds.
+
+#if !defined(WL_DIST)
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Walnut {
+
+	// A call site being profiled. These are statics made by the macros, a zone is identified by its address
+	struct ProfileZone
+	{
+		const char* Name;
+		const char* File;
+		uint32_t Line;
+	};
+
+	// One closed zone, times in nanoseconds of the profiler's clock
+	struct ProfileEvent
+	{
+		const ProfileZone* Zone;
+		uint64_t Start;
+		uint64_t End;
+	};
+
+	class Profiler
+	{
+	public:
+		// Start writing every zone to a trace file, returns false if it can't be created. Call from the main thread
+		static bool BeginSession(const std::string& filepath);
+		// Write out everything still buffered and close the file
+		static void EndSession();
+		static bool IsActive() { return s_Active.load(std::memory_order_relaxed); }
+
+		// Name the calling thread in the trace (threads are otherwise "Thread N" in the order they first recorded a zone)
+		static void SetThreadName(const char* name);
+
+		// Record the end of a frame on the calling thread, frames show up in the trace as zones of their own
+		static void MarkFrame();
+
+		// Zones that had to be dropped because a thread filled its buffer before the flusher emptied it
+		static uint64_t GetDroppedEvents();
+
+		// The profiler's clock in nanoseconds, reading it is most of what a zone costs
+		static uint64_t Now()
+		{
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// Add a closed zone to the calling thread's buffer. Never blocks or allocates once the thread has recorded its first zone
+		static void Record(const ProfileZone* zone, uint64_t start, uint64_t end);
+	private:
+		static std::atomic<bool> s_Active;
+	};
+
+	class ProfileScope
+	{
+	public:
+		ProfileScope(const ProfileZone* zone)
+			: m_Zone(Profiler::IsActive() ? zone : nullptr), m_Start(m_Zone ? Profiler::Now() : 0) {}
+		~ProfileScope()
+		{
+			if (m_Zone)
+				Profiler::Record(m_Zone, m_Start, Profiler::Now());
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+	private:
+		const ProfileZone* m_Zone;
+		uint64_t m_Start;
+	};
+
+}
+
+#define WL_PROFILE_CONCAT_INNER(a, b) a##b
+#define WL_PROFILE_CONCAT(a, b) WL_PROFILE_CONCAT_INNER(a, b)
+
+#define WL_PROFILE_BEGIN_SESSION(filepath) ::Walnut::Profiler::BeginSession(filepath)
+#define WL_PROFILE_END_SESSION() ::Walnut::Profiler::EndSession()
+#define WL_PROFILE_THREAD(name) ::Walnut::Profiler::SetThreadName(name)
+#define WL_PROFILE_FRAME() ::Walnut::Profiler::MarkFrame()
+#define WL_PROFILE_SCOPE(name) \
+	static const ::Walnut::ProfileZone WL_PROFILE_CONCAT(s_ProfileZone, __LINE__) = { name, __FILE__, __LINE__ }; \
+	::Walnut::ProfileScope WL_PROFILE_CONCAT(profileScope, __LINE__)(&WL_PROFILE_CONCAT(s_ProfileZone, __LINE__))
+#define WL_PROFILE_FUNCTION() WL_PROFILE_SCOPE(__func__)
+
+#else
+
+#define WL_PROFILE_BEGIN_SESSION(filepath)
+#define WL_PROFILE_END_SESSION()
+#define WL_PROFILE_THREAD(name)
+#define WL_PROFILE_FRAME()
+#define WL_PROFILE_SCOPE(name)
+#define WL_PROFILE_FUNCTION()
+
+#endif
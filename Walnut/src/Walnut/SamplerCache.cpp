@@ -0,0 +1,99 @@
+#include "SamplerCache.h"
+
+#include "Application.h"
+
+#include <unordered_map>
+
+namespace Walnut {
+
+	struct ImageSamplerHash
+	{
+		size_t operator()(const ImageSampler& sampler) const
+		{
+			return std::hash<uint32_t>()((uint32_t)sampler.Filter | (uint32_t)sampler.Wrap << 8);
+		}
+	};
+
+	struct CachedSampler
+	{
+		VkSampler Sampler = VK_NULL_HANDLE;
+		uint32_t RefCount = 0;
+	};
+
+	static std::unordered_map<ImageSampler, CachedSampler, ImageSamplerHash> s_Samplers;
+
+	namespace Utils {
+
+		static VkFilter ImageFilterToVulkanFilter(ImageFilter filter)
+		{
+			switch (filter)
+			{
+				case ImageFilter::Linear:  return VK_FILTER_LINEAR;
+				case ImageFilter::Nearest: return VK_FILTER_NEAREST;
+			}
+			return VK_FILTER_LINEAR;
+		}
+
+		static VkSamplerAddressMode ImageWrapToVulkanAddressMode(ImageWrap wrap)
+		{
+			switch (wrap)
+			{
+				case ImageWrap::Repeat:         return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+				case ImageWrap::ClampToEdge:    return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+				case ImageWrap::MirroredRepeat: return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+			}
+			return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		}
+
+	}
+
+	VkSampler SamplerCache::Acquire(const ImageSampler& sampler)
+	{
+		CachedSampler& cached = s_Samplers[sampler];
+		if (!cached.Sampler)
+		{
+			VkFilter filter = Utils::ImageFilterToVulkanFilter(sampler.Filter);
+			VkSamplerAddressMode addressMode = Utils::ImageWrapToVulkanAddressMode(sampler.Wrap);
+
+			VkSamplerCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+			info.magFilter = filter;
+			info.minFilter = filter;
+			info.mipmapMode = sampler.Filter == ImageFilter::Nearest ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			info.addressModeU = addressMode;
+			info.addressModeV = addressMode;
+			info.addressModeW = addressMode;
+			info.minLod = -1000;
+			info.maxLod = 1000;
+			info.maxAnisotropy = 1.0f;
+			VkResult err = vkCreateSampler(Application::GetDevice(), &info, nullptr, &cached.Sampler);
+			check_vk_result(err);
+		}
+
+		cached.RefCount++;
+		return cached.Sampler;
+	}
+
+	void SamplerCache::Release(const ImageSampler& sampler)
+	{
+		auto it = s_Samplers.find(sampler);
+		if (it == s_Samplers.end() || --it->second.RefCount > 0)
+			return;
+
+		vkDestroySampler(Application::GetDevice(), it->second.Sampler, nullptr);
+		s_Samplers.erase(it);
+	}
+
+	uint32_t SamplerCache::GetSamplerCount()
+	{
+		return (uint32_t)s_Samplers.size();
+	}
+
+	void SamplerCache::Shutdown()
+	{
+		for (auto& [sampler, cached] : s_Samplers)
+			vkDestroySampler(Application::GetDevice(), cached.Sampler, nullptr);
+		s_Samplers.clear();
+	}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+
+namespace Walnut {
+
+	enum class ImageFilter
+	{
+		Linear = 0,
+		Nearest
+	};
+
+	enum class ImageWrap
+	{
+		Repeat = 0,
+		ClampToEdge,
+		MirroredRepeat
+	};
+
+	// How an image is sampled. The default is what every Image used to get a sampler of its own for
+	struct ImageSampler
+	{
+		ImageFilter Filter = ImageFilter::Linear;
+		ImageWrap Wrap = ImageWrap::Repeat;
+
+		bool operator==(const ImageSampler& other) const { return Filter == other.Filter && Wrap == other.Wrap; }
+	};
+
+	// One VkSampler for each sampler state in use, shared by every image sampled that way. Devices only allow so many samplers
+	// (maxSamplerAllocationCount can be as low as 4000), so thousands of images can't each have their own. Each Acquire is
+	// matched by a Release, the sampler is destroyed when the last one goes, and whatever's left is destroyed by Shutdown()
+	class SamplerCache
+	{
+	public:
+		static VkSampler Acquire(const ImageSampler& sampler);
+
+		// Only once the GPU's done with it, i.e. from Application::SubmitResourceFree
+		static void Release(const ImageSampler& sampler);
+
+		static uint32_t GetSamplerCount();
+
+		static void Shutdown();
+	};
+
+}
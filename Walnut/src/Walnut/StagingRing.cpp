@@ -0,0 +1,112 @@
+#include "StagingRing.h"
+
+#include "Application.h"
+
+namespace Walnut {
+
+	static uint32_t FindMemoryType(VkPhysicalDevice physicalDevice, VkMemoryPropertyFlags properties, uint32_t typeBits)
+	{
+		VkPhysicalDeviceMemoryProperties prop;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &prop);
+		for (uint32_t i = 0; i < prop.memoryTypeCount; i++)
+		{
+			if ((prop.memoryTypes[i].propertyFlags & properties) == properties && typeBits & (1 << i))
+				return i;
+		}
+
+		return 0xffffffff;
+	}
+
+	void StagingRing::Init(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks* allocator, VkDeviceSize size)
+	{
+		m_Device = device;
+		m_Allocator = allocator;
+		m_Size = size;
+
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VkResult err = vkCreateBuffer(device, &bufferInfo, allocator, &m_Buffer);
+		check_vk_result(err);
+
+		// Coherent memory saves flushing every frame, but any host visible memory will do
+		VkMemoryRequirements req;
+		vkGetBufferMemoryRequirements(device, m_Buffer, &req);
+		uint32_t memoryType = FindMemoryType(physicalDevice, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, req.memoryTypeBits);
+		if (memoryType == 0xffffffff)
+		{
+			memoryType = FindMemoryType(physicalDevice, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
+			m_Coherent = false;
+		}
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = req.size;
+		allocInfo.memoryTypeIndex = memoryType;
+		err = vkAllocateMemory(device, &allocInfo, allocator, &m_Memory);
+		check_vk_result(err);
+		err = vkBindBufferMemory(device, m_Buffer, m_Memory, 0);
+		check_vk_result(err);
+
+		err = vkMapMemory(device, m_Memory, 0, VK_WHOLE_SIZE, 0, (void**)&m_Mapped);
+		check_vk_result(err);
+
+		m_Head = m_Tail = m_Flushed = 0;
+	}
+
+	void StagingRing::Shutdown()
+	{
+		if (!m_Buffer)
+			return;
+
+		vkUnmapMemory(m_Device, m_Memory);
+		vkDestroyBuffer(m_Device, m_Buffer, m_Allocator);
+		vkFreeMemory(m_Device, m_Memory, m_Allocator);
+		m_Buffer = VK_NULL_HANDLE;
+		m_Memory = VK_NULL_HANDLE;
+		m_Mapped = nullptr;
+	}
+
+	bool StagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& allocation)
+	{
+		if (size > m_Size)
+			return false;
+
+		// Start from the beginning of the buffer whenever it's empty, otherwise an allocation that doesn't fit in what's left
+		// at the end of the buffer (it doesn't wrap around) starts again at the beginning once that's free
+		if (m_Head == m_Tail)
+			m_Head = m_Tail = (m_Head + m_Size - 1) / m_Size * m_Size;
+
+		// It's the offset into the buffer that's aligned, the ring needn't be a multiple of the alignment
+		uint64_t offset = m_Head % m_Size;
+		uint64_t aligned = (offset + alignment - 1) / alignment * alignment;
+		uint64_t start = m_Head - offset + (aligned + size > m_Size ? m_Size : aligned);
+		if (start + size - m_Tail > m_Size)
+			return false;
+
+		m_Head = start + size;
+		allocation.Buffer = m_Buffer;
+		allocation.Offset = start % m_Size;
+		allocation.Data = m_Mapped + allocation.Offset;
+		return true;
+	}
+
+	void StagingRing::Flush()
+	{
+		if (m_Coherent || m_Flushed == m_Head)
+			return;
+
+		// Everything written since the last flush, which may have wrapped around. The whole mapping is flushed
+		// rather than working out ranges aligned to nonCoherentAtomSize, it's rare to need it at all
+		VkMappedMemoryRange range = {};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = m_Memory;
+		range.size = VK_WHOLE_SIZE;
+		VkResult err = vkFlushMappedMemoryRanges(m_Device, 1, &range);
+		check_vk_result(err);
+		m_Flushed = m_Head;
+	}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+
+namespace Walnut {
+
+	// Where to write an upload and where the GPU will copy it from
+	struct StagingAllocation
+	{
+		VkBuffer Buffer = VK_NULL_HANDLE;
+		VkDeviceSize Offset = 0;
+		void* Data = nullptr;
+	};
+
+	// One buffer of host visible memory, mapped for as long as it lives, that uploads to the GPU are copied through.
+	// Space is handed out in order around the ring and given back in the same order, once the GPU has finished copying
+	// out of it. Positions only ever count up (the offset into the buffer is the position modulo its size), so everything
+	// allocated before a position can be released by remembering just that position
+	class StagingRing
+	{
+	public:
+		void Init(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks* allocator, VkDeviceSize size);
+		void Shutdown();
+
+		// Space for size bytes at the given alignment, returns false if the ring doesn't have that much free until more is released
+		bool Allocate(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& allocation);
+
+		// Give back everything allocated before a position taken from GetHead(). Releasing an earlier position than one already
+		// released does nothing, so whatever was allocated before work the GPU has finished can be released in any order
+		void Release(uint64_t position) { if (position > m_Tail) m_Tail = position; }
+
+		// Make writes since the last flush visible to the GPU, if the memory isn't host coherent. Call before submitting
+		void Flush();
+
+		uint64_t GetHead() const { return m_Head; }
+		VkDeviceSize GetSize() const { return m_Size; }
+		VkDeviceSize GetUsed() const { return m_Head - m_Tail; }
+	private:
+		VkDevice m_Device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks* m_Allocator = nullptr;
+
+		VkBuffer m_Buffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_Memory = VK_NULL_HANDLE;
+		uint8_t* m_Mapped = nullptr;
+		VkDeviceSize m_Size = 0;
+		bool m_Coherent = true;
+
+		uint64_t m_Head = 0;
+		uint64_t m_Tail = 0;
+		uint64_t m_Flushed = 0;
+	};
+
+}
@@ -14,17 +14,17 @@ namespace Walnut {
 			Reset();
 		}
 
-		void Timer::Reset()
+		void Reset()
 		{
 			m_Start = std::chrono::high_resolution_clock::now();
 		}
 
-		float Timer::Elapsed()
+		float Elapsed()
 		{
 			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - m_Start).count() * 0.001f * 0.001f * 0.001f;
 		}
 
-		float Timer::ElapsedMillis()
+		float ElapsedMillis()
 		{
 			return Elapsed() * 1000.0f;
 		}
@@ -33,21 +33,6 @@ namespace Walnut {
 		std::chrono::time_point<std::chrono::high_resolution_clock> m_Start;
 	};
 
-	class ScopedTimer
-	{
-	public:
-		ScopedTimer(const std::string& name)
-			: m_Name(name) {}
-		~ScopedTimer()
-		{
-			float time = m_Timer.ElapsedMillis();
-			std::cout << "[TIMER] " << m_Name << " - " << time << "ms\n";
-		}
-	private:
-		std::string m_Name;
-		Timer m_Timer;
-	};
-
-
+	// Timing a scope is done with WL_PROFILE_SCOPE (see Profiler.h), which every thread can use on hot paths
 
 }
@@ -0,0 +1,117 @@
+#include "UploadBenchmark.h"
+
+#include "Application.h"
+#include "Timer.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace Walnut {
+
+	UploadBenchmark::UploadBenchmark(uint32_t frameCount, uint32_t imageCount, uint32_t imageSize)
+		: m_FrameCount(frameCount), m_ImageCount(imageCount), m_ImageSize(imageSize)
+	{
+	}
+
+	void UploadBenchmark::OnAttach()
+	{
+		if (Application::Get().IsHeadless())
+		{
+			printf("UploadBenchmark: images need the GPU, there's nothing to run headless\n");
+			return;
+		}
+
+		m_Images.reserve(m_ImageCount);
+		for (uint32_t i = 0; i < m_ImageCount; i++)
+			m_Images.push_back(std::make_shared<Image>(m_ImageSize, m_ImageSize, ImageFormat::RGBA));
+		m_Pixels.resize(m_ImageSize * m_ImageSize);
+
+		m_UpdateTimes.reserve(m_FrameCount);
+		m_Submissions.reserve(m_FrameCount);
+		m_LastSubmitCount = Application::GetQueueSubmitCount();
+	}
+
+	void UploadBenchmark::OnDetach()
+	{
+		m_Images.clear();
+	}
+
+	void UploadBenchmark::OnUpdate(float ts)
+	{
+		if (m_Images.empty() || m_Frame > m_FrameCount)
+			return;
+
+		// Keep frames coming when the app renders on demand
+		Application::Get().RequestRedraw();
+
+		// Everything submitted since the last update is the last frame's
+		uint64_t submitCount = Application::GetQueueSubmitCount();
+		if (m_Frame > 0)
+			m_Submissions.push_back((uint32_t)(submitCount - m_LastSubmitCount));
+		m_LastSubmitCount = submitCount;
+
+		if (m_Frame++ == m_FrameCount)
+		{
+			Report();
+			Application::Get().Close();
+			return;
+		}
+
+		// Different pixels every frame, though it's only the updates that are timed
+		std::fill(m_Pixels.begin(), m_Pixels.end(), 0xff000000 | (m_Frame * 0x00030507 & 0x00ffffff));
+
+		Timer timer;
+		for (auto& image : m_Images)
+			image->SetData(m_Pixels.data());
+		m_UpdateTimes.push_back(timer.ElapsedMillis());
+	}
+
+	void UploadBenchmark::OnUIRender()
+	{
+		if (m_Images.empty())
+			return;
+
+		ImGui::Begin("Upload Benchmark");
+		ImGui::Text("%u of %u frames, %u %ux%u images", std::min(m_Frame, m_FrameCount), m_FrameCount, m_ImageCount, m_ImageSize, m_ImageSize);
+
+		// Every image as a small tile, so each one's sampled between its updates
+		const float tileSize = 16.0f;
+		const float spacing = ImGui::GetStyle().ItemSpacing.x;
+		int tilesPerRow = std::max(1, (int)((ImGui::GetContentRegionAvail().x + spacing) / (tileSize + spacing)));
+		for (size_t i = 0; i < m_Images.size(); i++)
+		{
+			if (i % tilesPerRow != 0)
+				ImGui::SameLine();
+			ImGui::Image(m_Images[i]->GetDescriptorSet(), ImVec2(tileSize, tileSize));
+		}
+		ImGui::End();
+	}
+
+	template<typename T>
+	static T Median(std::vector<T> values)
+	{
+		std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+		return values[values.size() / 2];
+	}
+
+	void UploadBenchmark::Report()
+	{
+		if (m_UpdateTimes.empty())
+			return;
+
+		float updateMedian = Median(m_UpdateTimes);
+		auto [updateMin, updateMax] = std::minmax_element(m_UpdateTimes.begin(), m_UpdateTimes.end());
+		auto [submitMin, submitMax] = std::minmax_element(m_Submissions.begin(), m_Submissions.end());
+		uint64_t submitTotal = 0;
+		for (uint32_t submissions : m_Submissions)
+			submitTotal += submissions;
+
+		printf("UploadBenchmark: %u %ux%u image updates a frame over %u frames\n", m_ImageCount, m_ImageSize, m_ImageSize, m_FrameCount);
+		printf("  CPU time     %.3f ms a frame median (min %.3f, max %.3f), %.2f us an update\n",
+			updateMedian, *updateMin, *updateMax, updateMedian * 1000.0f / m_ImageCount);
+		printf("  submissions  %.2f a frame (min %u, max %u)\n", (double)submitTotal / m_Submissions.size(), *submitMin, *submitMax);
+	}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Layer.h"
+#include "Image.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Walnut {
+
+	// Updates ImageCount small RGBA images (Image::SetData) every frame for FrameCount frames, then prints how much CPU time the
+	// updates took each frame and how many queue submissions each frame made, and closes the app. With uploads batched that's
+	// two submissions a frame however many images there are: the frame's uploads and its rendering.
+	// The images are drawn in a window as they're updated, so the GPU samples them between updates like it would in an app.
+	// They're small by default (4 MB of uploads a frame) so it's the CPU cost that's measured rather than the bus
+	class UploadBenchmark : public Layer
+	{
+	public:
+		UploadBenchmark(uint32_t frameCount, uint32_t imageCount = 1000, uint32_t imageSize = 32);
+
+		virtual void OnAttach() override;
+		virtual void OnDetach() override;
+		virtual void OnUpdate(float ts) override;
+		virtual void OnUIRender() override;
+	private:
+		void Report();
+	private:
+		uint32_t m_FrameCount, m_ImageCount, m_ImageSize;
+
+		std::vector<std::shared_ptr<Image>> m_Images;
+		std::vector<uint32_t> m_Pixels;
+
+		// Frame 0 creates the images, it isn't counted
+		uint32_t m_Frame = 0;
+		uint64_t m_LastSubmitCount = 0;
+		std::vector<float> m_UpdateTimes;
+		std::vector<uint32_t> m_Submissions;
+	};
+
+}
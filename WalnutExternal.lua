@@ -12,6 +12,12 @@ LibraryDir["VulkanSDK"] = "%{VULKAN_SDK}/Lib"
 Library = {}
 Library["Vulkan"] = "%{LibraryDir.VulkanSDK}/vulkan-1.lib"
 
+-- On Linux the headers and loader come from the system (libvulkan-dev) unless the LunarG SDK is set up
+if os.istarget("linux") then
+   IncludeDir["VulkanSDK"] = VULKAN_SDK and "%{VULKAN_SDK}/include" or "/usr/include"
+   Library["Vulkan"] = "vulkan"
+end
+
 group "Dependencies"
    include "vendor/imgui"
    include "vendor/glfw"
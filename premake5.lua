@@ -6,5 +6,40 @@ workspace "Calculator"
 
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
+-- Calculation engine sources, shared by every project that evaluates calculations (no ImGui or Vulkan dependencies)
+CalcEngine = {}
+CalcEngine["IncludeDir"] = "%{wks.location}/Calculator/src"
+CalcEngine["Files"] =
+{
+   "%{wks.location}/Calculator/src/Common.h",
+   "%{wks.location}/Calculator/src/CalcOperand.h",
+   "%{wks.location}/Calculator/src/CalcFunc.cpp",
+   "%{wks.location}/Calculator/src/CalcDecimal.h",
+   "%{wks.location}/Calculator/src/CalcDecimal.cpp",
+   "%{wks.location}/Calculator/src/CalcArena.h",
+   "%{wks.location}/Calculator/src/CalcArena.cpp",
+   "%{wks.location}/Calculator/src/CalcTape.h",
+   "%{wks.location}/Calculator/src/CalcTape.cpp",
+   "%{wks.location}/Calculator/src/CalcMemo.h",
+   "%{wks.location}/Calculator/src/CalcMemo.cpp",
+   "%{wks.location}/Calculator/src/CalcParser.h",
+   "%{wks.location}/Calculator/src/CalcParser.cpp",
+   "%{wks.location}/Calculator/src/CalcHistory.h",
+   "%{wks.location}/Calculator/src/CalcHistory.cpp",
+   "%{wks.location}/Calculator/src/CalcHistoryLog.h",
+   "%{wks.location}/Calculator/src/CalcHistoryLog.cpp",
+   "%{wks.location}/Calculator/src/CalcHistorySearch.h",
+   "%{wks.location}/Calculator/src/CalcHistorySearch.cpp",
+   "%{wks.location}/Calculator/src/CalcFold.h",
+   "%{wks.location}/Calculator/src/CalcFold.cpp",
+   "%{wks.location}/Calculator/src/CalcIOStreamObj.h",
+   "%{wks.location}/Calculator/src/CalcIOStreamObj.cpp",
+   "%{wks.location}/Calculator/src/CalcTrace.h",
+   "%{wks.location}/Calculator/src/CalcTrace.cpp",
+}
+
 include "WalnutExternal.lua"
-include "Calculator"
\ No newline at end of file
+include "Calculator"
+include "CalculatorCLI"
+include "CalculatorBench"
+include "CalculatorAllocCheck"